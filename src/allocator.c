@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "allocator.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void *a_default_allocate(void *context, const size_t size, const size_t alignment,
+				const short zeroed);
+static void *a_default_resize(void *context, void *pointer, const size_t old_size,
+			      const size_t new_size);
+static void a_default_release(void *context, void *pointer, const size_t size);
+
+static const a_backend a_default = { a_default_allocate, a_default_resize, a_default_release,
+				     NULL };
+
+static const char *const a_tag_names[ALLOCATOR_TAG_COUNT] = { "queue",   "snake",   "board",
+							      "windows", "monitor", "threads",
+							      "log",     "state",   "bot",
+							      "table",   "batch",   "map",
+							      "replay" };
+
+/*
+ * Backends set with a_set_backend, tags without one use a_default
+ */
+static a_backend a_backends[ALLOCATOR_TAG_COUNT];
+
+/*
+ * Counters are updated with relaxed atomics, tags are shared between threads
+ */
+static a_stats a_counters[ALLOCATOR_TAG_COUNT];
+
+static void *a_default_allocate(void *context, const size_t size, const size_t alignment,
+				const short zeroed)
+{
+	(void)context;
+	if (alignment) {
+		void *pointer = NULL;
+		if (posix_memalign(&pointer, alignment, size) != 0) {
+			return NULL;
+		}
+		return zeroed ? memset(pointer, 0, size) : pointer;
+	}
+	return zeroed ? calloc(1, size) : malloc(size);
+}
+
+static void *a_default_resize(void *context, void *pointer, const size_t old_size,
+			      const size_t new_size)
+{
+	(void)context;
+	(void)old_size;
+	return realloc(pointer, new_size);
+}
+
+static void a_default_release(void *context, void *pointer, const size_t size)
+{
+	(void)context;
+	(void)size;
+	free(pointer);
+}
+
+/*
+ * RETURNS: backend allocating for tag
+ */
+static const a_backend *a_backend_get(const a_tag tag)
+{
+	return a_backends[tag].allocate ? &a_backends[tag] : &a_default;
+}
+
+/*
+ * Adds size to the bytes in use of tag and raises its peak
+ */
+static void a_account(const a_tag tag, const size_t size)
+{
+	a_stats *stats = &a_counters[tag];
+	uint64_t bytes = __atomic_add_fetch(&stats->bytes, size, __ATOMIC_RELAXED);
+	uint64_t peak = __atomic_load_n(&stats->peak, __ATOMIC_RELAXED);
+	while (bytes > peak
+	       && !__atomic_compare_exchange_n(&stats->peak, &peak, bytes, 1, __ATOMIC_RELAXED,
+					       __ATOMIC_RELAXED)) {
+	}
+}
+
+/*
+ * Allocates through the backend of tag and accounts the block
+ */
+static void *a_allocate(const a_tag tag, const size_t size, const size_t alignment,
+			const short zeroed)
+{
+	if (tag >= ALLOCATOR_TAG_COUNT) {
+		return NULL;
+	}
+	const a_backend *backend = a_backend_get(tag);
+	void *pointer = backend->allocate(backend->context, size, alignment, zeroed);
+	if (!pointer) {
+		__atomic_add_fetch(&a_counters[tag].failures, 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+	__atomic_add_fetch(&a_counters[tag].allocations, 1, __ATOMIC_RELAXED);
+	a_account(tag, size);
+	return pointer;
+}
+
+void a_set_backend(const a_tag tag, const a_backend *const backend)
+{
+	if (tag >= ALLOCATOR_TAG_COUNT) {
+		return;
+	}
+	a_backends[tag] = backend ? *backend : a_default;
+}
+
+void *a_malloc(const a_tag tag, const size_t size)
+{
+	return a_allocate(tag, size, 0, 0);
+}
+
+void *a_calloc(const a_tag tag, const size_t count, const size_t size)
+{
+	if (size && count > SIZE_MAX / size) {
+		return NULL;
+	}
+	return a_allocate(tag, count * size, 0, 1);
+}
+
+void *a_aligned(const a_tag tag, const size_t alignment, const size_t size)
+{
+	return a_allocate(tag, size, alignment, 0);
+}
+
+void *a_realloc(const a_tag tag, void *const pointer, const size_t old_size,
+		const size_t new_size)
+{
+	if (tag >= ALLOCATOR_TAG_COUNT) {
+		return NULL;
+	}
+	if (!pointer) {
+		return a_malloc(tag, new_size);
+	}
+	const a_backend *backend = a_backend_get(tag);
+	void *resized = NULL;
+	if (backend->resize) {
+		resized = backend->resize(backend->context, pointer, old_size, new_size);
+	} else {
+		resized = backend->allocate(backend->context, new_size, 0, 0);
+		if (resized) {
+			memcpy(resized, pointer, old_size < new_size ? old_size : new_size);
+			backend->release(backend->context, pointer, old_size);
+		}
+	}
+	if (!resized) {
+		__atomic_add_fetch(&a_counters[tag].failures, 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+	__atomic_add_fetch(&a_counters[tag].resizes, 1, __ATOMIC_RELAXED);
+	if (new_size > old_size) {
+		a_account(tag, new_size - old_size);
+	} else {
+		__atomic_sub_fetch(&a_counters[tag].bytes, old_size - new_size, __ATOMIC_RELAXED);
+	}
+	return resized;
+}
+
+void a_free(const a_tag tag, void *const pointer, const size_t size)
+{
+	if (!pointer || tag >= ALLOCATOR_TAG_COUNT) {
+		return;
+	}
+	const a_backend *backend = a_backend_get(tag);
+	backend->release(backend->context, pointer, size);
+	__atomic_add_fetch(&a_counters[tag].releases, 1, __ATOMIC_RELAXED);
+	__atomic_sub_fetch(&a_counters[tag].bytes, size, __ATOMIC_RELAXED);
+}
+
+void a_stats_get(const a_tag tag, a_stats *const stats)
+{
+	if (tag >= ALLOCATOR_TAG_COUNT || !stats) {
+		return;
+	}
+	const a_stats *counters = &a_counters[tag];
+	stats->bytes = __atomic_load_n(&counters->bytes, __ATOMIC_RELAXED);
+	stats->peak = __atomic_load_n(&counters->peak, __ATOMIC_RELAXED);
+	stats->allocations = __atomic_load_n(&counters->allocations, __ATOMIC_RELAXED);
+	stats->resizes = __atomic_load_n(&counters->resizes, __ATOMIC_RELAXED);
+	stats->releases = __atomic_load_n(&counters->releases, __ATOMIC_RELAXED);
+	stats->failures = __atomic_load_n(&counters->failures, __ATOMIC_RELAXED);
+}
+
+void a_report(FILE *const stream)
+{
+	if (!stream) {
+		return;
+	}
+	fprintf(stream, "%-8s %12s %12s %10s %10s %10s %8s\n", "tag", "bytes", "peak", "allocs",
+		"resizes", "frees", "failed");
+	for (int tag = 0; tag < ALLOCATOR_TAG_COUNT; tag++) {
+		a_stats stats;
+		a_stats_get((a_tag)tag, &stats);
+		if (stats.allocations == 0 && stats.failures == 0) {
+			continue;
+		}
+		fprintf(stream, "%-8s %12llu %12llu %10llu %10llu %10llu %8llu\n", a_tag_names[tag],
+			(unsigned long long)stats.bytes, (unsigned long long)stats.peak,
+			(unsigned long long)stats.allocations, (unsigned long long)stats.resizes,
+			(unsigned long long)stats.releases, (unsigned long long)stats.failures);
+	}
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __ALLOCATOR_H__
+#define __ALLOCATOR_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Subsystems memory is accounted to
+ */
+typedef enum a_tag {
+	ALLOCATOR_TAG_QUEUE,
+	ALLOCATOR_TAG_SNAKE,
+	ALLOCATOR_TAG_BOARD,
+	ALLOCATOR_TAG_WINDOWS,
+	ALLOCATOR_TAG_MONITOR,
+	ALLOCATOR_TAG_THREADS,
+	ALLOCATOR_TAG_EVENT_LOG,
+	ALLOCATOR_TAG_STATE,
+	ALLOCATOR_TAG_BOT,
+	ALLOCATOR_TAG_TABLE,
+	ALLOCATOR_TAG_BATCH,
+	ALLOCATOR_TAG_MAP,
+	ALLOCATOR_TAG_REPLAY,
+	ALLOCATOR_TAG_COUNT
+} a_tag;
+
+/*
+ * Allocation backend.
+ * Allocate returns size bytes aligned to alignment (0 for the default alignment),
+ * zeroed if zeroed is set. Release gets the same size the block was allocated with.
+ * Resize may be NULL, blocks are then moved with allocate and release
+ */
+typedef struct a_backend {
+	void *(*allocate)(void *context, const size_t size, const size_t alignment,
+			  const short zeroed);
+	void *(*resize)(void *context, void *pointer, const size_t old_size, const size_t new_size);
+	void (*release)(void *context, void *pointer, const size_t size);
+	void *context;
+} a_backend;
+
+/*
+ * Usage counters of one tag, bytes are the sizes requested by callers
+ */
+typedef struct a_stats {
+	uint64_t bytes;
+	uint64_t peak;
+	uint64_t allocations;
+	uint64_t resizes;
+	uint64_t releases;
+	uint64_t failures;
+} a_stats;
+
+/*
+ * Replaces the backend of tag, NULL restores malloc.
+ * Has to be called before anything is allocated with the tag
+ */
+void a_set_backend(const a_tag tag, const a_backend *const backend);
+
+/*
+ * Allocates size bytes accounted to tag
+ * \RETURNS: pointer to the block, NULL on failure
+ */
+void *a_malloc(const a_tag tag, const size_t size);
+
+/*
+ * Allocates count zeroed elements of size bytes accounted to tag
+ * \RETURNS: pointer to the block, NULL on failure
+ */
+void *a_calloc(const a_tag tag, const size_t count, const size_t size);
+
+/*
+ * Allocates size bytes aligned to alignment, a power of two multiple of sizeof(void *)
+ * \RETURNS: pointer to the block, NULL on failure
+ */
+void *a_aligned(const a_tag tag, const size_t alignment, const size_t size);
+
+/*
+ * Resizes a block allocated with a_malloc or a_calloc, contents are kept up to the smaller size
+ * \RETURNS: pointer to the resized block, NULL on failure with the old block left untouched
+ */
+void *a_realloc(const a_tag tag, void *const pointer, const size_t old_size,
+		const size_t new_size);
+
+/*
+ * Releases a block of size bytes allocated with tag, NULL is ignored
+ */
+void a_free(const a_tag tag, void *const pointer, const size_t size);
+
+/*
+ * Copies counters of tag into stats
+ */
+void a_stats_get(const a_tag tag, a_stats *const stats);
+
+/*
+ * Prints counters of every tag that was used
+ */
+void a_report(FILE *const stream);
+
+#endif
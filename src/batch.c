@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "batch.h"
+#include "allocator.h"
+#include "snake.h"
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__GNUC__)
+/*
+ * One value of BATCH_LANES environments, compiled to SIMD instructions where the target has them
+ */
+typedef int32_t be_lanes __attribute__((vector_size(BATCH_LANES * sizeof(int32_t))));
+#endif
+
+/*
+ * Alignment of the arrays carved from the arena, a whole vector of lanes
+ */
+#define BATCH_ALIGNMENT (BATCH_LANES * sizeof(int32_t))
+
+/*
+ * RETURNS: next free part of size bytes of the arena, offset is moved past it
+ */
+static void *be_carve(batch *const batch, size_t *const offset, const size_t size)
+{
+	void *part = batch->arena ? (char *)batch->arena + *offset : NULL;
+	*offset += (size + BATCH_ALIGNMENT - 1) / BATCH_ALIGNMENT * BATCH_ALIGNMENT;
+	return part;
+}
+
+/*
+ * Lays the arrays out in the arena, with a NULL arena only the size is counted
+ * \RETURNS: bytes the arrays take
+ */
+static size_t be_layout(batch *const batch)
+{
+	size_t offset = 0;
+	size_t lanes = batch->padded * sizeof(int32_t);
+	int32_t **arrays[] = { &batch->head_x, &batch->head_y, &batch->food_x,  &batch->food_y,
+			       &batch->direction, &batch->alive, &batch->next_x, &batch->next_y,
+			       &batch->inside, &batch->eats };
+	for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) {
+		*arrays[i] = be_carve(batch, &offset, lanes);
+	}
+	batch->score = be_carve(batch, &offset, lanes);
+	batch->length = be_carve(batch, &offset, lanes);
+	batch->tail = be_carve(batch, &offset, lanes);
+	batch->ticks = be_carve(batch, &offset, lanes);
+	batch->random = be_carve(batch, &offset, batch->padded * sizeof(uint64_t));
+	batch->bitmaps =
+		be_carve(batch, &offset, (size_t)batch->count * batch->bitmap_words * sizeof(uint64_t));
+	batch->bodies =
+		be_carve(batch, &offset, (size_t)batch->count * batch->capacity * sizeof(uint16_t));
+	return offset;
+}
+
+static uint16_t *be_body(batch *const batch, const uint32_t environment)
+{
+	return batch->bodies + (size_t)environment * batch->capacity;
+}
+
+static uint64_t *be_bitmap(batch *const batch, const uint32_t environment)
+{
+	return batch->bitmaps + (size_t)environment * batch->bitmap_words;
+}
+
+static void be_push(batch *const batch, const uint32_t environment, const uint32_t cell)
+{
+	uint32_t index = batch->tail[environment] + batch->length[environment];
+	if (index >= batch->capacity) {
+		index -= batch->capacity;
+	}
+	be_body(batch, environment)[index] = (uint16_t)cell;
+	batch->length[environment]++;
+	be_bitmap(batch, environment)[cell >> 6] |= 1ULL << (cell & 63);
+}
+
+static void be_pop(batch *const batch, const uint32_t environment)
+{
+	uint32_t cell = be_body(batch, environment)[batch->tail[environment]];
+	be_bitmap(batch, environment)[cell >> 6] &= ~(1ULL << (cell & 63));
+	if (++batch->tail[environment] == batch->capacity) {
+		batch->tail[environment] = 0;
+	}
+	batch->length[environment]--;
+}
+
+/*
+ * Places food the way s_generate_food does, from the generator of environment
+ */
+static void be_generate_food(batch *const batch, const uint32_t environment)
+{
+	batch->food_x[environment] =
+		(int32_t)(s_random(&batch->random[environment]) % (uint32_t)(batch->width - 2) + 1);
+	batch->food_y[environment] =
+		(int32_t)(s_random(&batch->random[environment]) % (uint32_t)(batch->height - 2) + 1);
+}
+
+/*
+ * Computes the next head of every environment and checks it against the walls and the food
+ */
+static void be_kernel(batch *const batch, const uint8_t *const actions)
+{
+	const int32_t right = batch->width - 2;
+	const int32_t bottom = batch->height - 2;
+	uint32_t i = 0;
+#if defined(__GNUC__)
+	for (; i + BATCH_LANES <= batch->padded; i += BATCH_LANES) {
+		be_lanes action, direction, x, y, food_x, food_y;
+		for (int lane = 0; lane < BATCH_LANES; lane++) {
+			action[lane] = i + (uint32_t)lane < batch->count ? actions[i + (uint32_t)lane]
+								       : SNAKE_MOVE_EMPTY;
+		}
+		memcpy(&direction, batch->direction + i, sizeof(be_lanes));
+		memcpy(&x, batch->head_x + i, sizeof(be_lanes));
+		memcpy(&y, batch->head_y + i, sizeof(be_lanes));
+		memcpy(&food_x, batch->food_x + i, sizeof(be_lanes));
+		memcpy(&food_y, batch->food_y + i, sizeof(be_lanes));
+
+		/* Comparisons give -1 in lanes where they hold */
+		be_lanes keep = action == SNAKE_MOVE_EMPTY;
+		direction = (direction & keep) | (action & ~keep);
+		x += (direction == SNAKE_MOVE_LEFT) - (direction == SNAKE_MOVE_RIGHT);
+		y += (direction == SNAKE_MOVE_UP) - (direction == SNAKE_MOVE_DOWN);
+		be_lanes inside = (x >= 1) & (x <= right) & (y >= 1) & (y <= bottom);
+		be_lanes eats = (x == food_x) & (y == food_y);
+
+		memcpy(batch->direction + i, &direction, sizeof(be_lanes));
+		memcpy(batch->next_x + i, &x, sizeof(be_lanes));
+		memcpy(batch->next_y + i, &y, sizeof(be_lanes));
+		memcpy(batch->inside + i, &inside, sizeof(be_lanes));
+		memcpy(batch->eats + i, &eats, sizeof(be_lanes));
+	}
+#endif
+	for (; i < batch->count; i++) {
+		if (actions[i] != SNAKE_MOVE_EMPTY) {
+			batch->direction[i] = actions[i];
+		}
+		s_coordinates offset = s_get_move_offset((m_snake_move)batch->direction[i]);
+		int32_t x = batch->head_x[i] + offset.x;
+		int32_t y = batch->head_y[i] + offset.y;
+		batch->next_x[i] = x;
+		batch->next_y[i] = y;
+		batch->inside[i] = -(x >= 1 && x <= right && y >= 1 && y <= bottom);
+		batch->eats[i] = -(x == batch->food_x[i] && y == batch->food_y[i]);
+	}
+}
+
+/*
+ * Sets the sizes of a batch of count environments on boards of given size
+ * \RETURNS: 1 on success, 0 if the sizes are invalid
+ */
+static short be_dimensions(batch *const batch, const uint32_t count, const int width,
+			   const int height)
+{
+	if (!count || width < 3 || height < 3 || (long)width * height > UINT16_MAX + 1L) {
+		fprintf(stderr, "ERROR: invalid batch size\n");
+		return 0;
+	}
+	batch->count = count;
+	batch->padded = (count + BATCH_LANES - 1) / BATCH_LANES * BATCH_LANES;
+	batch->width = width;
+	batch->height = height;
+	batch->capacity = (uint32_t)((width - 2) * (height - 2));
+	batch->bitmap_words = (uint32_t)(((size_t)width * (size_t)height + 63) / 64);
+	return 1;
+}
+
+size_t be_arena_size(const uint32_t count, const int width, const int height)
+{
+	batch batch = { 0 };
+	return be_dimensions(&batch, count, width, height) ? be_layout(&batch) : 0;
+}
+
+batch *be_malloc(const uint32_t count, const int width, const int height, const uint64_t seed)
+{
+	return be_malloc_in(count, width, height, seed, NULL);
+}
+
+batch *be_malloc_in(const uint32_t count, const int width, const int height, const uint64_t seed,
+		    void *const arena)
+{
+	batch *batch = a_calloc(ALLOCATOR_TAG_BATCH, 1, sizeof(struct batch));
+	if (!batch) {
+		perror("ERROR: batch malloc failed\n");
+		return NULL;
+	}
+	if (!be_dimensions(batch, count, width, height)) {
+		a_free(ALLOCATOR_TAG_BATCH, batch, sizeof(struct batch));
+		return NULL;
+	}
+	batch->arena_size = be_layout(batch);
+	batch->owns_arena = !arena;
+	batch->arena = arena ? arena
+			     : a_aligned(ALLOCATOR_TAG_BATCH, BATCH_ALIGNMENT, batch->arena_size);
+	if (!batch->arena) {
+		perror("ERROR: batch arena malloc failed\n");
+		a_free(ALLOCATOR_TAG_BATCH, batch, sizeof(struct batch));
+		return NULL;
+	}
+	memset(batch->arena, 0, batch->arena_size);
+	be_layout(batch);
+	for (uint32_t i = 0; i < count; i++) {
+		batch->random[i] = s_seed_random(seed + i);
+		be_reset(batch, i);
+	}
+	batch->resets = 0;
+	return batch;
+}
+
+void be_free(batch **batch)
+{
+	if (!batch || !*batch) {
+		return;
+	}
+	if ((*batch)->owns_arena) {
+		a_free(ALLOCATOR_TAG_BATCH, (*batch)->arena, (*batch)->arena_size);
+	}
+	a_free(ALLOCATOR_TAG_BATCH, *batch, sizeof(struct batch));
+	*batch = NULL;
+}
+
+void be_reset(batch *const batch, const uint32_t environment)
+{
+	memset(be_bitmap(batch, environment), 0, batch->bitmap_words * sizeof(uint64_t));
+	batch->tail[environment] = 0;
+	batch->length[environment] = 0;
+	batch->score[environment] = 0;
+	batch->ticks[environment] = 0;
+	batch->alive[environment] = 1;
+	batch->direction[environment] = SNAKE_MOVE_RIGHT;
+	/* Same order as s_initialize: food first, then the head in the middle */
+	be_generate_food(batch, environment);
+	batch->head_x[environment] = batch->width / 2;
+	batch->head_y[environment] = batch->height / 2;
+	be_push(batch, environment,
+		(uint32_t)(batch->head_y[environment] * batch->width + batch->head_x[environment]));
+	batch->resets++;
+}
+
+void be_step(batch *const batch, const uint8_t *const actions, float *const rewards,
+	     uint8_t *const dones)
+{
+	for (uint32_t i = 0; i < batch->count; i++) {
+		if (!batch->alive[i]) {
+			be_reset(batch, i);
+		}
+	}
+	be_kernel(batch, actions);
+
+	/* Bodies differ in length for every environment, they are updated one at a time */
+	for (uint32_t i = 0; i < batch->count; i++) {
+		uint32_t cell = (uint32_t)(batch->next_y[i] * batch->width + batch->next_x[i]);
+		float reward = 0;
+		batch->ticks[i]++;
+		if (!batch->inside[i] || be_taken(batch, i, cell)) {
+			batch->alive[i] = 0;
+			be_pop(batch, i);
+			reward = -1;
+		} else {
+			be_push(batch, i, cell);
+			batch->head_x[i] = batch->next_x[i];
+			batch->head_y[i] = batch->next_y[i];
+			if (batch->eats[i]) {
+				batch->score[i]++;
+				be_generate_food(batch, i);
+				reward = 1;
+			} else {
+				be_pop(batch, i);
+			}
+		}
+		if (rewards) {
+			rewards[i] = reward;
+		}
+		if (dones) {
+			dones[i] = (uint8_t)!batch->alive[i];
+		}
+	}
+	batch->steps += batch->count;
+}
+
+short be_taken(const batch *const batch, const uint32_t environment, const uint32_t cell)
+{
+	return (short)((batch->bitmaps[(size_t)environment * batch->bitmap_words + (cell >> 6)]
+			>> (cell & 63))
+		       & 1);
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include "monitor.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Environments handled by one step of the vector kernel, arrays are padded to whole lanes
+ */
+#define BATCH_LANES 8
+
+/*
+ * Games stepped in lockstep, every field array holds one value per environment.
+ * Heads, food, directions and alive flags are read by the vector kernel, which leaves the
+ * next head and its wall and food checks in next_x, next_y, inside and eats.
+ * Bodies are rings of capacity cell indices and bitmaps are bitmap_words words of taken cells,
+ * both kept for every environment one after another in a single arena, which may belong
+ * to the caller, for example to place it in shared memory.
+ * Environments that died in a step start a new game at the beginning of the next one
+ */
+typedef struct batch {
+	uint32_t count;
+	uint32_t padded;
+	int width;
+	int height;
+	uint32_t capacity;
+	uint32_t bitmap_words;
+	int32_t *head_x;
+	int32_t *head_y;
+	int32_t *food_x;
+	int32_t *food_y;
+	int32_t *direction;
+	int32_t *alive;
+	int32_t *next_x;
+	int32_t *next_y;
+	int32_t *inside;
+	int32_t *eats;
+	uint32_t *score;
+	uint32_t *length;
+	uint32_t *tail;
+	uint32_t *ticks;
+	uint64_t *random;
+	uint16_t *bodies;
+	uint64_t *bitmaps;
+	void *arena;
+	size_t arena_size;
+	short owns_arena;
+	uint64_t steps;
+	uint64_t resets;
+} batch;
+
+/*
+ * Creates count environments on boards of given size, environment i plays the games a snake
+ * seeded with seed + i would
+ * \RETURNS: pointer to the batch, NULL on failure
+ */
+batch *be_malloc(const uint32_t count, const int width, const int height, const uint64_t seed);
+
+/*
+ * Creates the batch in arena, a block of be_arena_size bytes aligned to BATCH_LANES values
+ * owned by the caller, NULL allocates the arena
+ * \RETURNS: pointer to the batch, NULL on failure
+ */
+batch *be_malloc_in(const uint32_t count, const int width, const int height, const uint64_t seed,
+		    void *const arena);
+
+/*
+ * RETURNS: bytes of the arena of a batch, 0 if the sizes are invalid
+ */
+size_t be_arena_size(const uint32_t count, const int width, const int height);
+
+/*
+ * Frees the given batch, and its arena unless it belongs to the caller
+ */
+void be_free(batch **batch);
+
+/*
+ * Starts a new game in environment, with food placed and the head in the middle of the board
+ */
+void be_reset(batch *const batch, const uint32_t environment);
+
+/*
+ * Steps every environment once with its action, SNAKE_MOVE_EMPTY keeps the direction.
+ * Rewards get 1 for food eaten, -1 for a death and 0 otherwise, dones 1 for a death.
+ * Either may be NULL
+ */
+void be_step(batch *const batch, const uint8_t *const actions, float *const rewards,
+	     uint8_t *const dones);
+
+/*
+ * RETURNS: 1 if the snake of environment takes cell, 0 otherwise
+ */
+short be_taken(const batch *const batch, const uint32_t environment, const uint32_t cell);
+
+#endif
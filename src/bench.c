@@ -0,0 +1,1708 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include "allocator.h"
+#include "batch.h"
+#include "env_server.h"
+#include "bitboard.h"
+#include "event_log.h"
+#include "food_field.h"
+#include "food_set.h"
+#include "game_state.h"
+#include "input.h"
+#include "map.h"
+#include "mcts.h"
+#include "monitor.h"
+#include "observation.h"
+#include "replay.h"
+#include "session.h"
+#include "snake.h"
+#include "threads.h"
+#include "timing_wheel.h"
+#include "usage.h"
+#include <ncurses.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Board size used by benchmark sessions
+ */
+#define BENCH_BOARD_WIDTH 80
+#define BENCH_BOARD_HEIGHT 23
+
+/*
+ * Single benchmark that can be selected from the command line
+ */
+typedef struct bench {
+	const char *name;
+	const char *usage;
+	int (*run)(int argc, char *argv[]);
+} bench;
+
+/*
+ * Session run by the input, game and windows threads of the pthread model
+ */
+typedef struct bench_session {
+	session *session;
+	short stop;
+	unsigned long renders;
+	uint64_t end;
+	pthread_t threads[THREAD_TYPE_COUNT];
+} bench_session;
+
+/*
+ * Game thread of the pthread model, restarts the snake after it dies
+ */
+static void *bench_game_thread(void *args)
+{
+	bench_session *bench = args;
+	session *session = bench->session;
+	pthread_setname_np(pthread_self(), "game");
+	while (1) {
+		s_move(session->snake, session->monitor);
+		m_lock(session->monitor, __func__);
+		if (bench->stop) {
+			m_unlock(session->monitor);
+			return NULL;
+		}
+		s_clear_snake_body(session->snake);
+		s_initialize(session->snake, session->board);
+		m_initialize(session->monitor);
+		m_unlock(session->monitor);
+	}
+}
+
+/*
+ * Windows thread of the pthread model, consumes signals without drawing
+ */
+static void *bench_windows_thread(void *args)
+{
+	bench_session *bench = args;
+	monitor *monitor = bench->session->monitor;
+	pthread_setname_np(pthread_self(), "windows");
+	m_lock(monitor, __func__);
+	while (1) {
+		m_wait(monitor, &monitor->windows_event, __func__, m_windows_ready);
+		if (monitor->signal_windows == SIGNAL_WINDOWS_GAME_EXIT) {
+			m_unlock(monitor);
+			return NULL;
+		}
+		monitor->signal_windows = SIGNAL_WINDOWS_EMPTY;
+		bench->renders++;
+	}
+}
+
+/*
+ * Input thread of the pthread model, presses random arrow keys until the end
+ */
+static void *bench_input_thread(void *args)
+{
+	static const int keys[] = { KEY_UP, KEY_DOWN, KEY_LEFT, KEY_RIGHT };
+	bench_session *bench = args;
+	session *session = bench->session;
+	struct timespec sleep_time = { 0, (long)SNAKE_MOVE_INTERVAL };
+	pthread_setname_np(pthread_self(), "input");
+	while (tw_now() < bench->end) {
+		nanosleep(&sleep_time, NULL);
+		if (rand_r(&session->seed) % 4 == 0) {
+			m_lock(session->monitor, __func__);
+			i_handle_received_key(session->monitor, keys[rand_r(&session->seed) % 4]);
+			m_unlock(session->monitor);
+		}
+	}
+	m_lock(session->monitor, __func__);
+	bench->stop = 1;
+	i_handle_exit(session->monitor);
+	m_unlock(session->monitor);
+	return NULL;
+}
+
+/*
+ * Runs sessions with three threads each, same as the interactive game does
+ * \RETURNS: number of rendered ticks, 0 on failure
+ */
+static unsigned long bench_sessions_threads(session **const sessions, const size_t count,
+					    const uint64_t duration)
+{
+	bench_session *benches = calloc(count, sizeof(struct bench_session));
+	if (!benches) {
+		perror("ERROR: bench calloc failed\n");
+		return 0;
+	}
+	uint64_t end = tw_now() + duration;
+	void *(*routines[THREAD_TYPE_COUNT])(void *) = { bench_input_thread, bench_game_thread,
+							 bench_windows_thread };
+	size_t started = 0;
+	for (; started < count; started++) {
+		benches[started].session = sessions[started];
+		benches[started].end = end;
+		short failed = 0;
+		for (int thread = 0; thread < THREAD_TYPE_COUNT && !failed; thread++) {
+			failed = pthread_create(&benches[started].threads[thread], NULL,
+						routines[thread], &benches[started])
+				 != 0;
+		}
+		if (failed) {
+			/* Threads that were started stop on their own once the end is reached */
+			fprintf(stderr, "ERROR: thread limit reached after %zu sessions\n", started);
+			exit(EXIT_FAILURE);
+		}
+	}
+	unsigned long renders = 0;
+	for (size_t i = 0; i < started; i++) {
+		for (int thread = 0; thread < THREAD_TYPE_COUNT; thread++) {
+			pthread_join(benches[i].threads[thread], NULL);
+		}
+		renders += benches[i].renders;
+	}
+	free(benches);
+	return renders;
+}
+
+/*
+ * Compares sessions driven by one event loop thread against three threads per session
+ */
+static int bench_sessions(int argc, char *argv[])
+{
+	long count = 1000;
+	long seconds = 5;
+	short threaded = 0;
+	const char *log_path = NULL;
+	int option;
+	while ((option = getopt(argc, argv, "n:d:e:L:")) != -1) {
+		switch (option) {
+		case 'n':
+			count = atol(optarg);
+			break;
+		case 'd':
+			seconds = atol(optarg);
+			break;
+		case 'e':
+			threaded = strcmp(optarg, "threads") == 0;
+			break;
+		case 'L':
+			log_path = optarg;
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+	if (count < 1 || seconds < 1) {
+		fprintf(stderr, "ERROR: invalid number of sessions or duration\n");
+		return EXIT_FAILURE;
+	}
+
+	if (log_path && !el_initialize(log_path)) {
+		return EXIT_FAILURE;
+	}
+	usage empty, before, after;
+	u_sample(&empty);
+	session **sessions = calloc((size_t)count, sizeof(struct session *));
+	if (!sessions) {
+		perror("ERROR: bench calloc failed\n");
+		return EXIT_FAILURE;
+	}
+	for (long i = 0; i < count; i++) {
+		sessions[i] = se_malloc(BENCH_BOARD_WIDTH, BENCH_BOARD_HEIGHT);
+		if (!sessions[i]) {
+			return EXIT_FAILURE;
+		}
+		se_initialize(sessions[i], NULL);
+	}
+
+	uint64_t duration = (uint64_t)seconds * 1000000000;
+	unsigned long ticks = 0;
+	u_sample(&before);
+	if (threaded) {
+		ticks = bench_sessions_threads(sessions, (size_t)count, duration);
+	} else {
+		se_run_headless(sessions, (size_t)count, duration);
+		for (long i = 0; i < count; i++) {
+			ticks += sessions[i]->ticks;
+		}
+	}
+	u_sample(&after);
+
+	size_t state = 0;
+	for (long i = 0; i < count; i++) {
+		state += se_memory_usage(sessions[i]);
+		se_free(&sessions[i]);
+	}
+	free(sessions);
+	el_finalize();
+
+	size_t stack = 0;
+	pthread_attr_t attributes;
+	if (threaded && pthread_attr_init(&attributes) == 0) {
+		pthread_attr_getstacksize(&attributes, &stack);
+		pthread_attr_destroy(&attributes);
+		stack *= THREAD_TYPE_COUNT;
+	}
+	printf("mode: %s, sessions: %ld, threads: %ld\n", threaded ? "threads" : "loop", count,
+	       threaded ? count * THREAD_TYPE_COUNT : 1);
+	u_report(stdout, "sessions", &before, &after, ticks);
+	m_profile_report(stdout);
+	a_report(stdout);
+	el_report(stdout);
+	printf("memory per session: %zu bytes state, %zu bytes stack reserve, %zu bytes resident\n",
+	       state / (size_t)count, stack,
+	       after.resident > empty.resident ? (after.resident - empty.resident) / (size_t)count
+					       : 0);
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Number of preallocated game states clones are written to in turn
+ */
+#define BENCH_CLONE_SLOTS 256
+
+/*
+ * Grows snake to length along rows of the board, turning back at the walls
+ */
+static void bench_clone_grow(snake *const snake, board *const board, const size_t length)
+{
+	int inner = board->width - 2;
+	s_coordinates head = { 1, 1 };
+	s_initialize_at(snake, board, head);
+	for (size_t i = 1; i < length; i++) {
+		int row = (int)i / inner;
+		int column = (int)i % inner;
+		snake->head.x = (row % 2 ? inner - 1 - column : column) + 1;
+		snake->head.y = row + 1;
+		s_push_snake_head(snake);
+	}
+}
+
+/*
+ * Measures snapshots of a live snake and clones of a game state for growing snake lengths
+ */
+static int bench_clone(int argc, char *argv[])
+{
+	long count = 1000000;
+	int option;
+	while ((option = getopt(argc, argv, "n:")) != -1) {
+		switch (option) {
+		case 'n':
+			count = atol(optarg);
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+	if (count < 1) {
+		fprintf(stderr, "ERROR: invalid number of clones\n");
+		return EXIT_FAILURE;
+	}
+
+	int status = EXIT_FAILURE;
+	board *board = b_malloc(BENCH_BOARD_WIDTH, BENCH_BOARD_HEIGHT);
+	snake *snake = s_malloc();
+	monitor *monitor = m_malloc();
+	game_state *source = gs_malloc(BENCH_BOARD_WIDTH, BENCH_BOARD_HEIGHT);
+	size_t size = gs_size(BENCH_BOARD_WIDTH, BENCH_BOARD_HEIGHT);
+	unsigned char *slots = a_aligned(ALLOCATOR_TAG_STATE, 64, size * BENCH_CLONE_SLOTS);
+	if (!board || !snake || !monitor || !source || !slots) {
+		goto bench_clone_free;
+	}
+	m_initialize(monitor);
+
+	const size_t lengths[] = { 1, 16, 256, 1024, source->capacity };
+	printf("state size: %zu bytes\n", size);
+	printf("%8s %14s %14s %16s\n", "length", "snapshot ns", "clone ns", "clones per s");
+	for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+		s_clear_snake_body(snake);
+		bench_clone_grow(snake, board, lengths[l]);
+
+		long snapshots = count / 16 + 1;
+		uint64_t start = tw_now();
+		for (long i = 0; i < snapshots; i++) {
+			gs_snapshot(source, snake, monitor);
+		}
+		uint64_t snapshot = tw_now() - start;
+
+		start = tw_now();
+		for (long i = 0; i < count; i++) {
+			gs_clone((game_state *)(slots + (size_t)(i % BENCH_CLONE_SLOTS) * size), source);
+		}
+		uint64_t clone = tw_now() - start;
+		if (((game_state *)slots)->length != source->length) {
+			fprintf(stderr, "ERROR: clone does not match its source\n");
+			goto bench_clone_free;
+		}
+		printf("%8u %14.1f %14.1f %16.0f\n", source->length, (double)snapshot / (double)snapshots,
+		       (double)clone / (double)count, (double)count * 1e9 / (double)clone);
+	}
+	s_clear_snake_body(snake);
+	a_report(stdout);
+	status = EXIT_SUCCESS;
+
+bench_clone_free:
+	a_free(ALLOCATOR_TAG_STATE, slots, size * BENCH_CLONE_SLOTS);
+	gs_free(&source);
+	if (monitor) {
+		m_free(&monitor);
+	}
+	if (snake) {
+		s_free(&snake);
+	}
+	b_free(&board);
+	return status;
+}
+
+/*
+ * Side of the board long bodies are grown on, its inside holds 2^20 segments
+ */
+#define BENCH_BODY_SIDE 1026
+
+/*
+ * Measures growing, walking and clearing long bodies kept in the queue and in the compact body
+ */
+static int bench_body(int argc, char *argv[])
+{
+	long longest = (BENCH_BODY_SIDE - 2) * (BENCH_BODY_SIDE - 2);
+	int option;
+	while ((option = getopt(argc, argv, "l:")) != -1) {
+		switch (option) {
+		case 'l':
+			longest = atol(optarg);
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+	if (longest < 1 || longest > (BENCH_BODY_SIDE - 2) * (BENCH_BODY_SIDE - 2)) {
+		fprintf(stderr, "ERROR: invalid body length\n");
+		return EXIT_FAILURE;
+	}
+
+	board *board = b_malloc(BENCH_BODY_SIDE, BENCH_BODY_SIDE);
+	if (!board) {
+		return EXIT_FAILURE;
+	}
+	const size_t lengths[] = { 1024, 65536, (size_t)longest };
+	printf("%8s %9s %12s %10s %10s %12s %10s\n", "body", "length", "bytes", "per cell",
+	       "push ns", "walk ns/cell", "pop ns");
+	for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+		if (lengths[l] > (size_t)longest) {
+			continue;
+		}
+		for (short compact = 0; compact < 2; compact++) {
+			snake *snake = s_malloc();
+			if (!snake || (compact && !s_use_compact_body(snake))) {
+				if (snake) {
+					s_free(&snake);
+				}
+				b_free(&board);
+				return EXIT_FAILURE;
+			}
+			uint64_t start = tw_now();
+			bench_clone_grow(snake, board, lengths[l]);
+			uint64_t push = tw_now() - start;
+			size_t bytes = s_body_memory_usage(snake);
+
+			long sum = 0;
+			s_body_iterator cell;
+			start = tw_now();
+			for (short more = s_body_begin(snake, &cell); more; more = s_body_next(&cell)) {
+				sum += cell.at.x;
+			}
+			uint64_t walk = tw_now() - start;
+
+			size_t length = s_body_length(snake);
+			start = tw_now();
+			s_clear_snake_body(snake);
+			uint64_t pop = tw_now() - start;
+			printf("%8s %9zu %12zu %10.2f %10.1f %12.2f %10.1f\n",
+			       compact ? "compact" : "queue", length, bytes,
+			       (double)bytes / (double)length, (double)push / (double)length,
+			       (double)walk / (double)length, (double)pop / (double)length);
+			if (sum <= 0) {
+				fprintf(stderr, "ERROR: body walk found no segments\n");
+			}
+			s_free(&snake);
+		}
+	}
+	a_report(stdout);
+	b_free(&board);
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Actions one batch thread cycles through, per environment
+ */
+#define BENCH_BATCH_ACTIONS 64
+
+/*
+ * Batch stepped by one thread of the batch benchmark
+ */
+typedef struct bench_batch {
+	batch *batch;
+	uint8_t *actions;
+	long steps;
+	pthread_t thread;
+} bench_batch;
+
+/*
+ * Fills actions with random moves, a fifth of them keeping the direction
+ */
+static void bench_batch_actions(uint8_t *const actions, const size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		actions[i] = (uint8_t)(rand() % 5);
+	}
+}
+
+static void *bench_batch_thread(void *args)
+{
+	bench_batch *bench = args;
+	batch *batch = bench->batch;
+	float *rewards = malloc(batch->count * sizeof(float));
+	uint8_t *dones = malloc(batch->count);
+	if (!rewards || !dones) {
+		perror("ERROR: bench malloc failed\n");
+		free(rewards);
+		free(dones);
+		return NULL;
+	}
+	for (long step = 0; step < bench->steps; step++) {
+		be_step(batch, bench->actions + (size_t)(step % BENCH_BATCH_ACTIONS) * batch->count,
+			rewards, dones);
+	}
+	free(rewards);
+	free(dones);
+	return NULL;
+}
+
+/*
+ * Steps batches of environments with random actions, one batch per thread, and compares them
+ * with stepping the same number of game states one at a time
+ */
+static int bench_batch_run(int argc, char *argv[])
+{
+	long count = 4096;
+	long steps = 1000;
+	long threads = 1;
+	int option;
+	while ((option = getopt(argc, argv, "n:s:t:")) != -1) {
+		switch (option) {
+		case 'n':
+			count = atol(optarg);
+			break;
+		case 's':
+			steps = atol(optarg);
+			break;
+		case 't':
+			threads = atol(optarg);
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+	if (count < 1 || count > UINT32_MAX || steps < 1 || threads < 1) {
+		fprintf(stderr, "ERROR: invalid batch benchmark options\n");
+		return EXIT_FAILURE;
+	}
+
+	int status = EXIT_FAILURE;
+	size_t per_step = (size_t)count;
+	bench_batch *benches = calloc((size_t)threads, sizeof(struct bench_batch));
+	uint8_t *actions = malloc(per_step * BENCH_BATCH_ACTIONS);
+	game_state **states = calloc(per_step, sizeof(game_state *));
+	game_state *initial = gs_malloc(BENCH_BOARD_WIDTH, BENCH_BOARD_HEIGHT);
+	board *board = b_malloc(BENCH_BOARD_WIDTH, BENCH_BOARD_HEIGHT);
+	snake *snake = s_malloc();
+	if (!benches || !actions || !states || !initial || !board || !snake) {
+		goto bench_batch_free;
+	}
+	bench_batch_actions(actions, per_step * BENCH_BATCH_ACTIONS);
+	for (long i = 0; i < threads; i++) {
+		benches[i].batch = be_malloc((uint32_t)count, BENCH_BOARD_WIDTH, BENCH_BOARD_HEIGHT,
+					     (uint64_t)(i * count));
+		benches[i].actions = actions;
+		benches[i].steps = steps;
+		if (!benches[i].batch) {
+			goto bench_batch_free;
+		}
+	}
+
+	usage before, after;
+	u_sample(&before);
+	long started = 0;
+	for (; started < threads; started++) {
+		if (pthread_create(&benches[started].thread, NULL, bench_batch_thread,
+				   &benches[started])) {
+			fprintf(stderr, "ERROR: creating batch thread failed\n");
+			break;
+		}
+	}
+	uint64_t resets = 0;
+	for (long i = 0; i < started; i++) {
+		pthread_join(benches[i].thread, NULL);
+		resets += benches[i].batch->resets;
+	}
+	u_sample(&after);
+	if (started < threads) {
+		goto bench_batch_free;
+	}
+	double env_steps = (double)count * (double)steps * (double)threads;
+	double wall = (double)(after.time - before.time) / 1e9;
+	double cpu = (double)u_cpu_time(&before, &after) / 1e9;
+	printf("batch: %ld threads x %ld environments, %.0f env-steps per second,"
+	       " %.0f per core, %.1f steps per game\n",
+	       threads, count, env_steps / wall, env_steps / cpu,
+	       env_steps / (double)(resets ? resets : 1));
+
+	/* Baseline: the same games as game states, stepped one after another */
+	s_seed(snake, 0);
+	s_initialize(snake, board);
+	gs_snapshot(initial, snake, NULL);
+	s_clear_snake_body(snake);
+	for (size_t i = 0; i < per_step; i++) {
+		if (!(states[i] = gs_malloc(BENCH_BOARD_WIDTH, BENCH_BOARD_HEIGHT))) {
+			goto bench_batch_free;
+		}
+		gs_clone(states[i], initial);
+	}
+	uint64_t start = tw_now();
+	for (long step = 0; step < steps; step++) {
+		const uint8_t *step_actions = actions + (size_t)(step % BENCH_BATCH_ACTIONS) * per_step;
+		for (size_t i = 0; i < per_step; i++) {
+			if (!gs_step(states[i], (m_snake_move)step_actions[i])) {
+				gs_clone(states[i], initial);
+			}
+		}
+	}
+	double single = (double)(tw_now() - start) / 1e9;
+	printf("game states: 1 thread x %ld states, %.0f env-steps per second\n", count,
+	       (double)count * (double)steps / single);
+	a_report(stdout);
+	status = EXIT_SUCCESS;
+
+bench_batch_free:
+	for (size_t i = 0; states && i < per_step; i++) {
+		gs_free(&states[i]);
+	}
+	for (long i = 0; benches && i < threads; i++) {
+		be_free(&benches[i].batch);
+	}
+	free(states);
+	free(actions);
+	free(benches);
+	gs_free(&initial);
+	if (snake) {
+		s_free(&snake);
+	}
+	b_free(&board);
+	return status;
+}
+
+/*
+ * Steps environments of a shared region as a trainer would: actions written in place, one
+ * round trip per step, rewards and dones read in place
+ * \RETURNS: nanoseconds taken, 0 if the server stopped early
+ */
+static uint64_t bench_env_trainer(es_region *const region, const uint8_t *const actions,
+				  const long steps, double *const reward)
+{
+	uint32_t count = region->header->count;
+	uint8_t *slots = es_get_array(region, ENV_SERVER_ACTIONS);
+	const float *rewards = es_get_array(region, ENV_SERVER_REWARDS);
+	uint64_t start = tw_now();
+	for (long step = 0; step < steps; step++) {
+		memcpy(slots, actions + (size_t)(step % BENCH_BATCH_ACTIONS) * count, count);
+		if (!es_step(region)) {
+			return 0;
+		}
+		for (uint32_t i = 0; i < count; i++) {
+			*reward += rewards[i];
+		}
+	}
+	return tw_now() - start;
+}
+
+/*
+ * Test client of the shared memory environment server, against snake-server -E path or
+ * a server forked for the run, compared with stepping a batch in the same process
+ */
+static int bench_env(int argc, char *argv[])
+{
+	const char *path = NULL;
+	long count = 64;
+	long steps = 100000;
+	int option;
+	while ((option = getopt(argc, argv, "p:n:s:")) != -1) {
+		switch (option) {
+		case 'p':
+			path = optarg;
+			break;
+		case 'n':
+			count = atol(optarg);
+			break;
+		case 's':
+			steps = atol(optarg);
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+	if (count < 1 || count > UINT32_MAX || steps < 1) {
+		fprintf(stderr, "ERROR: invalid environment benchmark options\n");
+		return EXIT_FAILURE;
+	}
+
+	char own_path[64];
+	es_region *server = NULL;
+	pid_t child = -1;
+	if (!path) {
+		snprintf(own_path, sizeof(own_path), "%s/snake-bench-%ld",
+			 access("/dev/shm", W_OK) == 0 ? "/dev/shm" : "/tmp", (long)getpid());
+		path = own_path;
+		server = es_create(path, (uint32_t)count, BENCH_BOARD_WIDTH, BENCH_BOARD_HEIGHT, 0);
+		if (!server) {
+			return EXIT_FAILURE;
+		}
+		child = fork();
+		if (child == 0) {
+			es_serve(server);
+			_exit(EXIT_SUCCESS);
+		}
+		if (child < 0) {
+			perror("ERROR: fork failed\n");
+			es_close(&server);
+			return EXIT_FAILURE;
+		}
+	}
+
+	int status = EXIT_FAILURE;
+	es_region *region = es_attach(path);
+	uint8_t *actions = NULL;
+	batch *local = NULL;
+	if (!region) {
+		goto bench_env_free;
+	}
+	count = region->header->count;
+	actions = malloc((size_t)count * BENCH_BATCH_ACTIONS);
+	local = be_malloc((uint32_t)count, region->header->width, region->header->height, 0);
+	if (!actions || !local) {
+		goto bench_env_free;
+	}
+	bench_batch_actions(actions, (size_t)count * BENCH_BATCH_ACTIONS);
+
+	double reward = 0;
+	uint64_t shared = bench_env_trainer(region, actions, steps, &reward);
+	if (!shared) {
+		fprintf(stderr, "ERROR: environment server stopped\n");
+		goto bench_env_free;
+	}
+	uint64_t start = tw_now();
+	for (long step = 0; step < steps; step++) {
+		be_step(local, actions + (size_t)(step % BENCH_BATCH_ACTIONS) * (size_t)count, NULL,
+			NULL);
+	}
+	uint64_t direct = tw_now() - start;
+	printf("shared region: %ld environments, %.0f round trips per second,"
+	       " %.0f env-steps per second, %.2f reward per step\n",
+	       count, (double)steps * 1e9 / (double)shared,
+	       (double)steps * (double)count * 1e9 / (double)shared, reward / (double)steps);
+	printf("same process: %.0f steps per second, round trip overhead %.0f ns per step\n",
+	       (double)steps * 1e9 / (double)direct,
+	       ((double)shared - (double)direct) / (double)steps);
+	status = EXIT_SUCCESS;
+
+bench_env_free:
+	if (region) {
+		es_stop(region);
+	}
+	if (child > 0) {
+		waitpid(child, NULL, 0);
+	}
+	be_free(&local);
+	free(actions);
+	es_close(&region);
+	es_close(&server);
+	return status;
+}
+
+/*
+ * Obstacle layouts flood fills are measured on
+ */
+typedef enum bench_fill_layout {
+	BENCH_FILL_OPEN,
+	BENCH_FILL_ROWS,
+	BENCH_FILL_COLUMNS,
+	BENCH_FILL_LAYOUT_COUNT,
+} bench_fill_layout;
+
+static const char *const bench_fill_layouts[] = { "open", "rows", "columns" };
+
+/*
+ * Sets free cells of layout: a quarter of the cells blocked at random, or walls every other row
+ * or column with a gap at alternating ends, the longest way through the board
+ */
+static void bench_fill_build(bitboard *const free, const bench_fill_layout layout)
+{
+	bb_clear(free);
+	for (int y = 0; y < free->height; y++) {
+		for (int x = 0; x < free->width; x++) {
+			short open = 1;
+			switch (layout) {
+			case BENCH_FILL_OPEN:
+				open = rand() % 4 != 0 || (x == 0 && y == 0);
+				break;
+			case BENCH_FILL_ROWS:
+				open = y % 2 == 0 || x == (y % 4 == 1 ? free->width - 1 : 0);
+				break;
+			default:
+				open = x % 2 == 0 || y == (x % 4 == 1 ? free->height - 1 : 0);
+				break;
+			}
+			if (open) {
+				bb_set(free, x, y);
+			}
+		}
+	}
+}
+
+/*
+ * Breadth-first flood fill over single cells the bitboard fill is compared with
+ * \RETURNS: number of cells reachable from x, y
+ */
+static size_t bench_fill_queue(const bitboard *const free, unsigned char *const seen,
+			       uint32_t *const queue, const int x, const int y)
+{
+	int width = free->width;
+	memset(seen, 0, (size_t)width * (size_t)free->height);
+	if (!bb_get(free, x, y)) {
+		return 0;
+	}
+	size_t head = 0;
+	size_t tail = 0;
+	queue[tail++] = (uint32_t)(y * width + x);
+	seen[y * width + x] = 1;
+	while (head < tail) {
+		int cell = (int)queue[head++];
+		const int neighbours[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+		for (int i = 0; i < 4; i++) {
+			int next_x = cell % width + neighbours[i][0];
+			int next_y = cell / width + neighbours[i][1];
+			if (bb_get(free, next_x, next_y) && !seen[next_y * width + next_x]) {
+				seen[next_y * width + next_x] = 1;
+				queue[tail++] = (uint32_t)(next_y * width + next_x);
+			}
+		}
+	}
+	return tail;
+}
+
+/*
+ * Measures bitboard flood fills against a breadth-first fill for several board sizes and layouts
+ */
+static int bench_fill(int argc, char *argv[])
+{
+	long count = 20000;
+	int option;
+	while ((option = getopt(argc, argv, "n:")) != -1) {
+		switch (option) {
+		case 'n':
+			count = atol(optarg);
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+	if (count < 1) {
+		fprintf(stderr, "ERROR: invalid number of fills\n");
+		return EXIT_FAILURE;
+	}
+
+	const int sizes[][2] = { { BENCH_BOARD_WIDTH, BENCH_BOARD_HEIGHT }, { 256, 256 },
+				 { 1024, 1024 } };
+	printf("%11s %8s %10s %14s %14s %8s\n", "board", "layout", "cells", "bitboard ns",
+	       "queue ns", "speedup");
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		int width = sizes[i][0];
+		int height = sizes[i][1];
+		size_t area = (size_t)width * (size_t)height;
+		int status = EXIT_FAILURE;
+		bitboard *space = bb_malloc(width, height);
+		bitboard *reach = bb_malloc(width, height);
+		unsigned char *seen = malloc(area);
+		uint32_t *queue = malloc(area * sizeof(uint32_t));
+		if (!space || !reach || !seen || !queue) {
+			goto bench_fill_free;
+		}
+		/* Larger boards get fewer fills to take about as long as the smallest one */
+		size_t scale = area / (BENCH_BOARD_WIDTH * BENCH_BOARD_HEIGHT);
+		long fills = count / (long)(scale ? scale : 1) + 1;
+		for (int layout = 0; layout < BENCH_FILL_LAYOUT_COUNT; layout++) {
+			bench_fill_build(space, (bench_fill_layout)layout);
+			size_t cells = 0;
+			uint64_t start = tw_now();
+			for (long fill = 0; fill < fills; fill++) {
+				cells = bb_fill(space, reach, 0, 0);
+			}
+			uint64_t bitboard = tw_now() - start;
+			size_t expected = 0;
+			start = tw_now();
+			for (long fill = 0; fill < fills; fill++) {
+				expected = bench_fill_queue(space, seen, queue, 0, 0);
+			}
+			uint64_t queued = tw_now() - start;
+			if (cells != expected) {
+				fprintf(stderr, "ERROR: bitboard fill reached %zu cells instead of %zu\n",
+					cells, expected);
+				goto bench_fill_free;
+			}
+			printf("%5dx%-5d %8s %10zu %14.0f %14.0f %7.1fx\n", width, height,
+			       bench_fill_layouts[layout], cells, (double)bitboard / (double)fills,
+			       (double)queued / (double)fills, (double)queued / (double)bitboard);
+		}
+		status = EXIT_SUCCESS;
+
+bench_fill_free:
+		free(queue);
+		free(seen);
+		bb_free(&reach);
+		bb_free(&space);
+		if (status != EXIT_SUCCESS) {
+			return status;
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Side of the board observations are measured on
+ */
+#define BENCH_OBSERVE_SIDE 100
+
+/*
+ * Steps of the 16 rays clockwise from up, kept apart from the observation tables on purpose
+ */
+static const int bench_observe_steps[OBSERVATION_MAX_RAYS][2] = {
+	{ 0, -1 }, { 1, -2 }, { 1, -1 }, { 2, -1 }, { 1, 0 },	{ 2, 1 },   { 1, 1 },	{ 1, 2 },
+	{ 0, 1 },  { -1, 2 }, { -1, 1 }, { -2, 1 }, { -1, 0 }, { -2, -1 }, { -1, -1 }, { -1, -2 },
+};
+
+/*
+ * Casts rays of state one cell at a time, the reference the vector casts are compared with
+ */
+static void bench_observe_walk(const game_state *const state, const m_snake_move direction,
+			       const unsigned int rays, float *const observation)
+{
+	int width = state->width;
+	int head_x = gs_head(state) % width;
+	int head_y = gs_head(state) / width;
+	unsigned int heading = direction == SNAKE_MOVE_RIGHT  ? 4
+			       : direction == SNAKE_MOVE_DOWN ? 8
+			       : direction == SNAKE_MOVE_LEFT ? 12
+							      : 0;
+	for (unsigned int ray = 0; ray < rays; ray++) {
+		const int *step
+			= bench_observe_steps[(heading + ray * (OBSERVATION_MAX_RAYS / rays))
+					      % OBSERVATION_MAX_RAYS];
+		int distance = 1;
+		int body = 0;
+		int food = 0;
+		for (;; distance++) {
+			int x = head_x + distance * step[0];
+			int y = head_y + distance * step[1];
+			if (x < 1 || y < 1 || x > width - 2 || y > state->height - 2) {
+				break;
+			}
+			int cell = y * width + x;
+			if (!body && ((state->data[cell >> 6] >> (cell & 63)) & 1)) {
+				body = distance;
+			}
+			if (!food && cell == state->food) {
+				food = distance;
+			}
+		}
+		observation[ray * OBSERVATION_FEATURES] = 1.0f / (float)distance;
+		observation[ray * OBSERVATION_FEATURES + 1] = body ? 1.0f / (float)body : 0.0f;
+		observation[ray * OBSERVATION_FEATURES + 2] = food ? 1.0f / (float)food : 0.0f;
+	}
+}
+
+/*
+ * Measures ray cast observations against a cell by cell walk for growing snake lengths
+ */
+static int bench_observe(int argc, char *argv[])
+{
+	long count = 1000000;
+	int option;
+	while ((option = getopt(argc, argv, "n:")) != -1) {
+		switch (option) {
+		case 'n':
+			count = atol(optarg);
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+	if (count < 1) {
+		fprintf(stderr, "ERROR: invalid number of observations\n");
+		return EXIT_FAILURE;
+	}
+
+	int status = EXIT_FAILURE;
+	board *board = b_malloc(BENCH_OBSERVE_SIDE, BENCH_OBSERVE_SIDE);
+	snake *snake = s_malloc();
+	monitor *monitor = m_malloc();
+	game_state *state = gs_malloc(BENCH_OBSERVE_SIDE, BENCH_OBSERVE_SIDE);
+	if (!board || !snake || !monitor || !state) {
+		goto bench_observe_free;
+	}
+	m_initialize(monitor);
+
+	float cast[OBSERVATION_MAX_RAYS * OBSERVATION_FEATURES];
+	float walked[OBSERVATION_MAX_RAYS * OBSERVATION_FEATURES];
+	const size_t lengths[] = { 1, 256, 2048, 8192 };
+	float sum = 0.0f;
+	printf("board: %dx%d\n", BENCH_OBSERVE_SIDE, BENCH_OBSERVE_SIDE);
+	printf("%8s %6s %14s %14s %8s\n", "length", "rays", "cast ns", "walk ns", "speedup");
+	for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+		s_clear_snake_body(snake);
+		bench_clone_grow(snake, board, lengths[l]);
+		gs_snapshot(state, snake, monitor);
+		for (unsigned int rays = 8; rays <= OBSERVATION_MAX_RAYS; rays *= 2) {
+			/* Headings take turns so every ray order is measured */
+			for (int direction = SNAKE_MOVE_UP; direction <= SNAKE_MOVE_LEFT; direction++) {
+				ob_cast(state->data, state->width, state->height,
+					gs_head(state) % state->width, gs_head(state) / state->width,
+					state->food % state->width, state->food / state->width,
+					(m_snake_move)direction, rays, cast);
+				bench_observe_walk(state, (m_snake_move)direction, rays, walked);
+				if (memcmp(cast, walked, rays * OBSERVATION_FEATURES * sizeof(float))) {
+					fprintf(stderr, "ERROR: ray casts do not match the walk\n");
+					goto bench_observe_free;
+				}
+			}
+			uint64_t start = tw_now();
+			for (long i = 0; i < count; i++) {
+				state->direction = (uint8_t)(i % 4 + 1);
+				ob_from_state(state, rays, cast);
+				sum += cast[1];
+			}
+			uint64_t casting = tw_now() - start;
+			long walks = count / 4 + 1;
+			start = tw_now();
+			for (long i = 0; i < walks; i++) {
+				bench_observe_walk(state, (m_snake_move)(i % 4 + 1), rays, walked);
+				sum += walked[1];
+			}
+			uint64_t walking = tw_now() - start;
+			double cast_ns = (double)casting / (double)count;
+			double walk_ns = (double)walking / (double)walks;
+			printf("%8u %6u %14.1f %14.1f %7.1fx\n", state->length, rays, cast_ns, walk_ns,
+			       walk_ns / cast_ns);
+		}
+	}
+	/* Printed so the measured loops are not optimised away */
+	printf("checksum: %.3f\n", (double)sum);
+	s_clear_snake_body(snake);
+	status = EXIT_SUCCESS;
+
+bench_observe_free:
+	gs_free(&state);
+	if (monitor) {
+		m_free(&monitor);
+	}
+	if (snake) {
+		s_free(&snake);
+	}
+	b_free(&board);
+	return status;
+}
+
+/*
+ * Side of the maps generated by the map benchmark
+ */
+#define BENCH_MAP_SIDE 4096
+
+/*
+ * Writes a map of side cells with random blocks of walls over about a fifth of it to path,
+ * and the same map as text to text_path
+ * \RETURNS: 1 on success, 0 on failure
+ */
+static short bench_map_generate(const char *const path, const char *const text_path,
+				const int side)
+{
+	size_t words = ((size_t)side * (size_t)side + 63) / 64;
+	uint64_t *walls = calloc(words, sizeof(uint64_t));
+	char *line = malloc((size_t)side);
+	FILE *text = fopen(text_path, "w");
+	short status = 0;
+	if (!walls || !line || !text) {
+		perror("ERROR: map generation failed\n");
+		goto bench_map_generate_free;
+	}
+	long blocks = (long)side * side / 160;
+	for (long i = 0; i < blocks; i++) {
+		int left = rand() % side;
+		int top = rand() % side;
+		int right = left + rand() % 8;
+		int bottom = top + rand() % 8;
+		for (int y = top; y <= bottom && y < side; y++) {
+			for (int x = left; x <= right && x < side; x++) {
+				size_t cell = (size_t)y * (size_t)side + (size_t)x;
+				walls[cell >> 6] |= 1ULL << (cell & 63);
+			}
+		}
+	}
+	/* Map files need the border, text maps get it when they are imported */
+	for (int i = 0; i < side; i++) {
+		size_t cells[4] = { (size_t)i, (size_t)(side - 1) * (size_t)side + (size_t)i,
+				    (size_t)i * (size_t)side,
+				    (size_t)i * (size_t)side + (size_t)side - 1 };
+		for (int j = 0; j < 4; j++) {
+			walls[cells[j] >> 6] |= 1ULL << (cells[j] & 63);
+		}
+	}
+	int spawn = side / 2;
+	for (int y = 1; y < side - 1; y++) {
+		for (int x = 1; x < side - 1; x++) {
+			size_t cell = (size_t)y * (size_t)side + (size_t)x;
+			if (y == spawn && x >= spawn - 1 && x <= spawn + 1) {
+				walls[cell >> 6] &= ~(1ULL << (cell & 63));
+			}
+			short wall = (walls[cell >> 6] >> (cell & 63)) & 1;
+			line[x - 1] = wall ? '#' : (y == spawn && x == spawn ? '@' : '.');
+		}
+		line[side - 2] = '\n';
+		fwrite(line, 1, (size_t)side - 1, text);
+	}
+	status = mp_write(path, side, side, spawn, spawn, walls);
+
+bench_map_generate_free:
+	if (text) {
+		fclose(text);
+	}
+	free(line);
+	free(walls);
+	return status;
+}
+
+/*
+ * Measures importing a text map, loading the map file and wall queries on a random map,
+ * or imports the text map given with -i into the map file given with -o
+ */
+static int bench_map(int argc, char *argv[])
+{
+	int side = BENCH_MAP_SIDE;
+	long count = 10000000;
+	const char *input = NULL;
+	const char *output = NULL;
+	int option;
+	while ((option = getopt(argc, argv, "s:n:i:o:")) != -1) {
+		switch (option) {
+		case 's':
+			side = atoi(optarg);
+			break;
+		case 'n':
+			count = atol(optarg);
+			break;
+		case 'i':
+			input = optarg;
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+	if (side < 3 || side > MAP_MAX_SIDE || count < 1 || (input && !output)) {
+		fprintf(stderr, "ERROR: invalid map benchmark options\n");
+		return EXIT_FAILURE;
+	}
+
+	char path[64];
+	char text_path[64];
+	snprintf(path, sizeof(path), "/tmp/snake-bench-%ld.map", (long)getpid());
+	snprintf(text_path, sizeof(text_path), "/tmp/snake-bench-%ld.txt", (long)getpid());
+	uint64_t start = tw_now();
+	if (input) {
+		if (!mp_import(input, output)) {
+			return EXIT_FAILURE;
+		}
+	} else if (!bench_map_generate(output ? output : path, text_path, side)) {
+		unlink(text_path);
+		return EXIT_FAILURE;
+	}
+	uint64_t generated = tw_now() - start;
+	if (!input) {
+		start = tw_now();
+		short imported = mp_import(text_path, path);
+		generated = tw_now() - start;
+		unlink(text_path);
+		if (!imported) {
+			unlink(path);
+			return EXIT_FAILURE;
+		}
+	}
+
+	int status = EXIT_FAILURE;
+	start = tw_now();
+	map *map = mp_load(output ? output : path);
+	uint64_t loaded = tw_now() - start;
+	board *board = map ? b_malloc(map->width, map->height) : NULL;
+	if (!map || !board || !b_use_map(board, map)) {
+		goto bench_map_free;
+	}
+	printf("map: %dx%d, %zu bytes\n", map->width, map->height, map->size);
+	printf("%-24s %10.2f ms\n", input ? "text import" : "text import and write",
+	       (double)generated / 1e6);
+	printf("%-24s %10.2f ms\n", "mmap load", (double)loaded / 1e6);
+	if (input) {
+		status = EXIT_SUCCESS;
+		goto bench_map_free;
+	}
+
+	/* Queries go to random cells, so most of them miss the cache like a large map would */
+	uint32_t random = (uint32_t)rand();
+	long blocked = 0;
+	start = tw_now();
+	for (long i = 0; i < count; i++) {
+		random = random * 1664525u + 1013904223u;
+		blocked += b_is_blocked(board, (int)((random >> 8) % (uint32_t)map->width),
+					(int)((random >> 4) % (uint32_t)map->height));
+	}
+	uint64_t collisions = tw_now() - start;
+	long distance = 0;
+	start = tw_now();
+	for (long i = 0; i < count; i++) {
+		random = random * 1664525u + 1013904223u;
+		distance += mp_distance(map, (int)((random >> 8) % (uint32_t)map->width),
+					(int)((random >> 4) % (uint32_t)map->height));
+	}
+	uint64_t distances = tw_now() - start;
+	printf("%-24s %10.1f ns\n", "b_is_blocked", (double)collisions / (double)count);
+	printf("%-24s %10.1f ns\n", "mp_distance", (double)distances / (double)count);
+	printf("blocked: %.1f%%, mean distance to walls: %.2f\n",
+	       100.0 * (double)blocked / (double)count, (double)distance / (double)count);
+	a_report(stdout);
+	status = EXIT_SUCCESS;
+
+bench_map_free:
+	b_free(&board);
+	mp_free(&map);
+	unlink(path);
+	return status;
+}
+
+/*
+ * Side of the board the food field benchmark plays on
+ */
+#define BENCH_FIELD_SIDE 100
+
+/*
+ * Plays games where the snake follows the food field, keeping it up to date with repairs
+ * and measuring them against rebuilding a second field from scratch every tick
+ */
+static int bench_field(int argc, char *argv[])
+{
+	long games = 20;
+	int side = BENCH_FIELD_SIDE;
+	int option;
+	while ((option = getopt(argc, argv, "g:s:")) != -1) {
+		switch (option) {
+		case 'g':
+			games = atol(optarg);
+			break;
+		case 's':
+			side = atoi(optarg);
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+	if (games < 1 || !gs_size(side, side)) {
+		fprintf(stderr, "ERROR: invalid food field benchmark options\n");
+		return EXIT_FAILURE;
+	}
+
+	int status = EXIT_FAILURE;
+	board *board = b_malloc(side, side);
+	snake *snake = s_malloc();
+	monitor *monitor = m_malloc();
+	game_state *state = gs_malloc(side, side);
+	food_field *field = ff_malloc(side, side);
+	food_field *rebuilt = ff_malloc(side, side);
+	if (!board || !snake || !monitor || !state || !field || !rebuilt) {
+		goto bench_field_free;
+	}
+	uint64_t repaired = 0;
+	uint64_t repair_time = 0;
+	uint64_t rebuild_time = 0;
+	uint64_t ticks = 0;
+	uint64_t score = 0;
+	for (long game = 0; game < games; game++) {
+		m_initialize(monitor);
+		s_clear_snake_body(snake);
+		s_seed(snake, (uint64_t)game);
+		s_initialize(snake, board);
+		gs_snapshot(state, snake, monitor);
+		ff_follow(field, state);
+		while (state->alive) {
+			/* The snake can not turn back, it goes on and most likely dies instead */
+			m_snake_move move = ff_next(field, gs_head(state));
+			if (move == s_get_opposite_move((m_snake_move)state->direction)) {
+				move = SNAKE_MOVE_EMPTY;
+			}
+			gs_step(state, move);
+			uint64_t start = tw_now();
+			repaired += (uint64_t)ff_follow(field, state);
+			uint64_t middle = tw_now();
+			ff_rebuild(rebuilt, state->data, state->food);
+			rebuild_time += tw_now() - middle;
+			repair_time += middle - start;
+			if (memcmp(field->distance, rebuilt->distance,
+				   field->cells * sizeof(uint32_t))
+			    != 0) {
+				fprintf(stderr, "ERROR: repaired field differs at tick %lu of game %ld\n",
+					(unsigned long)state->ticks, game);
+				goto bench_field_free;
+			}
+			ticks++;
+		}
+		score += state->score;
+	}
+	s_clear_snake_body(snake);
+	printf("board: %dx%d, %ld games, %.1f score and %.0f ticks per game\n", side, side, games,
+	       (double)score / (double)games, (double)ticks / (double)games);
+	printf("%.1f%% of ticks repaired, %.1f cells visited per repair\n",
+	       100.0 * (double)repaired / (double)ticks,
+	       repaired ? (double)field->touched / (double)repaired : 0.0);
+	printf("%-10s %12.0f ns per tick\n", "follow", (double)repair_time / (double)ticks);
+	printf("%-10s %12.0f ns per tick\n", "rebuild", (double)rebuild_time / (double)ticks);
+	printf("speedup: %.1fx\n", (double)rebuild_time / (double)repair_time);
+	status = EXIT_SUCCESS;
+
+bench_field_free:
+	ff_free(&rebuilt);
+	ff_free(&field);
+	gs_free(&state);
+	if (monitor) {
+		m_free(&monitor);
+	}
+	if (snake) {
+		s_free(&snake);
+	}
+	b_free(&board);
+	return status;
+}
+
+/*
+ * Side of the board the food set benchmark places items on
+ */
+#define BENCH_FOOD_SIDE 100
+
+/*
+ * Fills a food set and measures its lookups against scanning the items, the way a list of food
+ * would be searched, and eating an item followed by placing a new one
+ */
+static int bench_food(int argc, char *argv[])
+{
+	long items = 500;
+	long count = 1000000;
+	int side = BENCH_FOOD_SIDE;
+	int option;
+	while ((option = getopt(argc, argv, "i:n:s:")) != -1) {
+		switch (option) {
+		case 'i':
+			items = atol(optarg);
+			break;
+		case 'n':
+			count = atol(optarg);
+			break;
+		case 's':
+			side = atoi(optarg);
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+	if (items < 1 || count < 1 || side < 3 || (long)side * side <= items) {
+		fprintf(stderr, "ERROR: invalid food set benchmark options\n");
+		return EXIT_FAILURE;
+	}
+	food_set *set = fs_malloc(side, side, (uint32_t)items);
+	if (!set) {
+		return EXIT_FAILURE;
+	}
+	uint32_t cells = (uint32_t)side * (uint32_t)side;
+	uint64_t random = s_seed_random(1);
+	while (set->count < set->capacity) {
+		fs_add(set, s_random(&random) % cells);
+	}
+
+	long found = 0;
+	uint64_t start = tw_now();
+	for (long i = 0; i < count; i++) {
+		found += fs_has(set, s_random(&random) % cells);
+	}
+	uint64_t lookups = tw_now() - start;
+	long scanned = 0;
+	start = tw_now();
+	for (long i = 0; i < count; i++) {
+		uint32_t cell = s_random(&random) % cells;
+		uint32_t index = 0;
+		while (index < set->count && fs_item(set, index) != cell) {
+			index++;
+		}
+		scanned += index < set->count;
+	}
+	uint64_t scans = tw_now() - start;
+	start = tw_now();
+	for (long i = 0; i < count; i++) {
+		fs_remove(set, fs_item(set, s_random(&random) % set->count));
+		short added = 0;
+		while (!added) {
+			added = fs_add(set, s_random(&random) % cells);
+		}
+	}
+	uint64_t replaces = tw_now() - start;
+	/* Every item has to be found through its slot and every slot has to point at its item */
+	uint32_t slots = 0;
+	for (uint32_t cell = 0; cell < cells; cell++) {
+		if (fs_has(set, cell)) {
+			slots++;
+			if (fs_item(set, set->slots[cell] - 1) != cell) {
+				fprintf(stderr, "ERROR: slot of cell %u points at another item\n", cell);
+				fs_free(&set);
+				return EXIT_FAILURE;
+			}
+		}
+	}
+	if (slots != set->count) {
+		fprintf(stderr, "ERROR: %u slots hold food for %u items\n", slots, set->count);
+		fs_free(&set);
+		return EXIT_FAILURE;
+	}
+	printf("board: %dx%d, %ld items, %.1f%% of lookups found food\n", side, side, items,
+	       100.0 * (double)(found + scanned) / (double)(2 * count));
+	printf("%-24s %10.1f ns\n", "fs_has", (double)lookups / (double)count);
+	printf("%-24s %10.1f ns\n", "item scan", (double)scans / (double)count);
+	printf("%-24s %10.1f ns\n", "fs_remove + fs_add", (double)replaces / (double)count);
+	fs_free(&set);
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Side of the board replays are recorded on, even so the snake can go around a cycle
+ */
+#define BENCH_REPLAY_SIDE 64
+
+/*
+ * RETURNS: move along a cycle through every cell inside the walls of a board of even side,
+ * rows are swept in turns and the first column leads back to the top
+ */
+static m_snake_move bench_replay_cycle(const s_coordinates head, const int side)
+{
+	if (head.x == 1) {
+		return head.y == 1 ? SNAKE_MOVE_RIGHT : SNAKE_MOVE_UP;
+	}
+	if ((head.y - 1) % 2 == 0) {
+		return head.x < side - 2 ? SNAKE_MOVE_RIGHT : SNAKE_MOVE_DOWN;
+	}
+	if (head.x > 2) {
+		return SNAKE_MOVE_LEFT;
+	}
+	return head.y == side - 2 ? SNAKE_MOVE_LEFT : SNAKE_MOVE_DOWN;
+}
+
+/*
+ * Records a game going around the cycle, or takes a replay file, and measures seeking with
+ * keyframes against playing from the start and verification on one thread against many
+ */
+static int bench_replay(int argc, char *argv[])
+{
+	long ticks = 200000;
+	int side = BENCH_REPLAY_SIDE;
+	long interval = REPLAY_INTERVAL;
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	long count = 100;
+	const char *input = NULL;
+	int option;
+	while ((option = getopt(argc, argv, "l:s:k:t:n:i:")) != -1) {
+		switch (option) {
+		case 'l':
+			ticks = atol(optarg);
+			break;
+		case 's':
+			side = atoi(optarg);
+			break;
+		case 'k':
+			interval = atol(optarg);
+			break;
+		case 't':
+			threads = atol(optarg);
+			break;
+		case 'n':
+			count = atol(optarg);
+			break;
+		case 'i':
+			input = optarg;
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+	if (ticks < 1 || side % 2 != 0 || !gs_size(side, side) || interval < 1
+	    || interval > UINT32_MAX || threads < 1 || count < 1) {
+		fprintf(stderr, "ERROR: invalid replay benchmark options\n");
+		return EXIT_FAILURE;
+	}
+
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/snake-bench-%ld.replay", (long)getpid());
+	if (!input) {
+		board *board = b_malloc(side, side);
+		snake *snake = s_malloc();
+		monitor *monitor = m_malloc();
+		short recorded = 0;
+		if (board && snake && monitor) {
+			m_initialize(monitor);
+			s_seed(snake, 1);
+			s_initialize(snake, board);
+			snake->recorder = rp_open(path, snake, (uint32_t)interval);
+		}
+		uint64_t start = tw_now();
+		while (snake && snake->recorder && monitor->snake_alive
+		       && snake->ticks < (unsigned long)ticks) {
+			monitor->move_next[0] = bench_replay_cycle(snake->head, side);
+			s_handle_move(snake, monitor);
+			s_advance(snake, monitor->snake_alive);
+		}
+		uint64_t elapsed = tw_now() - start;
+		if (snake && snake->recorder) {
+			printf("recorded %lu ticks, score %u, in %.1f ns per tick\n", snake->ticks,
+			       snake->score, (double)elapsed / (double)snake->ticks);
+			recorded = rp_close(&snake->recorder);
+		}
+		if (monitor) {
+			m_free(&monitor);
+		}
+		if (snake) {
+			s_clear_snake_body(snake);
+			s_free(&snake);
+		}
+		b_free(&board);
+		if (!recorded) {
+			unlink(path);
+			return EXIT_FAILURE;
+		}
+	}
+
+	int status = EXIT_FAILURE;
+	replay *replay = rp_load(input ? input : path);
+	game_state *state = replay ? gs_malloc(replay->width, replay->height) : NULL;
+	game_state *played = replay ? gs_malloc(replay->width, replay->height) : NULL;
+	size_t capacity = replay ? gs_packed_size(replay->width, replay->height) : 0;
+	void *sought = malloc(capacity);
+	void *expected = malloc(capacity);
+	if (!replay || !state || !played || !sought || !expected) {
+		goto bench_replay_free;
+	}
+	printf("replay: %dx%d, %llu ticks, %u keyframes every %u ticks, %zu bytes\n",
+	       replay->width, replay->height, (unsigned long long)replay->ticks,
+	       replay->keyframes, replay->interval, replay->size);
+
+	uint64_t random = s_seed_random(2);
+	uint64_t seek_time = 0;
+	uint64_t play_time = 0;
+	for (long i = 0; i < count; i++) {
+		uint64_t tick = ((uint64_t)s_random(&random) << 32 | s_random(&random))
+				% (replay->ticks + 1);
+		uint64_t start = tw_now();
+		rp_seek(replay, state, tick);
+		uint64_t middle = tw_now();
+		rp_seek(replay, played, 0);
+		for (uint64_t at = 1; at <= tick; at++) {
+			gs_step(played, rp_move(replay, at));
+		}
+		play_time += tw_now() - middle;
+		seek_time += middle - start;
+		size_t size = gs_pack(state, sought, capacity);
+		if (size != gs_pack(played, expected, capacity) || memcmp(sought, expected, size)) {
+			fprintf(stderr, "ERROR: seeking to tick %llu differs from playing to it\n",
+				(unsigned long long)tick);
+			goto bench_replay_free;
+		}
+	}
+	printf("%-24s %12.0f ns\n", "rp_seek", (double)seek_time / (double)count);
+	printf("%-24s %12.0f ns\n", "play from tick 0", (double)play_time / (double)count);
+
+	uint64_t start = tw_now();
+	uint32_t failed = rp_verify(replay, 1);
+	uint64_t single = tw_now() - start;
+	start = tw_now();
+	failed += rp_verify(replay, (size_t)threads);
+	uint64_t parallel = tw_now() - start;
+	char label[48];
+	snprintf(label, sizeof(label), "rp_verify, %ld threads", threads);
+	printf("%-24s %12.2f ms\n", "rp_verify, 1 thread", (double)single / 1e6);
+	printf("%-24s %12.2f ms, %.1fx\n", label, (double)parallel / 1e6,
+	       (double)single / (double)parallel);
+	if (failed) {
+		fprintf(stderr, "ERROR: %u segments of the replay differ\n", failed);
+		goto bench_replay_free;
+	}
+	a_report(stdout);
+	status = EXIT_SUCCESS;
+
+bench_replay_free:
+	free(expected);
+	free(sought);
+	gs_free(&played);
+	gs_free(&state);
+	rp_free(&replay);
+	if (!input) {
+		unlink(path);
+	}
+	return status;
+}
+
+/*
+ * Plays headless games with the tree search bot choosing every move
+ */
+static int bench_mcts(int argc, char *argv[])
+{
+	long games = 5;
+	long workers = 1;
+	long playouts = MCTS_PLAYOUTS;
+	long budget = (long)(SNAKE_MOVE_INTERVAL / MCTS_BUDGET_DIVISOR / 1e6);
+	long limit = 1000;
+	long table_bits = MCTS_TABLE_BITS;
+	int option;
+	while ((option = getopt(argc, argv, "g:t:p:b:l:z:")) != -1) {
+		switch (option) {
+		case 'g':
+			games = atol(optarg);
+			break;
+		case 't':
+			workers = atol(optarg);
+			break;
+		case 'p':
+			playouts = atol(optarg);
+			break;
+		case 'b':
+			budget = atol(optarg);
+			break;
+		case 'l':
+			limit = atol(optarg);
+			break;
+		case 'z':
+			table_bits = atol(optarg);
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+	if (games < 1 || workers < 1 || playouts < 1 || budget < 1 || limit < 1 || table_bits < 0) {
+		fprintf(stderr, "ERROR: invalid bot benchmark options\n");
+		return EXIT_FAILURE;
+	}
+
+	int status = EXIT_FAILURE;
+	board *board = b_malloc(BENCH_BOARD_WIDTH, BENCH_BOARD_HEIGHT);
+	snake *snake = s_malloc();
+	game_state *state = gs_malloc(BENCH_BOARD_WIDTH, BENCH_BOARD_HEIGHT);
+	mcts *mcts = mc_malloc(BENCH_BOARD_WIDTH, BENCH_BOARD_HEIGHT, (size_t)workers, playouts,
+			       (unsigned int)table_bits);
+	if (!board || !snake || !state || !mcts) {
+		goto bench_mcts_free;
+	}
+
+	unsigned long score = 0;
+	unsigned long ticks = 0;
+	long deaths = 0;
+	for (long game = 0; game < games; game++) {
+		s_seed(snake, (uint64_t)game);
+		s_initialize(snake, board);
+		gs_snapshot(state, snake, NULL);
+		s_clear_snake_body(snake);
+		while (state->alive && state->ticks < (uint64_t)limit) {
+			uint64_t deadline = tw_now() + (uint64_t)budget * 1000000;
+			gs_step(state, mc_search(mcts, state, deadline));
+		}
+		printf("game %ld: score %u in %llu ticks%s\n", game, state->score,
+		       (unsigned long long)state->ticks, state->alive ? "" : ", died");
+		score += state->score;
+		ticks += state->ticks;
+		deaths += !state->alive;
+	}
+	printf("bot: %.1f score and %.0f ticks per game, %ld of %ld games died\n",
+	       (double)score / (double)games, (double)ticks / (double)games, deaths, games);
+	mc_report(mcts, stdout);
+	status = EXIT_SUCCESS;
+
+bench_mcts_free:
+	mc_free(&mcts);
+	gs_free(&state);
+	if (snake) {
+		s_free(&snake);
+	}
+	b_free(&board);
+	return status;
+}
+
+static const bench benches[] = {
+	{ "sessions", "[-n sessions] [-d seconds] [-e loop|threads] [-L event log]", bench_sessions },
+	{ "clone", "[-n clones]", bench_clone },
+	{ "body", "[-l longest body]", bench_body },
+	{ "fill", "[-n fills]", bench_fill },
+	{ "observe", "[-n observations]", bench_observe },
+	{ "map", "[-s side] [-n queries] [-i text map -o map file]", bench_map },
+	{ "field", "[-g games] [-s side]", bench_field },
+	{ "food", "[-i items] [-n queries] [-s side]", bench_food },
+	{ "replay", "[-l ticks] [-s side] [-k interval] [-t threads] [-n seeks] [-i replay]",
+	  bench_replay },
+	{ "batch", "[-n environments] [-s steps] [-t threads]", bench_batch_run },
+	{ "env", "[-p shared region] [-n environments] [-s steps]", bench_env },
+	{ "mcts", "[-g games] [-t threads] [-p playouts] [-b budget ms] [-l ticks]"
+		  " [-z table bits]",
+	  bench_mcts },
+};
+
+int main(int argc, char *argv[])
+{
+	size_t count = sizeof(benches) / sizeof(benches[0]);
+	for (size_t i = 0; argc > 1 && i < count; i++) {
+		if (strcmp(argv[1], benches[i].name) == 0) {
+			srand((unsigned int)tw_now());
+			return benches[i].run(argc - 1, argv + 1);
+		}
+	}
+	fprintf(stderr, "Usage:\n");
+	for (size_t i = 0; i < count; i++) {
+		fprintf(stderr, "  %s %s %s\n", argv[0], benches[i].name, benches[i].usage);
+	}
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "bitboard.h"
+#include "allocator.h"
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__GNUC__)
+/*
+ * Four words handled at once, compiled to SIMD instructions where the target has them
+ */
+typedef uint64_t bb_vector __attribute__((vector_size(32)));
+#endif
+
+/*
+ * Spreads reach from the neighbouring row into row: row |= from & free,
+ * first and last are set to the range of words that changed
+ * \RETURNS: 1 if row changed, 0 otherwise
+ */
+static short bb_spread(uint64_t *const row, const uint64_t *const from, const uint64_t *const free,
+		       const size_t stride, size_t *const first, size_t *const last)
+{
+	*first = stride;
+	*last = 0;
+	size_t i = 0;
+#if defined(__GNUC__)
+	for (; i + 4 <= stride; i += 4) {
+		bb_vector current, neighbour, open;
+		memcpy(&current, row + i, sizeof(bb_vector));
+		memcpy(&neighbour, from + i, sizeof(bb_vector));
+		memcpy(&open, free + i, sizeof(bb_vector));
+		bb_vector next = current | (neighbour & open);
+		bb_vector difference = next ^ current;
+		if (difference[0] | difference[1] | difference[2] | difference[3]) {
+			*first = *first < i ? *first : i;
+			*last = i + 3;
+			memcpy(row + i, &next, sizeof(bb_vector));
+		}
+	}
+#endif
+	for (; i < stride; i++) {
+		uint64_t next = row[i] | (from[i] & free[i]);
+		if (next != row[i]) {
+			*first = *first < i ? *first : i;
+			*last = i;
+			row[i] = next;
+		}
+	}
+	return *first < stride;
+}
+
+/*
+ * RETURNS: reach extended through runs of free cells towards higher bits (Kogge-Stone fill)
+ */
+static uint64_t bb_fill_up(uint64_t reach, uint64_t free)
+{
+	reach |= free & (reach << 1);
+	free &= free << 1;
+	reach |= free & (reach << 2);
+	free &= free << 2;
+	reach |= free & (reach << 4);
+	free &= free << 4;
+	reach |= free & (reach << 8);
+	free &= free << 8;
+	reach |= free & (reach << 16);
+	free &= free << 16;
+	return reach | (free & (reach << 32));
+}
+
+/*
+ * RETURNS: reach extended through runs of free cells towards lower bits
+ */
+static uint64_t bb_fill_down(uint64_t reach, uint64_t free)
+{
+	reach |= free & (reach >> 1);
+	free &= free >> 1;
+	reach |= free & (reach >> 2);
+	free &= free >> 2;
+	reach |= free & (reach >> 4);
+	free &= free >> 4;
+	reach |= free & (reach >> 8);
+	free &= free >> 8;
+	reach |= free & (reach >> 16);
+	free &= free >> 16;
+	return reach | (free & (reach >> 32));
+}
+
+/*
+ * Fills row along its free runs starting from words first to last, the other words are already
+ * filled and only change when a run carries across a word boundary into them
+ */
+static void bb_fill_row(uint64_t *const row, const uint64_t *const free, const size_t stride,
+			size_t first, size_t last)
+{
+	short changed = 1;
+	while (changed) {
+		changed = 0;
+		for (size_t i = first; i <= last; i++) {
+			row[i] = bb_fill_up(row[i], free[i]) | bb_fill_down(row[i], free[i]);
+			if (i + 1 < stride && row[i] >> 63 && free[i + 1] & 1 && !(row[i + 1] & 1)) {
+				row[i + 1] |= 1;
+				last = i + 1 > last ? i + 1 : last;
+			}
+		}
+		for (size_t i = last + 1; i-- > first;) {
+			row[i] = bb_fill_up(row[i], free[i]) | bb_fill_down(row[i], free[i]);
+			if (i && row[i] & 1 && free[i - 1] >> 63 && !(row[i - 1] >> 63)) {
+				row[i - 1] |= 1ULL << 63;
+				first = i - 1 < first ? i - 1 : first;
+				changed = 1;
+			}
+		}
+	}
+}
+
+bitboard *bb_malloc(const int width, const int height)
+{
+	if (width < 1 || height < 1) {
+		return NULL;
+	}
+	bitboard *bitboard = a_malloc(ALLOCATOR_TAG_STATE, sizeof(struct bitboard));
+	if (!bitboard) {
+		perror("ERROR: bitboard malloc failed\n");
+		return NULL;
+	}
+	bitboard->width = width;
+	bitboard->height = height;
+	bitboard->stride = ((size_t)width + 63) / 64;
+	bitboard->words = a_aligned(ALLOCATOR_TAG_STATE, 32,
+				    bitboard->stride * (size_t)height * sizeof(uint64_t));
+	if (!bitboard->words) {
+		perror("ERROR: bitboard malloc failed\n");
+		a_free(ALLOCATOR_TAG_STATE, bitboard, sizeof(struct bitboard));
+		return NULL;
+	}
+	bb_clear(bitboard);
+	return bitboard;
+}
+
+void bb_free(bitboard **bitboard)
+{
+	if (!bitboard || !*bitboard) {
+		return;
+	}
+	a_free(ALLOCATOR_TAG_STATE, (*bitboard)->words,
+	       (*bitboard)->stride * (size_t)(*bitboard)->height * sizeof(uint64_t));
+	a_free(ALLOCATOR_TAG_STATE, *bitboard, sizeof(struct bitboard));
+	*bitboard = NULL;
+}
+
+void bb_clear(bitboard *const bitboard)
+{
+	memset(bitboard->words, 0, bitboard->stride * (size_t)bitboard->height * sizeof(uint64_t));
+}
+
+void bb_set(bitboard *const bitboard, const int x, const int y)
+{
+	if (x < 0 || y < 0 || x >= bitboard->width || y >= bitboard->height) {
+		return;
+	}
+	bitboard->words[(size_t)y * bitboard->stride + (size_t)x / 64] |= 1ULL << (x % 64);
+}
+
+short bb_get(const bitboard *const bitboard, const int x, const int y)
+{
+	if (x < 0 || y < 0 || x >= bitboard->width || y >= bitboard->height) {
+		return 0;
+	}
+	return (bitboard->words[(size_t)y * bitboard->stride + (size_t)x / 64] >> (x % 64)) & 1;
+}
+
+/*
+ * RETURNS: 64 bits of the game state bitmap starting at cell
+ */
+static uint64_t bb_state_bits(const game_state *const state, const uint32_t cell)
+{
+	uint32_t word = cell >> 6;
+	uint32_t shift = cell & 63;
+	uint64_t bits = state->data[word] >> shift;
+	if (shift && word + 1 < state->bitmap_words) {
+		bits |= state->data[word + 1] << (64 - shift);
+	}
+	return bits;
+}
+
+void bb_from_state(bitboard *const free, const game_state *const state)
+{
+	bb_clear(free);
+	for (int y = 1; y < state->height - 1; y++) {
+		uint64_t *row = free->words + (size_t)y * free->stride;
+		for (size_t i = 0; i < free->stride; i++) {
+			int first = (int)i * 64;
+			if (first > state->width - 2) {
+				break;
+			}
+			/* Walls are the first and the last column */
+			uint64_t inside = ~0ULL;
+			if (first == 0) {
+				inside &= ~1ULL;
+			}
+			if (state->width - 1 - first < 64) {
+				inside &= (1ULL << (state->width - 1 - first)) - 1;
+			}
+			row[i] = ~bb_state_bits(state, (uint32_t)(y * state->width + first)) & inside;
+		}
+	}
+	if (state->length) {
+		uint16_t tail = gs_tail(state);
+		bb_set(free, tail % state->width, tail / state->width);
+	}
+}
+
+size_t bb_fill(const bitboard *const free, bitboard *const reach, const int x, const int y)
+{
+	bb_clear(reach);
+	if (!bb_get(free, x, y)) {
+		return 0;
+	}
+	size_t stride = free->stride;
+	bb_set(reach, x, y);
+	bb_fill_row(reach->words + (size_t)y * stride, free->words + (size_t)y * stride, stride,
+		    (size_t)x / 64, (size_t)x / 64);
+
+	/* Only rows next to the band of reached rows can change, sweeps stay inside it */
+	int top = y;
+	int bottom = y;
+	size_t first = 0;
+	size_t last = 0;
+	short changed = 1;
+	while (changed) {
+		changed = 0;
+		for (int row = top + 1; row <= bottom + 1 && row < free->height; row++) {
+			uint64_t *current = reach->words + (size_t)row * stride;
+			const uint64_t *open = free->words + (size_t)row * stride;
+			if (bb_spread(current, current - stride, open, stride, &first, &last)) {
+				bb_fill_row(current, open, stride, first, last);
+				bottom = row > bottom ? row : bottom;
+				changed = 1;
+			}
+		}
+		for (int row = bottom - 1; row >= top - 1 && row >= 0; row--) {
+			uint64_t *current = reach->words + (size_t)row * stride;
+			const uint64_t *open = free->words + (size_t)row * stride;
+			if (bb_spread(current, current + stride, open, stride, &first, &last)) {
+				bb_fill_row(current, open, stride, first, last);
+				top = row < top ? row : top;
+				changed = 1;
+			}
+		}
+	}
+	size_t count = 0;
+	for (size_t i = (size_t)top * stride; i < (size_t)(bottom + 1) * stride; i++) {
+		count += (size_t)__builtin_popcountll(reach->words[i]);
+	}
+	return count;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __BITBOARD_H__
+#define __BITBOARD_H__
+
+#include "game_state.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * One bit per board cell, bit x % 64 of word x / 64 of a row is cell x.
+ * Every row starts at a new word, stride is the number of words in a row
+ */
+typedef struct bitboard {
+	int width;
+	int height;
+	size_t stride;
+	uint64_t *words;
+} bitboard;
+
+/*
+ * Creates an empty bitboard of given size
+ * \RETURNS: pointer to the bitboard, NULL on failure
+ */
+bitboard *bb_malloc(const int width, const int height);
+
+/*
+ * Frees given bitboard
+ */
+void bb_free(bitboard **bitboard);
+
+/*
+ * Clears every cell
+ */
+void bb_clear(bitboard *const bitboard);
+
+/*
+ * Sets cell at x, y, cells outside the board are ignored
+ */
+void bb_set(bitboard *const bitboard, const int x, const int y);
+
+/*
+ * RETURNS: 1 if cell at x, y is set, 0 otherwise or if it is outside the board
+ */
+short bb_get(const bitboard *const bitboard, const int x, const int y);
+
+/*
+ * Sets the cells a snake of state can move through: every cell inside the walls
+ * that is not taken by the body, the tail counts as free as it moves away with the next tick
+ */
+void bb_from_state(bitboard *const free, const game_state *const state);
+
+/*
+ * Fills reach with the cells of free connected to x, y.
+ * Rows are filled with shifts and masks a word at a time, and spread up and down the board
+ * in sweeps until nothing changes
+ * \RETURNS: number of reachable cells, 0 if x, y is not free
+ */
+size_t bb_fill(const bitboard *const free, bitboard *const reach, const int x, const int y);
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "board.h"
+#include "allocator.h"
+#include "map.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+board *b_malloc(const int width, const int height)
+{
+	if (width < 1 || height < 1) {
+		return NULL;
+	}
+	struct board *board = a_malloc(ALLOCATOR_TAG_BOARD, sizeof(struct board));
+	if (!board) {
+		perror("ERROR: board malloc failed\n");
+		return NULL;
+	}
+	board->width = width;
+	board->height = height;
+	board->tiles_x = ((size_t)width + BOARD_TILE_MASK) >> BOARD_TILE_SHIFT;
+	board->tiles_y = ((size_t)height + BOARD_TILE_MASK) >> BOARD_TILE_SHIFT;
+	board->tiles_used = 0;
+	board->tiles_pooled = 0;
+	board->pool = NULL;
+	board->map = NULL;
+	/* Large directories come from zeroed pages, only touched rows become resident */
+	board->directory = a_calloc(ALLOCATOR_TAG_BOARD, board->tiles_x * board->tiles_y,
+				    sizeof(struct b_tile *));
+	if (!board->directory) {
+		perror("ERROR: board directory calloc failed\n");
+		a_free(ALLOCATOR_TAG_BOARD, board, sizeof(struct board));
+		return NULL;
+	}
+	return board;
+}
+
+void b_free(board **board)
+{
+	if (!board || !*board) {
+		return;
+	}
+	size_t count = (*board)->tiles_x * (*board)->tiles_y;
+	for (size_t i = 0; i < count; i++) {
+		a_free(ALLOCATOR_TAG_BOARD, (*board)->directory[i], sizeof(struct b_tile));
+	}
+	b_tile *tile = (*board)->pool;
+	while (tile) {
+		b_tile *next = tile->next;
+		a_free(ALLOCATOR_TAG_BOARD, tile, sizeof(struct b_tile));
+		tile = next;
+	}
+	a_free(ALLOCATOR_TAG_BOARD, (*board)->directory, count * sizeof(struct b_tile *));
+	a_free(ALLOCATOR_TAG_BOARD, *board, sizeof(struct board));
+	*board = NULL;
+}
+
+/*
+ * RETURNS: 1 if coordinates are inside the playable area, 0 if not
+ */
+static short b_is_inside(const board *const board, const int x, const int y)
+{
+	return x >= 1 && y >= 1 && x <= board->width - 2 && y <= board->height - 2;
+}
+
+/*
+ * RETURNS: pointer to the directory slot of the tile holding given cell
+ */
+static b_tile **b_tile_slot(const board *const board, const int x, const int y)
+{
+	size_t tile_x = (size_t)x >> BOARD_TILE_SHIFT;
+	size_t tile_y = (size_t)y >> BOARD_TILE_SHIFT;
+	return &board->directory[tile_y * board->tiles_x + tile_x];
+}
+
+/*
+ * RETURNS: index of the cell inside of its tile
+ */
+static size_t b_cell_index(const int x, const int y)
+{
+	return ((size_t)(y & BOARD_TILE_MASK) << BOARD_TILE_SHIFT) | (size_t)(x & BOARD_TILE_MASK);
+}
+
+short b_use_map(board *const board, const struct map *const map)
+{
+	if (!board || !map || map->width != board->width || map->height != board->height) {
+		return 0;
+	}
+	board->map = map;
+	return 1;
+}
+
+unsigned char b_cell_get(const board *const board, const int x, const int y)
+{
+	if (!board || !b_is_inside(board, x, y)) {
+		return BOARD_CELL_WALL;
+	}
+	if (board->map && mp_is_wall(board->map, x, y)) {
+		return BOARD_CELL_WALL;
+	}
+	const b_tile *tile = *b_tile_slot(board, x, y);
+	if (!tile) {
+		return BOARD_CELL_EMPTY;
+	}
+	return tile->cells[b_cell_index(x, y)];
+}
+
+void b_cell_set(board *const board, const int x, const int y, const unsigned char flags)
+{
+	if (!board || !b_is_inside(board, x, y) || flags == BOARD_CELL_EMPTY) {
+		return;
+	}
+	b_tile **slot = b_tile_slot(board, x, y);
+	if (!*slot) {
+		if (board->pool) {
+			*slot = board->pool;
+			board->pool = board->pool->next;
+			board->tiles_pooled--;
+		} else {
+			*slot = a_calloc(ALLOCATOR_TAG_BOARD, 1, sizeof(struct b_tile));
+			if (!*slot) {
+				perror("ERROR: board tile calloc failed\n");
+				return;
+			}
+		}
+		(*slot)->next = NULL;
+		board->tiles_used++;
+	}
+	unsigned char *cell = &(*slot)->cells[b_cell_index(x, y)];
+	if (*cell == BOARD_CELL_EMPTY) {
+		(*slot)->used++;
+	}
+	*cell |= flags;
+}
+
+void b_cell_clear(board *const board, const int x, const int y, const unsigned char flags)
+{
+	if (!board || !b_is_inside(board, x, y)) {
+		return;
+	}
+	b_tile **slot = b_tile_slot(board, x, y);
+	if (!*slot) {
+		return;
+	}
+	unsigned char *cell = &(*slot)->cells[b_cell_index(x, y)];
+	if (*cell == BOARD_CELL_EMPTY) {
+		return;
+	}
+	*cell &= (unsigned char)~flags;
+	if (*cell != BOARD_CELL_EMPTY || --(*slot)->used > 0) {
+		return;
+	}
+
+	/* Every cell of the tile is zero again, so it can be reused as is */
+	b_tile *tile = *slot;
+	*slot = NULL;
+	board->tiles_used--;
+	if (board->tiles_pooled < BOARD_POOL_MAX) {
+		tile->next = board->pool;
+		board->pool = tile;
+		board->tiles_pooled++;
+	} else {
+		a_free(ALLOCATOR_TAG_BOARD, tile, sizeof(struct b_tile));
+	}
+}
+
+short b_is_blocked(const board *const board, const int x, const int y)
+{
+	return (b_cell_get(board, x, y) & (BOARD_CELL_WALL | BOARD_CELL_SNAKE)) != 0;
+}
+
+size_t b_memory_usage(const board *const board)
+{
+	if (!board) {
+		return 0;
+	}
+	return sizeof(struct board) + board->tiles_x * board->tiles_y * sizeof(struct b_tile *)
+	       + (board->tiles_used + board->tiles_pooled) * sizeof(struct b_tile);
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __BOARD_H__
+#define __BOARD_H__
+
+#include <stddef.h>
+
+/*
+ * Tile side length is 1 << BOARD_TILE_SHIFT cells
+ */
+#define BOARD_TILE_SHIFT 6
+#define BOARD_TILE_SIZE (1 << BOARD_TILE_SHIFT)
+#define BOARD_TILE_MASK (BOARD_TILE_SIZE - 1)
+
+/*
+ * Maximum number of emptied tiles kept for reuse
+ */
+#define BOARD_POOL_MAX 64
+
+/*
+ * Cell flags stored in the board
+ */
+typedef enum b_cell {
+	BOARD_CELL_EMPTY = 0,
+	BOARD_CELL_SNAKE = 1 << 0,
+	BOARD_CELL_FOOD = 1 << 1,
+	BOARD_CELL_WALL = 1 << 2
+} b_cell;
+
+/*
+ * Fixed size square block of cells.
+ * Used is the count of non empty cells, next links tiles in the pool.
+ */
+typedef struct b_tile {
+	unsigned int used;
+	struct b_tile *next;
+	unsigned char cells[BOARD_TILE_SIZE * BOARD_TILE_SIZE];
+} b_tile;
+
+struct map;
+
+/*
+ * Sparse board storage.
+ * Tiles are allocated when a cell inside them is first set and returned
+ * to the pool when their last cell is cleared.
+ * Cells on the border and outside of the board are reported as walls,
+ * so are the walls of map if the board uses one.
+ */
+typedef struct board {
+	int width;
+	int height;
+	size_t tiles_x;
+	size_t tiles_y;
+	size_t tiles_used;
+	size_t tiles_pooled;
+	struct b_tile **directory;
+	struct b_tile *pool;
+	const struct map *map;
+} board;
+
+/*
+ * Allocates and initializes new empty board of given size
+ * \RETURNS: pointer to the newly created board
+ */
+board *b_malloc(const int width, const int height);
+
+/*
+ * Frees the given board with all of its tiles
+ */
+void b_free(board **board);
+
+/*
+ * Adds the walls of map to the board, map has to outlive the board
+ * \RETURNS: 1 on success, 0 if the map is of a different size
+ */
+short b_use_map(board *const board, const struct map *const map);
+
+/*
+ * RETURNS: flags of the cell at given coordinates
+ */
+unsigned char b_cell_get(const board *const board, const int x, const int y);
+
+/*
+ * Sets given flags on the cell, allocating its tile if needed
+ */
+void b_cell_set(board *const board, const int x, const int y, const unsigned char flags);
+
+/*
+ * Clears given flags from the cell, recycling its tile if it becomes empty
+ */
+void b_cell_clear(board *const board, const int x, const int y, const unsigned char flags);
+
+/*
+ * Checks whether snake can not enter the cell
+ * \RETURNS: 1 if cell is a wall or snake body, 0 if not
+ */
+short b_is_blocked(const board *const board, const int x, const int y);
+
+/*
+ * RETURNS: number of bytes currently allocated for the board
+ */
+size_t b_memory_usage(const board *const board);
+
+#endif
@@ -21,6 +21,8 @@
  */
 
 #include "circular_dynamic_queue.h"
+#include "allocator.h"
+#include "trace.h"
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,15 +33,16 @@ struct circular_dynamic_queue *cdq_malloc(const size_t offset)
 	if (offset < 1) {
 		return NULL;
 	}
-	struct circular_dynamic_queue *queue = malloc(sizeof(struct circular_dynamic_queue));
+	struct circular_dynamic_queue *queue
+		= a_malloc(ALLOCATOR_TAG_QUEUE, sizeof(struct circular_dynamic_queue));
 	if (!queue) {
 		perror("Circular dynamic queue memory allocation failed:\n");
 		return NULL;
 	}
-	void *data = malloc(CDQ_INITIAL_SIZE * offset);
+	void *data = a_malloc(ALLOCATOR_TAG_QUEUE, CDQ_INITIAL_SIZE * offset);
 	if (!data) {
 		perror("Circular dynamic queue data memory allocation failed:\n");
-		free(queue);
+		a_free(ALLOCATOR_TAG_QUEUE, queue, sizeof(struct circular_dynamic_queue));
 		return NULL;
 	}
 	queue->data = data;
@@ -57,24 +60,21 @@ struct circular_dynamic_queue *cdq_realloc(circular_dynamic_queue *const queue)
 	if (!queue || !queue->data) {
 		return queue;
 	}
-	size_t new_size = queue->size_max * queue->offset * 2;
-	void *new_data = malloc(new_size);
+	TRACE_SCOPE("cdq_realloc");
+	size_t old_size = queue->size_max * queue->offset;
+	void *new_data = a_realloc(ALLOCATOR_TAG_QUEUE, queue->data, old_size, old_size * 2);
 	if (!new_data) {
 		perror("Circular dynamic queue data memory reallocation failed:\n");
 		return queue;
 	}
 
-	for (unsigned long i = 0; i < queue->size_current; i++) {
-		unsigned long index = (i + queue->head) % queue->size_max;
-		memcpy((char *)new_data + (i * queue->offset),
-		       (char *)queue->data + (index * queue->offset), queue->offset);
+	/* Elements wrapped around the end are moved behind the old end to stay in order */
+	if (queue->size_current > 0 && queue->tail < queue->head) {
+		memcpy((char *)new_data + old_size, new_data, (queue->tail + 1) * queue->offset);
+		queue->tail += queue->size_max;
 	}
-
-	free(queue->data);
 	queue->data = new_data;
 	queue->size_max *= 2;
-	queue->head = 0;
-	queue->tail = queue->size_current - 1;
 	return queue;
 }
 
@@ -83,9 +83,9 @@ void cdq_free(struct circular_dynamic_queue **queue)
 	if (!queue || !*queue) {
 		return;
 	}
-	free((*queue)->data);
+	a_free(ALLOCATOR_TAG_QUEUE, (*queue)->data, (*queue)->size_max * (*queue)->offset);
 	(*queue)->data = NULL;
-	free(*queue);
+	a_free(ALLOCATOR_TAG_QUEUE, *queue, sizeof(struct circular_dynamic_queue));
 	*queue = NULL;
 }
 
@@ -102,7 +102,11 @@ void cdq_push(struct circular_dynamic_queue *queue, const void *const new_data)
 	}
 
 	unsigned long index = queue->tail + 1;
-	if (queue->size_current == 0 || index == queue->size_max) {
+	if (queue->size_current == 0) {
+		/* Emptied queue starts over at the front, head has to point at the new element */
+		queue->head = 0;
+		index = 0;
+	} else if (index == queue->size_max) {
 		index = 0;
 	}
 	memcpy((char *)queue->data + index * queue->offset, new_data, queue->offset);
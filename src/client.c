@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "client.h"
+#include "input.h"
+#include "protocol.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+int c_connect(const char *const path)
+{
+	if (!path) {
+		return -1;
+	}
+	struct sockaddr_un address = { .sun_family = AF_UNIX };
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		fprintf(stderr, "ERROR: socket path is too long\n");
+		return -1;
+	}
+	strcpy(address.sun_path, path);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		perror("ERROR: socket failed\n");
+		return -1;
+	}
+	if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+		perror("ERROR: connect failed\n");
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+void c_run(windows *const windows, const int fd)
+{
+	if (!windows || fd < 0) {
+		return;
+	}
+	/* Embedded monitor is cache line aligned */
+	client *client = NULL;
+	if (posix_memalign((void **)&client, MONITOR_CACHE_LINE, sizeof(struct client)) != 0) {
+		perror("ERROR: client calloc failed\n");
+		close(fd);
+		return;
+	}
+	memset(client, 0, sizeof(struct client));
+	client->fd = fd;
+	nodelay(stdscr, 1);
+
+	struct pollfd fds[] = { { .fd = fd, .events = POLLIN }, { .fd = 0, .events = POLLIN } };
+	short running = 1;
+	while (running) {
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		if (fds[0].revents && !c_handle_server(client, windows)) {
+			running = 0;
+		}
+		if (!fds[1].revents) {
+			continue;
+		}
+		int value;
+		while (running && (value = getch()) != ERR) {
+			if (value == 'q' || value == 'Q') {
+				running = 0;
+				break;
+			}
+			unsigned char move = (unsigned char)i_key_to_move(value);
+			if (move != SNAKE_MOVE_EMPTY) {
+				send(fd, &move, sizeof(move), MSG_NOSIGNAL);
+			}
+		}
+	}
+
+	close(fd);
+	free(client);
+}
+
+short c_handle_server(client *const client, windows *const windows)
+{
+	if (!client || !windows) {
+		return 0;
+	}
+	ssize_t length = recv(client->fd, client->input + client->input_length,
+			      sizeof(client->input) - client->input_length, 0);
+	if (length <= 0) {
+		return length < 0 && errno == EINTR;
+	}
+	client->input_length += (size_t)length;
+
+	size_t offset = 0;
+	size_t size;
+	while ((size = p_record_size(client->input + offset, client->input_length - offset))) {
+		c_handle_record(client, windows, client->input + offset);
+		offset += size;
+	}
+	if (offset == 0 && client->input_length == sizeof(client->input)) {
+		fprintf(stderr, "ERROR: record does not fit into the client buffer\n");
+		return 0;
+	}
+	client->input_length -= offset;
+	memmove(client->input, client->input + offset, client->input_length);
+	wrefresh(windows->game);
+	return 1;
+}
+
+void c_handle_record(client *const client, windows *const windows, const void *const record)
+{
+	if (!client || !windows || !record) {
+		return;
+	}
+	p_header header;
+	memcpy(&header, record, sizeof(header));
+	const char *payload = (const char *)record + sizeof(header);
+	if (!p_record_valid(&header)) {
+		return;
+	}
+
+	if (header.type == RECORD_WELCOME) {
+		p_welcome welcome;
+		memcpy(&welcome, payload, sizeof(welcome));
+		client->player = header.player;
+		werase(windows->game);
+		wresize(windows->game, welcome.height, welcome.width);
+		box(windows->game, 0, 0);
+		return;
+	}
+
+	p_delta delta;
+	memcpy(&delta, payload, sizeof(delta));
+	snake *view = &client->view;
+	view->score = delta.score;
+	view->head = (s_coordinates){ delta.head.x, delta.head.y };
+	view->tail = (s_coordinates){ delta.tail.x, delta.tail.y };
+	view->food = (s_coordinates){ delta.food.x, delta.food.y };
+
+	if (header.type == RECORD_DELTA) {
+		enum m_signal_windows signal = (enum m_signal_windows)header.signal;
+		if (header.player == client->player) {
+			client->monitor.signal_windows = signal;
+			w_handle_signal(windows, &client->monitor, view);
+		} else {
+			c_display_delta(windows, view, signal);
+		}
+		return;
+	}
+
+	size_t count = (header.length - sizeof(delta)) / sizeof(struct p_point);
+	const char *points = payload + sizeof(delta);
+	for (size_t i = 0; i < count; i++) {
+		p_point point;
+		memcpy(&point, points + i * sizeof(point), sizeof(point));
+		view->tail = (s_coordinates){ point.x, point.y };
+		if (header.type == RECORD_LEAVE) {
+			w_snake_clear_tail(windows, view);
+		} else {
+			view->head = view->tail;
+			w_snake_display_head(windows, view, COLOR_PAIR_GREEN);
+		}
+	}
+	if (header.type == RECORD_LEAVE) {
+		view->tail = view->food;
+		w_snake_clear_tail(windows, view);
+	} else {
+		w_snake_display_food(windows, view);
+	}
+}
+
+void c_display_delta(windows *const windows, snake *const view,
+		     const enum m_signal_windows signal)
+{
+	if (!windows || !view) {
+		return;
+	}
+	switch (signal) {
+	case SIGNAL_WINDOWS_SNAKE_AND_FOOD_REFRESH:
+		w_snake_display_food(windows, view);
+		__attribute__((fallthrough));
+	case SIGNAL_WINDOWS_SNAKE_REFRESH:
+		w_snake_display_head(windows, view, COLOR_PAIR_GREEN);
+		w_snake_clear_tail(windows, view);
+		break;
+	case SIGNAL_WINDOWS_SNAKE_DIED:
+		w_snake_clear_tail(windows, view);
+		w_snake_display_head(windows, view, COLOR_PAIR_RED);
+		break;
+	default:
+		break;
+	}
+}
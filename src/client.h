@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __CLIENT_H__
+#define __CLIENT_H__
+
+#include "monitor.h"
+#include "snake.h"
+#include "windows.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Size of the buffer for records received from the server
+ */
+#define CLIENT_BUFFER_SIZE 131072
+
+/*
+ * State of the game rendered from server records.
+ * View holds head, tail, food and score of the snake a record is about
+ */
+typedef struct client {
+	int fd;
+	uint16_t player;
+	monitor monitor;
+	snake view;
+	size_t input_length;
+	char input[CLIENT_BUFFER_SIZE];
+} client;
+
+/*
+ * Connects to the server listening on given Unix domain socket
+ * \RETURNS: connected socket, -1 on failure
+ */
+int c_connect(const char *const path);
+
+/*
+ * Renders the game received over the connected socket and sends user moves
+ * until the user exits or the server closes the connection.
+ * Closes the socket before returning
+ */
+void c_run(windows *const windows, const int fd);
+
+/*
+ * Reads available records from the server and renders them
+ * \RETURNS: 1 if connection is still open, 0 if not
+ */
+short c_handle_server(client *const client, windows *const windows);
+
+/*
+ * Renders single complete record, records whose length does not fit their type are ignored
+ */
+void c_handle_record(client *const client, windows *const windows, const void *const record);
+
+/*
+ * Displays change of a snake that belongs to another player
+ */
+void c_display_delta(windows *const windows, snake *const view,
+		     const enum m_signal_windows signal);
+
+#endif
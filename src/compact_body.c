@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "compact_body.h"
+#include "allocator.h"
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Offsets of the steps, in the order of the moves starting from SNAKE_MOVE_UP
+ */
+static const s_coordinates cb_offsets[4] = { { 0, -1 }, { 0, 1 }, { 1, 0 }, { -1, 0 } };
+
+/*
+ * RETURNS: step stored at ring index
+ */
+static unsigned int cb_step(const compact_body *const body, const size_t index)
+{
+	return (unsigned int)(body->words[index / 32] >> (index % 32 * 2)) & 3;
+}
+
+/*
+ * Doubles the ring, steps wrapped around its end are moved behind the old end to stay in order
+ * \RETURNS: 1 on success, 0 on failure
+ */
+static short cb_grow(compact_body *const body)
+{
+	size_t old_size = body->capacity / 4;
+	uint64_t *words = a_realloc(ALLOCATOR_TAG_QUEUE, body->words, old_size, old_size * 2);
+	if (!words) {
+		perror("ERROR: compact body reallocation failed\n");
+		return 0;
+	}
+	memset((char *)words + old_size, 0, old_size);
+	size_t steps = body->length - 1;
+	if (body->start + steps > body->capacity) {
+		/* Capacity is a whole number of words, the wrapped steps start at word 0 */
+		size_t wrapped = body->start + steps - body->capacity;
+		memcpy((char *)words + old_size, words, (wrapped + 31) / 32 * sizeof(uint64_t));
+	}
+	body->words = words;
+	body->capacity *= 2;
+	return 1;
+}
+
+compact_body *cb_malloc(void)
+{
+	compact_body *body = a_malloc(ALLOCATOR_TAG_QUEUE, sizeof(struct compact_body));
+	if (!body) {
+		perror("ERROR: compact body malloc failed\n");
+		return NULL;
+	}
+	body->capacity = COMPACT_BODY_INITIAL_SIZE;
+	body->words = a_calloc(ALLOCATOR_TAG_QUEUE, 1, COMPACT_BODY_INITIAL_SIZE / 4);
+	if (!body->words) {
+		perror("ERROR: compact body malloc failed\n");
+		a_free(ALLOCATOR_TAG_QUEUE, body, sizeof(struct compact_body));
+		return NULL;
+	}
+	cb_clear(body);
+	return body;
+}
+
+void cb_free(compact_body **body)
+{
+	if (!body || !*body) {
+		return;
+	}
+	a_free(ALLOCATOR_TAG_QUEUE, (*body)->words, (*body)->capacity / 4);
+	a_free(ALLOCATOR_TAG_QUEUE, *body, sizeof(struct compact_body));
+	*body = NULL;
+}
+
+void cb_clear(compact_body *const body)
+{
+	body->length = 0;
+	body->start = 0;
+	body->head = (s_coordinates){ -1, -1 };
+	body->tail = body->head;
+}
+
+short cb_push(compact_body *const body, const s_coordinates at)
+{
+	if (!body->length) {
+		body->head = at;
+		body->tail = at;
+		body->start = 0;
+		body->length = 1;
+		return 1;
+	}
+	unsigned int step = 0;
+	while (step < 4
+	       && (body->head.x + cb_offsets[step].x != at.x
+		   || body->head.y + cb_offsets[step].y != at.y)) {
+		step++;
+	}
+	if (step == 4) {
+		return 0;
+	}
+	if (body->length - 1 == body->capacity && !cb_grow(body)) {
+		return 0;
+	}
+	size_t index = (body->start + body->length - 1) & (body->capacity - 1);
+	uint64_t *word = &body->words[index / 32];
+	*word = (*word & ~(3ULL << (index % 32 * 2))) | (uint64_t)step << (index % 32 * 2);
+	body->head = at;
+	body->length++;
+	return 1;
+}
+
+void cb_pop(compact_body *const body)
+{
+	if (!body->length) {
+		return;
+	}
+	if (body->length == 1) {
+		cb_clear(body);
+		return;
+	}
+	s_coordinates offset = cb_offsets[cb_step(body, body->start)];
+	body->tail.x += offset.x;
+	body->tail.y += offset.y;
+	body->start = (body->start + 1) & (body->capacity - 1);
+	body->length--;
+}
+
+size_t cb_memory_usage(const compact_body *const body)
+{
+	return sizeof(struct compact_body) + body->capacity / 4;
+}
+
+short cb_next(const compact_body *const body, const size_t index, s_coordinates *const at)
+{
+	if (index + 1 >= body->length) {
+		return 0;
+	}
+	s_coordinates offset = cb_offsets[cb_step(body, (body->start + index) & (body->capacity - 1))];
+	at->x += offset.x;
+	at->y += offset.y;
+	return 1;
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __COMPACT_BODY_H__
+#define __COMPACT_BODY_H__
+
+#include "snake.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Directions held by a new compact body, always a power of two of at least 32
+ */
+#define COMPACT_BODY_INITIAL_SIZE 64
+
+/*
+ * Snake body stored as its head and tail coordinates and 2 bits per step between neighbouring
+ * segments, 32 steps to a 64-bit word. Steps are kept in a ring going from the tail to the head,
+ * start is the ring index of the step leaving the tail and capacity the steps the ring holds
+ */
+typedef struct compact_body {
+	s_coordinates head;
+	s_coordinates tail;
+	size_t length;
+	size_t start;
+	size_t capacity;
+	uint64_t *words;
+} compact_body;
+
+/*
+ * Allocates an empty compact body
+ * \RETURNS: pointer to the body, NULL on failure
+ */
+compact_body *cb_malloc(void);
+
+/*
+ * Frees the given compact body
+ */
+void cb_free(compact_body **body);
+
+/*
+ * Removes every segment
+ */
+void cb_clear(compact_body *const body);
+
+/*
+ * Pushes at as the new head, it has to be next to the old head unless the body is empty
+ * \RETURNS: 1 on success, 0 if at is not next to the head or the ring could not grow
+ */
+short cb_push(compact_body *const body, const s_coordinates at);
+
+/*
+ * Removes the tail segment
+ */
+void cb_pop(compact_body *const body);
+
+/*
+ * RETURNS: bytes used by the body and its ring
+ */
+size_t cb_memory_usage(const compact_body *const body);
+
+/*
+ * Moves at from segment index, counted from the tail, to the next segment towards the head
+ * \RETURNS: 1 if it moved, 0 if index is the head
+ */
+short cb_next(const compact_body *const body, const size_t index, s_coordinates *const at);
+
+#endif
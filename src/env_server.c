@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "env_server.h"
+#include "allocator.h"
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Header of the region es_serve runs on, the signal handler wakes it through the request event
+ */
+static es_header *volatile es_serving = NULL;
+
+static volatile sig_atomic_t es_interrupted = 0;
+
+static void es_handle_signal(int signal)
+{
+	(void)signal;
+	es_interrupted = 1;
+	if (es_serving) {
+		m_event_notify_shared(&es_serving->request);
+	}
+}
+
+/*
+ * RETURNS: offset rounded up to a whole cache line
+ */
+static size_t es_align(const size_t offset)
+{
+	return (offset + MONITOR_CACHE_LINE - 1) / MONITOR_CACHE_LINE * MONITOR_CACHE_LINE;
+}
+
+/*
+ * RETURNS: polls before sleeping, none when the other side cannot run while this one polls
+ */
+static unsigned int es_spins(void)
+{
+	return sysconf(_SC_NPROCESSORS_ONLN) > 1 ? ENV_SERVER_SPINS : 0;
+}
+
+/*
+ * Maps size bytes of the open region file fd into a new region
+ * \RETURNS: pointer to the region, NULL on failure
+ */
+static es_region *es_map(const int fd, const size_t size, const char *const path)
+{
+	es_region *region = a_calloc(ALLOCATOR_TAG_BATCH, 1, sizeof(struct es_region));
+	if (!region) {
+		perror("ERROR: shared region malloc failed\n");
+		return NULL;
+	}
+	region->header = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (region->header == MAP_FAILED) {
+		perror("ERROR: shared region mmap failed\n");
+		a_free(ALLOCATOR_TAG_BATCH, region, sizeof(struct es_region));
+		return NULL;
+	}
+	region->fd = fd;
+	region->size = size;
+	region->spins = es_spins();
+	if (path) {
+		region->path = strdup(path);
+	}
+	return region;
+}
+
+es_region *es_create(const char *const path, const uint32_t count, const int width,
+		     const int height, const uint64_t seed)
+{
+	size_t arena = be_arena_size(count, width, height);
+	if (!path || !arena) {
+		return NULL;
+	}
+	size_t offsets[ENV_SERVER_ARRAYS] = { 0 };
+	size_t size = es_align(sizeof(struct es_header));
+	offsets[ENV_SERVER_ACTIONS] = size;
+	size = es_align(size + count);
+	offsets[ENV_SERVER_REWARDS] = size;
+	size = es_align(size + count * sizeof(float));
+	offsets[ENV_SERVER_DONES] = size;
+	size = es_align(size + count);
+	size_t batch_offset = size;
+	size += arena;
+
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		perror("ERROR: shared region open failed\n");
+		return NULL;
+	}
+	if (ftruncate(fd, (off_t)size) != 0) {
+		perror("ERROR: shared region resize failed\n");
+		goto es_create_failed;
+	}
+	es_region *region = es_map(fd, size, path);
+	if (!region) {
+		goto es_create_failed;
+	}
+	char *base = (char *)region->header;
+	region->batch = be_malloc_in(count, width, height, seed, base + batch_offset);
+	if (!region->batch) {
+		es_close(&region);
+		return NULL;
+	}
+
+	/* Observations are the batch arrays themselves, the trainer reads them where they are */
+	batch *batch = region->batch;
+	const void *arrays[] = { batch->head_x, batch->head_y, batch->food_x,
+				 batch->food_y, batch->direction, batch->alive,
+				 batch->score, batch->length, batch->bitmaps };
+	for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) {
+		offsets[ENV_SERVER_HEAD_X + i] = (size_t)((const char *)arrays[i] - base);
+	}
+	es_header *header = region->header;
+	header->version = ENV_SERVER_VERSION;
+	header->count = count;
+	header->width = width;
+	header->height = height;
+	header->bitmap_words = batch->bitmap_words;
+	header->size = size;
+	for (int i = 0; i < ENV_SERVER_ARRAYS; i++) {
+		header->offsets[i] = offsets[i];
+	}
+	/* Magic is written last, a trainer attaching early sees an unfinished region */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(header->magic, ENV_SERVER_MAGIC, sizeof(header->magic));
+	return region;
+
+es_create_failed:
+	close(fd);
+	unlink(path);
+	return NULL;
+}
+
+es_region *es_attach(const char *const path)
+{
+	int fd = open(path, O_RDWR);
+	if (fd < 0) {
+		perror("ERROR: shared region open failed\n");
+		return NULL;
+	}
+	struct stat status;
+	if (fstat(fd, &status) != 0 || (size_t)status.st_size < sizeof(struct es_header)) {
+		fprintf(stderr, "ERROR: %s is not a shared environment region\n", path);
+		close(fd);
+		return NULL;
+	}
+	es_region *region = es_map(fd, (size_t)status.st_size, NULL);
+	if (!region) {
+		close(fd);
+		return NULL;
+	}
+	es_header *header = region->header;
+	if (memcmp(header->magic, ENV_SERVER_MAGIC, sizeof(header->magic)) != 0
+	    || header->version != ENV_SERVER_VERSION || header->size != region->size) {
+		fprintf(stderr, "ERROR: %s is not a shared environment region of version %d\n", path,
+			ENV_SERVER_VERSION);
+		es_close(&region);
+		return NULL;
+	}
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return region;
+}
+
+void es_close(es_region **region)
+{
+	if (!region || !*region) {
+		return;
+	}
+	be_free(&(*region)->batch);
+	munmap((*region)->header, (*region)->size);
+	close((*region)->fd);
+	if ((*region)->path) {
+		unlink((*region)->path);
+		free((*region)->path);
+	}
+	a_free(ALLOCATOR_TAG_BATCH, *region, sizeof(struct es_region));
+	*region = NULL;
+}
+
+void es_serve(es_region *const region)
+{
+	if (!region || !region->batch) {
+		return;
+	}
+	es_header *header = region->header;
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = es_handle_signal;
+	sigemptyset(&action.sa_mask);
+	struct sigaction previous_interrupt, previous_terminate;
+	es_interrupted = 0;
+	es_serving = header;
+	sigaction(SIGINT, &action, &previous_interrupt);
+	sigaction(SIGTERM, &action, &previous_terminate);
+
+	const uint8_t *actions = es_get_array(region, ENV_SERVER_ACTIONS);
+	float *rewards = es_get_array(region, ENV_SERVER_REWARDS);
+	uint8_t *dones = es_get_array(region, ENV_SERVER_DONES);
+	while (!es_interrupted && !__atomic_load_n(&header->stop, __ATOMIC_ACQUIRE)) {
+		if (!m_event_wait_shared(&header->request, region->spins) || es_interrupted
+		    || __atomic_load_n(&header->stop, __ATOMIC_ACQUIRE)) {
+			continue;
+		}
+		be_step(region->batch, actions, rewards, dones);
+		header->steps++;
+		m_event_notify_shared(&header->response);
+	}
+
+	/* A trainer still waiting for a step is woken up to see the stop */
+	__atomic_store_n(&header->stop, 1, __ATOMIC_RELEASE);
+	m_event_notify_shared(&header->response);
+	sigaction(SIGINT, &previous_interrupt, NULL);
+	sigaction(SIGTERM, &previous_terminate, NULL);
+	es_serving = NULL;
+}
+
+short es_step(es_region *const region)
+{
+	es_header *header = region->header;
+	if (__atomic_load_n(&header->stop, __ATOMIC_ACQUIRE)) {
+		return 0;
+	}
+	m_event_notify_shared(&header->request);
+	return m_event_wait_shared(&header->response, region->spins)
+	       && !__atomic_load_n(&header->stop, __ATOMIC_ACQUIRE);
+}
+
+void es_stop(es_region *const region)
+{
+	__atomic_store_n(&region->header->stop, 1, __ATOMIC_RELEASE);
+	m_event_notify_shared(&region->header->request);
+}
+
+void *es_get_array(const es_region *const region, const es_array array)
+{
+	return (char *)region->header + region->header->offsets[array];
+}
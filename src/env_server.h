@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __ENV_SERVER_H__
+#define __ENV_SERVER_H__
+
+#include "batch.h"
+#include "monitor.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define ENV_SERVER_MAGIC "SNAKESHM"
+
+#define ENV_SERVER_VERSION 1
+
+/*
+ * Polls of an event before its waiter sleeps, no polling on a single CPU
+ */
+#define ENV_SERVER_SPINS 4096
+
+/*
+ * Arrays of the shared region, their offsets from the start of the region are in the header.
+ * Actions are one m_snake_move byte per environment, rewards a float and dones a byte.
+ * Heads, food, directions, alive flags, scores and lengths are 32-bit integers per environment,
+ * bitmaps are bitmap_words 64-bit words of taken cells per environment
+ */
+typedef enum es_array {
+	ENV_SERVER_ACTIONS,
+	ENV_SERVER_REWARDS,
+	ENV_SERVER_DONES,
+	ENV_SERVER_HEAD_X,
+	ENV_SERVER_HEAD_Y,
+	ENV_SERVER_FOOD_X,
+	ENV_SERVER_FOOD_Y,
+	ENV_SERVER_DIRECTION,
+	ENV_SERVER_ALIVE,
+	ENV_SERVER_SCORE,
+	ENV_SERVER_LENGTH,
+	ENV_SERVER_BITMAPS,
+	ENV_SERVER_ARRAYS
+} es_array;
+
+/*
+ * Start of the shared region.
+ * The trainer writes the actions and notifies request, the server steps every environment,
+ * writing observations, rewards and dones in place, and notifies response.
+ * Stop set by either side ends the server
+ */
+typedef struct es_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t count;
+	int32_t width;
+	int32_t height;
+	uint32_t bitmap_words;
+	uint32_t stop;
+	uint64_t size;
+	uint64_t steps;
+	uint64_t offsets[ENV_SERVER_ARRAYS];
+	m_event request __attribute__((aligned(MONITOR_CACHE_LINE)));
+	m_event response __attribute__((aligned(MONITOR_CACHE_LINE)));
+} es_header;
+
+/*
+ * Mapping of the shared region in one process, batch is only set in the server
+ */
+typedef struct es_region {
+	int fd;
+	size_t size;
+	unsigned int spins;
+	es_header *header;
+	batch *batch;
+	char *path;
+} es_region;
+
+/*
+ * Creates the shared region file at path with count environments on boards of given size
+ * \RETURNS: pointer to the region, NULL on failure
+ */
+es_region *es_create(const char *const path, const uint32_t count, const int width,
+		     const int height, const uint64_t seed);
+
+/*
+ * Maps the shared region a server created at path
+ * \RETURNS: pointer to the region, NULL on failure
+ */
+es_region *es_attach(const char *const path);
+
+/*
+ * Unmaps the region, the region file is removed if this process created it
+ */
+void es_close(es_region **region);
+
+/*
+ * Steps the environments whenever the trainer asks, until stop is set or SIGINT or SIGTERM
+ */
+void es_serve(es_region *const region);
+
+/*
+ * Asks the server for one step of every environment and waits until it is done
+ * \RETURNS: 1 on success, 0 if the server stopped or a signal interrupted the wait
+ */
+short es_step(es_region *const region);
+
+/*
+ * Tells the server to stop
+ */
+void es_stop(es_region *const region);
+
+/*
+ * RETURNS: pointer to array in the shared region
+ */
+void *es_get_array(const es_region *const region, const es_array array);
+
+#endif
@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#define _GNU_SOURCE
+#include "event_log.h"
+#include "allocator.h"
+#include "timing_wheel.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * All buffers ever allocated, pushed lock free and freed in el_finalize
+ */
+static el_buffer *el_buffers = NULL;
+
+/*
+ * Buffer claimed by the calling thread on its first record
+ */
+static __thread el_buffer *el_local = NULL;
+
+/*
+ * Releases the buffer of an exiting thread so the next new thread can claim it
+ */
+static pthread_key_t el_key;
+
+static uint32_t el_running = 0;
+static short el_started = 0;
+static int el_fd = -1;
+static pthread_t el_thread;
+static uint16_t el_threads = 0;
+static uint32_t el_games = 0;
+
+/*
+ * Writer wakeup, notified by a thread whose buffer got half full
+ */
+static m_event el_event = { EVENT_EMPTY };
+
+/*
+ * Batch and counters owned by the writer thread
+ */
+static el_record el_batch[EVENT_LOG_BATCH_SIZE];
+static size_t el_batch_count = 0;
+static uint64_t el_written = 0;
+static uint64_t el_dropped = 0;
+
+/*
+ * Appends a record to buffer, must only be called by the thread owning it
+ */
+static void el_append(el_buffer *const buffer, const el_type type, const uint32_t game,
+		      const uint32_t values[4])
+{
+	uint64_t head = buffer->head;
+	uint64_t tail = __atomic_load_n(&buffer->tail, __ATOMIC_ACQUIRE);
+	if (head - tail >= EVENT_LOG_BUFFER_SIZE) {
+		__atomic_store_n(&buffer->dropped, buffer->dropped + 1, __ATOMIC_RELAXED);
+		return;
+	}
+	el_record *record = &buffer->records[head % EVENT_LOG_BUFFER_SIZE];
+	record->time = tw_now();
+	record->game = game;
+	record->type = (uint16_t)type;
+	record->thread = buffer->thread;
+	memcpy(record->values, values, sizeof(record->values));
+	__atomic_store_n(&buffer->head, head + 1, __ATOMIC_RELEASE);
+	if (head + 1 - tail == EVENT_LOG_BUFFER_SIZE / 2) {
+		m_event_notify(&el_event);
+	}
+}
+
+static void el_buffer_release(void *buffer)
+{
+	__atomic_store_n(&((el_buffer *)buffer)->owned, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Claims a buffer left by an exited thread or allocates a new one,
+ * and records the name of the calling thread into it
+ * \RETURNS: the buffer, NULL if allocation failed
+ */
+static el_buffer *el_buffer_claim(void)
+{
+	el_buffer *buffer = __atomic_load_n(&el_buffers, __ATOMIC_ACQUIRE);
+	for (; buffer; buffer = buffer->next) {
+		uint32_t expected = 0;
+		if (!__atomic_load_n(&buffer->owned, __ATOMIC_RELAXED)
+		    && __atomic_compare_exchange_n(&buffer->owned, &expected, 1, 0, __ATOMIC_ACQUIRE,
+						__ATOMIC_RELAXED)) {
+			break;
+		}
+	}
+	if (!buffer) {
+		buffer = a_aligned(ALLOCATOR_TAG_EVENT_LOG, MONITOR_CACHE_LINE, sizeof(el_buffer));
+		if (!buffer) {
+			return NULL;
+		}
+		memset(buffer, 0, sizeof(el_buffer));
+		buffer->owned = 1;
+		buffer->thread = __atomic_fetch_add(&el_threads, 1, __ATOMIC_RELAXED);
+		buffer->next = __atomic_load_n(&el_buffers, __ATOMIC_RELAXED);
+		while (!__atomic_compare_exchange_n(&el_buffers, &buffer->next, buffer, 1,
+						    __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+		}
+	}
+	pthread_setspecific(el_key, buffer);
+	uint32_t name[4] = { 0 };
+	pthread_getname_np(pthread_self(), (char *)name, sizeof(name));
+	el_append(buffer, EVENT_LOG_THREAD, 0, name);
+	return buffer;
+}
+
+/*
+ * Writes the batch to the file, the file is closed after a failed write
+ */
+static void el_flush(void)
+{
+	const char *data = (const char *)el_batch;
+	size_t size = el_batch_count * sizeof(el_record);
+	while (size && el_fd >= 0) {
+		ssize_t written = write(el_fd, data, size);
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror("ERROR: writing event log failed\n");
+			close(el_fd);
+			el_fd = -1;
+			break;
+		}
+		data += written;
+		size -= (size_t)written;
+	}
+	if (el_fd >= 0) {
+		el_written += el_batch_count;
+	}
+	el_batch_count = 0;
+}
+
+static void el_batch_add(const el_record *const record)
+{
+	el_batch[el_batch_count++] = *record;
+	if (el_batch_count == EVENT_LOG_BATCH_SIZE) {
+		el_flush();
+	}
+}
+
+/*
+ * Moves records of every buffer into the batch and reports new drops, then writes the batch
+ */
+static void el_drain(void)
+{
+	for (el_buffer *buffer = __atomic_load_n(&el_buffers, __ATOMIC_ACQUIRE); buffer;
+	     buffer = buffer->next) {
+		uint64_t head = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+		uint64_t tail = buffer->tail;
+		for (; tail < head; tail++) {
+			el_batch_add(&buffer->records[tail % EVENT_LOG_BUFFER_SIZE]);
+		}
+		__atomic_store_n(&buffer->tail, tail, __ATOMIC_RELEASE);
+
+		uint64_t dropped = __atomic_load_n(&buffer->dropped, __ATOMIC_RELAXED);
+		if (dropped != buffer->reported) {
+			uint64_t count = dropped - buffer->reported;
+			el_record record = { tw_now(),
+					     0,
+					     EVENT_LOG_DROPPED,
+					     buffer->thread,
+					     { (uint32_t)count, (uint32_t)(count >> 32), 0, 0 } };
+			el_batch_add(&record);
+			el_dropped += count;
+			buffer->reported = dropped;
+		}
+	}
+	el_flush();
+}
+
+static void *el_writer_thread(void *args)
+{
+	(void)args;
+	pthread_setname_np(pthread_self(), "log writer");
+	while (__atomic_load_n(&el_running, __ATOMIC_ACQUIRE)) {
+		m_event_wait(&el_event, tw_now() + EVENT_LOG_INTERVAL);
+		el_drain();
+	}
+	return NULL;
+}
+
+short el_initialize(const char *const path)
+{
+	if (!path || el_started) {
+		return 0;
+	}
+	el_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (el_fd < 0) {
+		perror("ERROR: opening event log failed\n");
+		return 0;
+	}
+	char header[16];
+	uint32_t version = EVENT_LOG_VERSION;
+	uint32_t size = sizeof(el_record);
+	memcpy(header, EVENT_LOG_MAGIC, 8);
+	memcpy(header + 8, &version, sizeof(version));
+	memcpy(header + 12, &size, sizeof(size));
+	if (write(el_fd, header, sizeof(header)) != (ssize_t)sizeof(header)) {
+		perror("ERROR: writing event log header failed\n");
+		goto el_close;
+	}
+	if (pthread_key_create(&el_key, el_buffer_release)) {
+		goto el_close;
+	}
+	/* Writer starts with every signal blocked, signals stay with the threads handling them */
+	sigset_t all, previous;
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &previous);
+	__atomic_store_n(&el_running, 1, __ATOMIC_RELEASE);
+	int error = pthread_create(&el_thread, NULL, el_writer_thread, NULL);
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+	if (error) {
+		fprintf(stderr, "ERROR: creating event log writer failed\n");
+		__atomic_store_n(&el_running, 0, __ATOMIC_RELEASE);
+		pthread_key_delete(el_key);
+		goto el_close;
+	}
+	el_started = 1;
+	return 1;
+
+el_close:
+	close(el_fd);
+	el_fd = -1;
+	return 0;
+}
+
+void el_finalize(void)
+{
+	if (!__atomic_load_n(&el_running, __ATOMIC_ACQUIRE)) {
+		return;
+	}
+	__atomic_store_n(&el_running, 0, __ATOMIC_RELEASE);
+	m_event_notify(&el_event);
+	pthread_join(el_thread, NULL);
+	el_drain();
+	if (el_fd >= 0) {
+		close(el_fd);
+		el_fd = -1;
+	}
+	pthread_key_delete(el_key);
+	el_buffer *buffer = __atomic_exchange_n(&el_buffers, NULL, __ATOMIC_ACQUIRE);
+	while (buffer) {
+		el_buffer *next = buffer->next;
+		a_free(ALLOCATOR_TAG_EVENT_LOG, buffer, sizeof(el_buffer));
+		buffer = next;
+	}
+	el_local = NULL;
+}
+
+void el_log(const el_type type, const uint32_t game, const uint32_t a, const uint32_t b,
+	    const uint32_t c, const uint32_t d)
+{
+	if (!__atomic_load_n(&el_running, __ATOMIC_RELAXED)) {
+		return;
+	}
+	if (!el_local && !(el_local = el_buffer_claim())) {
+		return;
+	}
+	const uint32_t values[4] = { a, b, c, d };
+	el_append(el_local, type, game, values);
+}
+
+uint32_t el_next_game(void)
+{
+	return __atomic_add_fetch(&el_games, 1, __ATOMIC_RELAXED);
+}
+
+void el_report(FILE *const stream)
+{
+	if (!el_started) {
+		return;
+	}
+	fprintf(stream, "event log: %llu records written, %llu dropped\n",
+		(unsigned long long)el_written, (unsigned long long)el_dropped);
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __EVENT_LOG_H__
+#define __EVENT_LOG_H__
+
+#include "monitor.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Records kept per thread until the writer takes them, records that do not fit are dropped
+ */
+#define EVENT_LOG_BUFFER_SIZE 1024
+
+/*
+ * Records written to the file with one write call
+ */
+#define EVENT_LOG_BATCH_SIZE 2048
+
+/*
+ * Nanoseconds the writer sleeps between flushes unless a buffer fills up first
+ */
+#define EVENT_LOG_INTERVAL 100000000
+
+/*
+ * File starts with the magic, the version and the record size as 32 bit integers
+ */
+#define EVENT_LOG_MAGIC "SNAKELOG"
+#define EVENT_LOG_VERSION 1
+
+/*
+ * Record types and meaning of their values
+ */
+typedef enum el_type {
+	/* Name of the thread, 16 bytes packed into the values */
+	EVENT_LOG_THREAD,
+	/* Head x, head y, board width, board height */
+	EVENT_LOG_GAME_START,
+	/* Food x, food y, score, body length */
+	EVENT_LOG_FOOD,
+	/* Score, body length, ticks */
+	EVENT_LOG_DEATH,
+	/* Score, ticks, mean and maximum tick jitter in microseconds */
+	EVENT_LOG_GAME_END,
+	/* Records dropped by the thread since the last report, low and high 32 bits */
+	EVENT_LOG_DROPPED
+} el_type;
+
+/*
+ * Fixed size record as written to the file in host byte order.
+ * Time is monotonic time in nanoseconds, game numbers games of the process from 1,
+ * thread numbers the buffer that recorded it
+ */
+typedef struct el_record {
+	uint64_t time;
+	uint32_t game;
+	uint16_t type;
+	uint16_t thread;
+	uint32_t values[4];
+} el_record;
+
+/*
+ * Single producer ring of one thread.
+ * Head is only written by the owner thread and tail only by the writer,
+ * each on its own cache line. A buffer of an exited thread is claimed by the next new thread
+ */
+typedef struct el_buffer {
+	el_record records[EVENT_LOG_BUFFER_SIZE];
+	uint64_t head __attribute__((aligned(MONITOR_CACHE_LINE)));
+	uint64_t dropped;
+	uint64_t tail __attribute__((aligned(MONITOR_CACHE_LINE)));
+	uint64_t reported;
+	uint32_t owned;
+	uint16_t thread;
+	struct el_buffer *next;
+} el_buffer;
+
+/*
+ * Opens path for writing and starts the writer thread
+ * \RETURNS: 1 if logging was started, 0 otherwise
+ */
+short el_initialize(const char *const path);
+
+/*
+ * Stops the writer, writes all remaining records, closes the file and frees the buffers.
+ * Threads that logged have to be finished before
+ */
+void el_finalize(void);
+
+/*
+ * Appends a record to the buffer of the calling thread, never blocks.
+ * Does nothing if logging was not started, counts the record as dropped if the buffer is full
+ */
+void el_log(const el_type type, const uint32_t game, const uint32_t a, const uint32_t b,
+	    const uint32_t c, const uint32_t d);
+
+/*
+ * RETURNS: number of the next game, unique within the process
+ */
+uint32_t el_next_game(void);
+
+/*
+ * Prints number of records written and dropped, nothing if logging was not started
+ */
+void el_report(FILE *const stream);
+
+#endif
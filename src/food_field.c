@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "food_field.h"
+#include "allocator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * RETURNS: number of 64-bit words of the blocked bitmap of field
+ */
+static size_t ff_words(const food_field *const field)
+{
+	return ((size_t)field->cells + 63) / 64;
+}
+
+/*
+ * RETURNS: 1 if cell is taken or on the border, 0 otherwise
+ */
+static short ff_blocked(const food_field *const field, const uint32_t cell)
+{
+	return (short)((field->blocked[cell >> 6] >> (cell & 63)) & 1);
+}
+
+/*
+ * Breadth-first search from the count cells in the queue, whose distances are already set,
+ * lowering the distances of the free cells around them
+ * \RETURNS: number of cells visited
+ */
+static uint32_t ff_spread(food_field *const field, uint32_t count)
+{
+	uint32_t width = (uint32_t)field->width;
+	uint32_t *distance = field->distance;
+	for (uint32_t head = 0; head < count; head++) {
+		uint32_t cell = field->queue[head];
+		uint32_t next = distance[cell] + 1;
+		const uint32_t neighbours[4] = { cell - width, cell + width, cell + 1, cell - 1 };
+		for (int i = 0; i < 4; i++) {
+			uint32_t neighbour = neighbours[i];
+			if (next < distance[neighbour] && !ff_blocked(field, neighbour)) {
+				distance[neighbour] = next;
+				field->queue[count++] = neighbour;
+			}
+		}
+	}
+	return count;
+}
+
+/*
+ * RETURNS: smallest distance of the neighbours of cell
+ */
+static uint32_t ff_nearest(const food_field *const field, const uint32_t cell)
+{
+	uint32_t width = (uint32_t)field->width;
+	const uint32_t neighbours[4] = { cell - width, cell + width, cell + 1, cell - 1 };
+	uint32_t nearest = FOOD_FIELD_UNREACHABLE;
+	for (int i = 0; i < 4; i++) {
+		uint32_t distance = field->distance[neighbours[i]];
+		nearest = distance < nearest ? distance : nearest;
+	}
+	return nearest;
+}
+
+static int ff_compare_seeds(const void *a, const void *b)
+{
+	uint64_t left = *(const uint64_t *)a;
+	uint64_t right = *(const uint64_t *)b;
+	return (left > right) - (left < right);
+}
+
+food_field *ff_malloc(const int width, const int height)
+{
+	if (width < 3 || height < 3 || (uint64_t)width * (uint64_t)height >= UINT32_MAX) {
+		return NULL;
+	}
+	food_field *field = a_calloc(ALLOCATOR_TAG_BOT, 1, sizeof(struct food_field));
+	if (!field) {
+		perror("ERROR: food field malloc failed\n");
+		return NULL;
+	}
+	field->width = width;
+	field->height = height;
+	field->cells = (uint32_t)width * (uint32_t)height;
+	field->food = FOOD_FIELD_UNREACHABLE;
+	field->distance = a_malloc(ALLOCATOR_TAG_BOT, field->cells * sizeof(uint32_t));
+	field->blocked = a_calloc(ALLOCATOR_TAG_BOT, ff_words(field), sizeof(uint64_t));
+	field->queue = a_malloc(ALLOCATOR_TAG_BOT, field->cells * sizeof(uint32_t));
+	field->seeds = a_malloc(ALLOCATOR_TAG_BOT, field->cells * sizeof(uint64_t));
+	if (!field->distance || !field->blocked || !field->queue || !field->seeds) {
+		perror("ERROR: food field arrays malloc failed\n");
+		ff_free(&field);
+		return NULL;
+	}
+	memset(field->distance, 0xff, field->cells * sizeof(uint32_t));
+	return field;
+}
+
+void ff_free(food_field **field)
+{
+	if (!field || !*field) {
+		return;
+	}
+	size_t cells = (*field)->cells;
+	a_free(ALLOCATOR_TAG_BOT, (*field)->distance, cells * sizeof(uint32_t));
+	a_free(ALLOCATOR_TAG_BOT, (*field)->blocked, ff_words(*field) * sizeof(uint64_t));
+	a_free(ALLOCATOR_TAG_BOT, (*field)->queue, cells * sizeof(uint32_t));
+	a_free(ALLOCATOR_TAG_BOT, (*field)->seeds, cells * sizeof(uint64_t));
+	a_free(ALLOCATOR_TAG_BOT, *field, sizeof(struct food_field));
+	*field = NULL;
+}
+
+void ff_rebuild(food_field *const field, const uint64_t *const taken, const uint32_t food)
+{
+	if (!field || !taken) {
+		return;
+	}
+	memcpy(field->blocked, taken, ff_words(field) * sizeof(uint64_t));
+	uint32_t width = (uint32_t)field->width;
+	for (uint32_t x = 0; x < width; x++) {
+		uint32_t bottom = field->cells - width + x;
+		field->blocked[x >> 6] |= 1ULL << (x & 63);
+		field->blocked[bottom >> 6] |= 1ULL << (bottom & 63);
+	}
+	for (uint32_t left = 0; left < field->cells; left += width) {
+		uint32_t right = left + width - 1;
+		field->blocked[left >> 6] |= 1ULL << (left & 63);
+		field->blocked[right >> 6] |= 1ULL << (right & 63);
+	}
+	memset(field->distance, 0xff, field->cells * sizeof(uint32_t));
+	field->food = food;
+	field->rebuilds++;
+	if (food >= field->cells) {
+		return;
+	}
+	field->distance[food] = 0;
+	field->queue[0] = food;
+	ff_spread(field, 1);
+}
+
+void ff_block(food_field *const field, const uint32_t cell)
+{
+	if (!field || cell >= field->cells || ff_blocked(field, cell)) {
+		return;
+	}
+	field->blocked[cell >> 6] |= 1ULL << (cell & 63);
+	uint32_t *distance = field->distance;
+	uint32_t width = (uint32_t)field->width;
+	if (cell == field->food || distance[cell] == FOOD_FIELD_UNREACHABLE) {
+		return;
+	}
+	field->updates++;
+
+	/*
+	 * Cells whose every shortest path went through cell lose their distance, found layer by
+	 * layer away from the food, so a cell is checked after every cell of the layer before it
+	 * lost its distance or kept it. Seeds hold the old distances meanwhile
+	 */
+	uint32_t *queue = field->queue;
+	uint64_t *seeds = field->seeds;
+	uint32_t count = 1;
+	queue[0] = cell;
+	seeds[0] = distance[cell];
+	distance[cell] = FOOD_FIELD_UNREACHABLE;
+	for (uint32_t head = 0; head < count; head++) {
+		uint32_t parent = queue[head];
+		uint32_t child_distance = (uint32_t)seeds[head] + 1;
+		const uint32_t children[4] = { parent - width, parent + width, parent + 1,
+					       parent - 1 };
+		for (int i = 0; i < 4; i++) {
+			uint32_t child = children[i];
+			if (distance[child] != child_distance
+			    || ff_nearest(field, child) == child_distance - 1) {
+				continue;
+			}
+			queue[count] = child;
+			seeds[count] = child_distance;
+			count++;
+			distance[child] = FOOD_FIELD_UNREACHABLE;
+		}
+	}
+	field->touched += count;
+
+	/* Orphans start from their nearest neighbour that kept its distance, nearest first */
+	uint32_t seeded = 0;
+	for (uint32_t i = 1; i < count; i++) {
+		uint32_t nearest = ff_nearest(field, queue[i]);
+		if (nearest != FOOD_FIELD_UNREACHABLE) {
+			distance[queue[i]] = nearest + 1;
+			seeds[seeded++] = (uint64_t)(nearest + 1) << 32 | queue[i];
+		}
+	}
+	qsort(seeds, seeded, sizeof(uint64_t), ff_compare_seeds);
+
+	/*
+	 * Seeds and the cells they reach are taken in order of distance from two sorted queues,
+	 * a seed lowered by the search before its turn is skipped
+	 */
+	uint32_t next_seed = 0;
+	uint32_t head = 0;
+	uint32_t tail = 0;
+	while (next_seed < seeded || head < tail) {
+		uint32_t at;
+		if (next_seed < seeded
+		    && (head == tail || (seeds[next_seed] >> 32) <= distance[queue[head]])) {
+			at = (uint32_t)seeds[next_seed];
+			if (distance[at] != seeds[next_seed++] >> 32) {
+				continue;
+			}
+		} else {
+			at = queue[head++];
+		}
+		uint32_t next = distance[at] + 1;
+		const uint32_t neighbours[4] = { at - width, at + width, at + 1, at - 1 };
+		for (int i = 0; i < 4; i++) {
+			uint32_t neighbour = neighbours[i];
+			if (next < distance[neighbour] && !ff_blocked(field, neighbour)) {
+				distance[neighbour] = next;
+				queue[tail++] = neighbour;
+			}
+		}
+	}
+	field->touched += tail;
+}
+
+void ff_unblock(food_field *const field, const uint32_t cell)
+{
+	if (!field || cell >= field->cells || !ff_blocked(field, cell)) {
+		return;
+	}
+	field->blocked[cell >> 6] &= ~(1ULL << (cell & 63));
+	if (cell == field->food) {
+		return;
+	}
+	uint32_t nearest = ff_nearest(field, cell);
+	if (nearest == FOOD_FIELD_UNREACHABLE) {
+		return;
+	}
+	field->updates++;
+	field->distance[cell] = nearest + 1;
+	field->queue[0] = cell;
+	field->touched += ff_spread(field, 1);
+}
+
+short ff_follow(food_field *const field, const game_state *const state)
+{
+	if (!field || !state || state->width != field->width || state->height != field->height) {
+		return 0;
+	}
+	short repaired = state->length && state->alive && state->food == field->food
+			 && state->length == field->length && state->ticks == field->ticks + 1;
+	if (repaired) {
+		ff_block(field, gs_head(state));
+		ff_unblock(field, field->tail);
+	} else {
+		ff_rebuild(field, state->data, state->food);
+	}
+	field->tail = state->length ? gs_tail(state) : FOOD_FIELD_UNREACHABLE;
+	field->length = state->length;
+	field->ticks = state->ticks;
+	return repaired;
+}
+
+m_snake_move ff_next(const food_field *const field, const uint32_t cell)
+{
+	uint32_t width = (uint32_t)field->width;
+	const uint32_t neighbours[4] = { cell - width, cell + width, cell + 1, cell - 1 };
+	const m_snake_move moves[4] = { SNAKE_MOVE_UP, SNAKE_MOVE_DOWN, SNAKE_MOVE_RIGHT,
+					SNAKE_MOVE_LEFT };
+	m_snake_move move = SNAKE_MOVE_EMPTY;
+	uint32_t nearest = FOOD_FIELD_UNREACHABLE;
+	for (int i = 0; i < 4; i++) {
+		if (field->distance[neighbours[i]] < nearest) {
+			nearest = field->distance[neighbours[i]];
+			move = moves[i];
+		}
+	}
+	return move;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __FOOD_FIELD_H__
+#define __FOOD_FIELD_H__
+
+#include "game_state.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Distance of cells the food can not be reached from
+ */
+#define FOOD_FIELD_UNREACHABLE UINT32_MAX
+
+/*
+ * Shortest path distances from every cell to the food through free cells, cells are numbered
+ * y * width + x. The food cell is 0, taken cells other than the food are unreachable.
+ * Blocked is the bitmap of taken cells with the border added.
+ * Between two pieces of food a tick only takes the head cell and frees the tail cell, so the
+ * field is repaired around those two cells and rebuilt only when the food moves.
+ * Head, tail, length and ticks are those of the game state the field follows.
+ * Queue and seeds are scratch space of the searches, touched counts cells visited by repairs
+ */
+typedef struct food_field {
+	int width;
+	int height;
+	uint32_t cells;
+	uint32_t food;
+	uint32_t tail;
+	uint32_t length;
+	uint64_t ticks;
+	uint32_t *distance;
+	uint64_t *blocked;
+	uint32_t *queue;
+	uint64_t *seeds;
+	uint64_t rebuilds;
+	uint64_t updates;
+	uint64_t touched;
+} food_field;
+
+/*
+ * Creates a field for given board size, with no food until it is rebuilt
+ * \RETURNS: pointer to the field, NULL on failure
+ */
+food_field *ff_malloc(const int width, const int height);
+
+/*
+ * Frees given field
+ */
+void ff_free(food_field **field);
+
+/*
+ * Computes every distance again from scratch with a breadth-first search from food,
+ * taken is a bitmap with bit y * width + x set for every taken cell
+ */
+void ff_rebuild(food_field *const field, const uint64_t *const taken, const uint32_t food);
+
+/*
+ * Takes cell, distances that led through it grow or become unreachable
+ */
+void ff_block(food_field *const field, const uint32_t cell);
+
+/*
+ * Frees cell, distances that can go through it shrink
+ */
+void ff_unblock(food_field *const field, const uint32_t cell);
+
+/*
+ * Brings the field up to date with state, which has to be one gs_step ahead of the state the
+ * field followed before, or the field is rebuilt
+ * \RETURNS: 1 if the field was repaired, 0 if it was rebuilt
+ */
+short ff_follow(food_field *const field, const game_state *const state);
+
+/*
+ * Move from cell to its neighbour closest to the food
+ * \RETURNS: the move, SNAKE_MOVE_EMPTY if no neighbour can reach the food
+ */
+m_snake_move ff_next(const food_field *const field, const uint32_t cell);
+
+/*
+ * RETURNS: distance from cell to the food, FOOD_FIELD_UNREACHABLE if it can not be reached
+ */
+static inline uint32_t ff_distance(const food_field *const field, const uint32_t cell)
+{
+	return field->distance[cell];
+}
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "food_set.h"
+#include "allocator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+food_set *fs_malloc(const int width, const int height, const uint32_t capacity)
+{
+	if (width < 1 || height < 1 || capacity < 1
+	    || (uint64_t)width * (uint64_t)height >= UINT32_MAX
+	    || capacity > (uint64_t)width * (uint64_t)height) {
+		return NULL;
+	}
+	food_set *set = a_calloc(ALLOCATOR_TAG_SNAKE, 1, sizeof(struct food_set));
+	if (!set) {
+		perror("ERROR: food set malloc failed\n");
+		return NULL;
+	}
+	set->width = (uint32_t)width;
+	set->height = (uint32_t)height;
+	set->capacity = capacity;
+	set->ring = capacity + FOOD_SET_SPAWN_SLACK;
+	set->slots = a_calloc(ALLOCATOR_TAG_SNAKE, (size_t)set->width * set->height,
+			      sizeof(uint32_t));
+	set->items = a_malloc(ALLOCATOR_TAG_SNAKE, capacity * sizeof(uint32_t));
+	set->spawns = a_malloc(ALLOCATOR_TAG_SNAKE, set->ring * sizeof(uint32_t));
+	if (!set->slots || !set->items || !set->spawns) {
+		perror("ERROR: food set arrays malloc failed\n");
+		fs_free(&set);
+		return NULL;
+	}
+	return set;
+}
+
+void fs_free(food_set **set)
+{
+	if (!set || !*set) {
+		return;
+	}
+	size_t cells = (size_t)(*set)->width * (*set)->height;
+	a_free(ALLOCATOR_TAG_SNAKE, (*set)->slots, cells * sizeof(uint32_t));
+	a_free(ALLOCATOR_TAG_SNAKE, (*set)->items, (*set)->capacity * sizeof(uint32_t));
+	a_free(ALLOCATOR_TAG_SNAKE, (*set)->spawns, (*set)->ring * sizeof(uint32_t));
+	a_free(ALLOCATOR_TAG_SNAKE, *set, sizeof(struct food_set));
+	*set = NULL;
+}
+
+short fs_add(food_set *const set, const uint32_t cell)
+{
+	if (!set || set->count == set->capacity || set->slots[cell]) {
+		return 0;
+	}
+	__atomic_store_n(&set->items[set->count], cell, __ATOMIC_RELAXED);
+	__atomic_store_n(&set->count, set->count + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&set->slots[cell], set->count, __ATOMIC_RELAXED);
+	__atomic_store_n(&set->spawns[set->spawned % set->ring], cell, __ATOMIC_RELAXED);
+	/* Released so the drawing thread sees the ring entry before the count that covers it */
+	__atomic_store_n(&set->spawned, set->spawned + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+short fs_remove(food_set *const set, const uint32_t cell)
+{
+	if (!set || !set->slots[cell]) {
+		return 0;
+	}
+	uint32_t index = set->slots[cell] - 1;
+	uint32_t last = set->items[set->count - 1];
+	__atomic_store_n(&set->count, set->count - 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&set->items[index], last, __ATOMIC_RELAXED);
+	__atomic_store_n(&set->slots[last], index + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&set->slots[cell], 0, __ATOMIC_RELAXED);
+	return 1;
+}
+
+void fs_clear(food_set *const set)
+{
+	if (!set) {
+		return;
+	}
+	for (uint32_t i = 0; i < set->count; i++) {
+		__atomic_store_n(&set->slots[set->items[i]], 0, __ATOMIC_RELAXED);
+	}
+	__atomic_store_n(&set->count, 0, __ATOMIC_RELAXED);
+	/* The drawing thread moves its own cursor past cleared once it sees the new generation */
+	__atomic_store_n(&set->cleared, set->spawned, __ATOMIC_RELAXED);
+	__atomic_store_n(&set->generation, set->generation + 1, __ATOMIC_RELEASE);
+}
+
+short fs_next_spawn(food_set *const set, uint32_t *const cell)
+{
+	if (!set || !cell) {
+		return 0;
+	}
+	uint64_t generation = __atomic_load_n(&set->generation, __ATOMIC_ACQUIRE);
+	uint64_t spawned = __atomic_load_n(&set->spawned, __ATOMIC_ACQUIRE);
+	if (generation != set->seen) {
+		uint64_t cleared = __atomic_load_n(&set->cleared, __ATOMIC_RELAXED);
+		set->seen = generation;
+		set->redraw = 0;
+		if (set->drawn < cleared) {
+			set->drawn = cleared;
+		}
+	}
+	/* Additions older than the ring were overwritten, so every item is drawn again instead */
+	if (spawned - set->drawn > set->ring) {
+		set->drawn = spawned;
+		set->redraw = __atomic_load_n(&set->count, __ATOMIC_RELAXED);
+	}
+	while (set->redraw) {
+		uint32_t index = --set->redraw;
+		if (index < __atomic_load_n(&set->count, __ATOMIC_RELAXED)) {
+			*cell = __atomic_load_n(&set->items[index], __ATOMIC_RELAXED);
+			return 1;
+		}
+	}
+	while (set->drawn < spawned) {
+		uint32_t spawn = __atomic_load_n(&set->spawns[set->drawn++ % set->ring],
+						 __ATOMIC_RELAXED);
+		if (__atomic_load_n(&set->slots[spawn], __ATOMIC_RELAXED)) {
+			*cell = spawn;
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __FOOD_SET_H__
+#define __FOOD_SET_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Additions remembered for drawing beyond the capacity of a set, one is made per food eaten,
+ * so the drawing thread can fall this many ticks behind before it draws every item again
+ */
+#define FOOD_SET_SPAWN_SLACK 64
+
+/*
+ * Food items on a board, cells are numbered y * width + x.
+ * Slots is indexed by cell and holds the index of the item on it plus one, 0 for no food,
+ * items holds the cells of the count items densely, so lookups, additions and removals are O(1).
+ * Spawns is a ring of the cells of the last ring additions, spawned counts all additions.
+ * Generation counts clears and cleared is spawned at the last one.
+ * The thread changing the set writes count and the arrays with relaxed atomic stores and
+ * publishes with release stores of spawned and generation, the drawing thread only reads them
+ * after acquiring those.
+ * Drawn, redraw and seen are the cursor of the drawing thread and only touched by it: drawn
+ * counts additions taken by fs_next_spawn, redraw the items still to be drawn again after the
+ * ring was overrun and seen the last generation it handled
+ */
+typedef struct food_set {
+	uint32_t width;
+	uint32_t height;
+	uint32_t capacity;
+	uint32_t count;
+	uint32_t ring;
+	uint64_t spawned;
+	uint64_t generation;
+	uint64_t cleared;
+	uint32_t *slots;
+	uint32_t *items;
+	uint32_t *spawns;
+	/* Drawing thread cursor */
+	uint32_t redraw;
+	uint64_t drawn;
+	uint64_t seen;
+} food_set;
+
+/*
+ * Creates an empty set for a board of given size, holding at most capacity items,
+ * which can not be more than the cells of the board
+ * \RETURNS: pointer to the set, NULL on failure
+ */
+food_set *fs_malloc(const int width, const int height, const uint32_t capacity);
+
+/*
+ * Frees given set
+ */
+void fs_free(food_set **set);
+
+/*
+ * Puts an item on cell
+ * \RETURNS: 1 on success, 0 if the set is full or cell already holds food
+ */
+short fs_add(food_set *const set, const uint32_t cell);
+
+/*
+ * Removes the item on cell, the last item takes its place in items
+ * \RETURNS: 1 if cell held food, 0 if not
+ */
+short fs_remove(food_set *const set, const uint32_t cell);
+
+/*
+ * Removes every item, additions not drawn yet are skipped by fs_next_spawn
+ */
+void fs_clear(food_set *const set);
+
+/*
+ * Takes the next item added since the last call that is still on the board.
+ * Only called by the thread drawing the board, while another one changes the set
+ * \RETURNS: 1 if cell was set to such an item, 0 if there are none left
+ */
+short fs_next_spawn(food_set *const set, uint32_t *const cell);
+
+/*
+ * RETURNS: 1 if cell holds food, 0 if not
+ */
+static inline short fs_has(const food_set *const set, const uint32_t cell)
+{
+	return set->slots[cell] != 0;
+}
+
+/*
+ * RETURNS: cell of the item at index, which has to be below count
+ */
+static inline uint32_t fs_item(const food_set *const set, const uint32_t index)
+{
+	return set->items[index];
+}
+
+#endif
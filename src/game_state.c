@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "game_state.h"
+#include "allocator.h"
+#include "food_set.h"
+#include "map.h"
+#include "zobrist.h"
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * RETURNS: bitmap of cells taken by the snake
+ */
+static uint64_t *gs_bitmap(game_state *const state)
+{
+	return state->data;
+}
+
+/*
+ * RETURNS: body ring of the state
+ */
+static uint16_t *gs_body(game_state *const state)
+{
+	return (uint16_t *)(state->data + state->bitmap_words);
+}
+
+static const uint16_t *gs_body_const(const game_state *const state)
+{
+	return (const uint16_t *)(state->data + state->bitmap_words);
+}
+
+static void gs_push(game_state *const state, const uint16_t cell)
+{
+	state->hash ^= z_push(state->length ? (int64_t)gs_head(state) : -1, cell);
+	gs_body(state)[(state->tail + state->length) % state->capacity] = cell;
+	state->length++;
+	gs_bitmap(state)[cell >> 6] |= 1ULL << (cell & 63);
+}
+
+static void gs_pop(game_state *const state)
+{
+	if (!state->length) {
+		return;
+	}
+	uint16_t cell = gs_body(state)[state->tail];
+	state->hash ^= z_pop(cell, state->length == 1);
+	gs_bitmap(state)[cell >> 6] &= ~(1ULL << (cell & 63));
+	state->tail = (state->tail + 1) % state->capacity;
+	state->length--;
+}
+
+/*
+ * Places food the way s_generate_food does, from the same generator
+ */
+static void gs_generate_food(game_state *const state)
+{
+	uint32_t x = s_random(&state->random) % (uint32_t)(state->width - 2) + 1;
+	uint32_t y = s_random(&state->random) % (uint32_t)(state->height - 2) + 1;
+	int attempts = 1;
+	while (state->walled && attempts++ < MAP_FOOD_ATTEMPTS
+	       && gs_taken(state, y * state->width + x)) {
+		x = s_random(&state->random) % (uint32_t)(state->width - 2) + 1;
+		y = s_random(&state->random) % (uint32_t)(state->height - 2) + 1;
+	}
+	state->hash ^= z_key(ZOBRIST_FOOD, state->food) ^ z_key(ZOBRIST_FOOD, y * state->width + x);
+	state->food = (uint16_t)(y * state->width + x);
+}
+
+size_t gs_size(const int width, const int height)
+{
+	if (width < 3 || height < 3 || (long)width * height > GAME_STATE_MAX_CELLS) {
+		return 0;
+	}
+	size_t cells = (size_t)width * (size_t)height;
+	size_t bitmap = (cells + 63) / 64 * sizeof(uint64_t);
+	size_t body = (size_t)(width - 2) * (size_t)(height - 2) * sizeof(uint16_t);
+	return (sizeof(game_state) + bitmap + body + 7) & ~(size_t)7;
+}
+
+game_state *gs_malloc(const int width, const int height)
+{
+	size_t size = gs_size(width, height);
+	if (!size) {
+		fprintf(stderr, "ERROR: board is too large for a game state\n");
+		return NULL;
+	}
+	game_state *state = a_calloc(ALLOCATOR_TAG_STATE, 1, size);
+	if (!state) {
+		perror("ERROR: game state malloc failed\n");
+		return NULL;
+	}
+	state->size = (uint32_t)size;
+	state->width = (uint16_t)width;
+	state->height = (uint16_t)height;
+	state->capacity = (uint32_t)((width - 2) * (height - 2));
+	state->bitmap_words = (uint32_t)(((size_t)width * (size_t)height + 63) / 64);
+	state->direction = SNAKE_MOVE_RIGHT;
+	state->alive = 1;
+	return state;
+}
+
+void gs_free(game_state **state)
+{
+	if (!state || !*state) {
+		return;
+	}
+	a_free(ALLOCATOR_TAG_STATE, *state, (*state)->size);
+	*state = NULL;
+}
+
+short gs_snapshot(game_state *const state, const snake *const snake, const monitor *const monitor)
+{
+	if (!state || !snake || !snake->board || snake->board->width != state->width
+	    || snake->board->height != state->height) {
+		return 0;
+	}
+	if (s_body_length(snake) > state->capacity) {
+		return 0;
+	}
+	/* Walls of a map are taken cells the body never leaves */
+	state->walled = snake->board->map != NULL;
+	if (state->walled) {
+		memcpy(gs_bitmap(state), snake->board->map->walls,
+		       state->bitmap_words * sizeof(uint64_t));
+	} else {
+		memset(gs_bitmap(state), 0, state->bitmap_words * sizeof(uint64_t));
+	}
+	state->tail = 0;
+	state->length = 0;
+	s_body_iterator cell;
+	for (short more = s_body_begin(snake, &cell); more; more = s_body_next(&cell)) {
+		gs_push(state, (uint16_t)(cell.at.y * state->width + cell.at.x));
+	}
+	state->score = snake->score;
+	state->ticks = snake->ticks;
+	state->random = snake->random;
+	state->food = snake->food.x < 0 ? 0 : (uint16_t)(snake->food.y * state->width + snake->food.x);
+	state->hash = snake->hash;
+	state->direction = (uint8_t)(monitor ? monitor->move_previous : SNAKE_MOVE_RIGHT);
+	state->alive = (uint8_t)(monitor ? monitor->snake_alive != 0 : 1);
+	return 1;
+}
+
+short gs_restore(const game_state *const state, snake *const snake, monitor *const monitor)
+{
+	if (!state || !snake || !snake->board || snake->board->width != state->width
+	    || snake->board->height != state->height) {
+		return 0;
+	}
+	s_clear_snake_body(snake);
+	const uint16_t *body = gs_body_const(state);
+	for (uint32_t i = 0; i < state->length; i++) {
+		uint16_t cell = body[(state->tail + i) % state->capacity];
+		snake->head = (s_coordinates){ cell % state->width, cell / state->width };
+		s_push_snake_head(snake);
+	}
+	snake->tail = (s_coordinates){ -1, -1 };
+	snake->food = (s_coordinates){ state->food % state->width, state->food / state->width };
+	fs_add(snake->foods, state->food);
+	b_cell_set(snake->board, snake->food.x, snake->food.y, BOARD_CELL_FOOD);
+	snake->score = state->score;
+	snake->ticks = (unsigned long)state->ticks;
+	snake->random = state->random;
+	snake->hash = state->hash;
+	if (monitor) {
+		monitor->move_previous = (enum m_snake_move)state->direction;
+		monitor->move_next[0] = SNAKE_MOVE_EMPTY;
+		monitor->move_next[1] = SNAKE_MOVE_EMPTY;
+		monitor->snake_alive = state->alive;
+	}
+	return 1;
+}
+
+void gs_clone(game_state *const destination, const game_state *const source)
+{
+	memcpy(destination, source, source->size);
+}
+
+short gs_step(game_state *const state, const m_snake_move move)
+{
+	if (!state->alive || !state->length) {
+		return 0;
+	}
+	m_snake_move direction = move == SNAKE_MOVE_EMPTY ? (m_snake_move)state->direction : move;
+	s_coordinates offset = s_get_move_offset(direction);
+	uint16_t head = gs_head(state);
+	int x = head % state->width + offset.x;
+	int y = head / state->width + offset.y;
+	uint32_t cell = (uint32_t)(y * state->width + x);
+	state->ticks++;
+	if (x < 1 || y < 1 || x > state->width - 2 || y > state->height - 2
+	    || gs_taken(state, cell)) {
+		state->alive = 0;
+		gs_pop(state);
+		return 0;
+	}
+	state->direction = (uint8_t)direction;
+	gs_push(state, (uint16_t)cell);
+	if (cell == state->food) {
+		state->score++;
+		gs_generate_food(state);
+	} else {
+		gs_pop(state);
+	}
+	return 1;
+}
+
+size_t gs_pack(const game_state *const state, void *const buffer, const size_t size)
+{
+	size_t total = sizeof(struct gs_packed) + state->length * sizeof(uint16_t);
+	if (!buffer || size < total) {
+		return 0;
+	}
+	gs_packed packed = { 0 };
+	packed.ticks = state->ticks;
+	packed.random = state->random;
+	packed.hash = state->hash;
+	packed.score = state->score;
+	packed.length = state->length;
+	packed.food = state->food;
+	packed.direction = state->direction;
+	packed.alive = state->alive;
+	memcpy(buffer, &packed, sizeof(packed));
+	/* The ring wraps at most once, the body goes out in at most two copies */
+	uint16_t *body = (uint16_t *)((char *)buffer + sizeof(packed));
+	uint32_t first = state->capacity - state->tail;
+	first = first < state->length ? first : state->length;
+	memcpy(body, gs_body_const(state) + state->tail, first * sizeof(uint16_t));
+	memcpy(body + first, gs_body_const(state), (state->length - first) * sizeof(uint16_t));
+	return total;
+}
+
+short gs_unpack(game_state *const state, const void *const buffer, const size_t size,
+		const uint64_t *const walls)
+{
+	gs_packed packed;
+	if (!state || !buffer || size < sizeof(packed)) {
+		return 0;
+	}
+	memcpy(&packed, buffer, sizeof(packed));
+	uint32_t cells = (uint32_t)state->width * state->height;
+	if (packed.length > state->capacity
+	    || size != sizeof(packed) + packed.length * sizeof(uint16_t) || packed.food >= cells
+	    || packed.direction < SNAKE_MOVE_UP || packed.direction > SNAKE_MOVE_LEFT
+	    || packed.alive > 1) {
+		return 0;
+	}
+	const uint16_t *body = (const uint16_t *)((const char *)buffer + sizeof(packed));
+	for (uint32_t i = 0; i < packed.length; i++) {
+		if (body[i] >= cells) {
+			return 0;
+		}
+	}
+	state->walled = walls != NULL;
+	if (walls) {
+		memcpy(gs_bitmap(state), walls, state->bitmap_words * sizeof(uint64_t));
+	} else {
+		memset(gs_bitmap(state), 0, state->bitmap_words * sizeof(uint64_t));
+	}
+	memcpy(gs_body(state), body, packed.length * sizeof(uint16_t));
+	for (uint32_t i = 0; i < packed.length; i++) {
+		gs_bitmap(state)[body[i] >> 6] |= 1ULL << (body[i] & 63);
+	}
+	state->tail = 0;
+	state->length = packed.length;
+	state->score = packed.score;
+	state->ticks = packed.ticks;
+	state->random = packed.random;
+	state->hash = packed.hash;
+	state->food = packed.food;
+	state->direction = packed.direction;
+	state->alive = packed.alive;
+	return 1;
+}
+
+void gs_walls(const game_state *const state, uint64_t *const walls)
+{
+	if (!state || !walls) {
+		return;
+	}
+	memcpy(walls, state->data, state->bitmap_words * sizeof(uint64_t));
+	const uint16_t *body = gs_body_const(state);
+	for (uint32_t i = 0; i < state->length; i++) {
+		uint16_t cell = body[(state->tail + i) % state->capacity];
+		walls[cell >> 6] &= ~(1ULL << (cell & 63));
+	}
+}
+
+size_t gs_packed_size(const int width, const int height)
+{
+	if (!gs_size(width, height)) {
+		return 0;
+	}
+	return sizeof(struct gs_packed)
+	       + (size_t)(width - 2) * (size_t)(height - 2) * sizeof(uint16_t);
+}
+
+uint16_t gs_head(const game_state *const state)
+{
+	return gs_body_const(state)[(state->tail + state->length - 1) % state->capacity];
+}
+
+uint16_t gs_tail(const game_state *const state)
+{
+	return gs_body_const(state)[state->tail];
+}
+
+short gs_taken(const game_state *const state, const uint32_t cell)
+{
+	return (short)((state->data[cell >> 6] >> (cell & 63)) & 1);
+}
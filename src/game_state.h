@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __GAME_STATE_H__
+#define __GAME_STATE_H__
+
+#include "monitor.h"
+#include "snake.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Cells are stored as 16 bit indices, larger boards can not be copied into a game state
+ */
+#define GAME_STATE_MAX_CELLS 65536
+
+/*
+ * Flat copy of a single snake game without pointers, so it can be copied with memcpy
+ * and used at any address.
+ * Header is followed by a bitmap of cells taken by the snake, one bit per board cell,
+ * and by the body ring of cell indices (y * width + x) from the tail to the head.
+ * Ring capacity is the number of cells inside the walls, size covers all of it.
+ * Hash is the Zobrist hash of body, head and food, equal to the hash of the snake it was taken from.
+ * Walled is 1 when the snake played on a map, the bitmap then holds its walls as taken cells.
+ * Of a snake with a food set only the food placed last is kept, hash still covers all of them
+ */
+typedef struct game_state {
+	uint32_t size;
+	uint16_t width;
+	uint16_t height;
+	uint32_t capacity;
+	uint32_t tail;
+	uint32_t length;
+	uint32_t score;
+	uint64_t ticks;
+	uint64_t random;
+	uint64_t hash;
+	uint16_t food;
+	uint8_t direction;
+	uint8_t alive;
+	uint32_t bitmap_words;
+	uint32_t walled;
+	uint64_t data[];
+} game_state;
+
+/*
+ * Fixed part of a packed game state, followed by the length body cells from the tail to the head.
+ * The bitmap is not packed, it is rebuilt from the body and the walls
+ */
+typedef struct gs_packed {
+	uint64_t ticks;
+	uint64_t random;
+	uint64_t hash;
+	uint32_t score;
+	uint32_t length;
+	uint16_t food;
+	uint8_t direction;
+	uint8_t alive;
+	uint32_t reserved;
+} gs_packed;
+
+/*
+ * RETURNS: size in bytes of a game state for given board, 0 if the board is too large
+ */
+size_t gs_size(const int width, const int height);
+
+/*
+ * Creates a game state for given board size
+ * \RETURNS: pointer to the state, NULL on failure
+ */
+game_state *gs_malloc(const int width, const int height);
+
+/*
+ * Frees given game state
+ */
+void gs_free(game_state **state);
+
+/*
+ * Copies the game of snake into state, monitor gives the direction and whether the snake is alive.
+ * Monitor has to be locked if other threads use it
+ * \RETURNS: 1 on success, 0 if the state was created for a different board size
+ */
+short gs_snapshot(game_state *const state, const snake *const snake, const monitor *const monitor);
+
+/*
+ * Replaces the game of snake and its board cells with state, queued moves of monitor are dropped.
+ * A snake with a food set gets back only the food the state kept
+ * \RETURNS: 1 on success, 0 if the state was created for a different board size
+ */
+short gs_restore(const game_state *const state, snake *const snake, monitor *const monitor);
+
+/*
+ * Copies source into destination, both created for the same board size
+ */
+void gs_clone(game_state *const destination, const game_state *const source);
+
+/*
+ * Packs state into buffer, equal states pack into equal bytes
+ * \RETURNS: number of bytes written, 0 if buffer is too small
+ */
+size_t gs_pack(const game_state *const state, void *const buffer, const size_t size);
+
+/*
+ * Replaces state with the packed state in buffer of given size, walls is the bitmap of the walls
+ * of the map the game was played on or NULL
+ * \RETURNS: 1 on success, 0 if buffer does not hold a valid state for the board of state
+ */
+short gs_unpack(game_state *const state, const void *const buffer, const size_t size,
+		const uint64_t *const walls);
+
+/*
+ * Copies the cells of state taken by walls into walls, a bitmap of bitmap_words words
+ */
+void gs_walls(const game_state *const state, uint64_t *const walls);
+
+/*
+ * RETURNS: size in bytes of the largest packed state of a board of given size
+ */
+size_t gs_packed_size(const int width, const int height);
+
+/*
+ * Plays one tick the way s_handle_move and s_advance do, empty move keeps the direction
+ * \RETURNS: 1 if the snake is alive after the tick, 0 otherwise
+ */
+short gs_step(game_state *const state, const m_snake_move move);
+
+/*
+ * RETURNS: cell index of the snake head, the state must hold at least one cell
+ */
+uint16_t gs_head(const game_state *const state);
+
+/*
+ * RETURNS: cell index of the snake tail, the state must hold at least one cell
+ */
+uint16_t gs_tail(const game_state *const state);
+
+/*
+ * RETURNS: 1 if the snake takes cell of given index, 0 otherwise
+ */
+short gs_taken(const game_state *const state, const uint32_t cell);
+
+#endif
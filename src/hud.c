@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "hud.h"
+#include "timing_wheel.h"
+#include "usage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Number of fields in the HUD line
+ */
+#define HUD_FIELDS 6
+
+hud *h_malloc(void)
+{
+	hud *hud = NULL;
+	if (posix_memalign((void **)&hud, MONITOR_CACHE_LINE, sizeof(struct hud)) != 0) {
+		perror("ERROR: HUD allocation failed\n");
+		return NULL;
+	}
+	memset(hud, 0, sizeof(struct hud));
+	return hud;
+}
+
+void h_free(hud **hud)
+{
+	if (!hud || !*hud) {
+		return;
+	}
+	free(*hud);
+	*hud = NULL;
+}
+
+void h_record_tick(hud *const hud, const uint64_t duration, const uint64_t body_length,
+		   const uint64_t body_capacity)
+{
+	if (!hud) {
+		return;
+	}
+	uint64_t count = hud->tick_count;
+	__atomic_store_n(&hud->ticks[count % HUD_TICKS], duration, __ATOMIC_RELAXED);
+	__atomic_store_n(&hud->body_length, body_length, __ATOMIC_RELAXED);
+	__atomic_store_n(&hud->body_capacity, body_capacity, __ATOMIC_RELAXED);
+	__atomic_store_n(&hud->tick_count, count + 1, __ATOMIC_RELEASE);
+}
+
+void h_record_render(hud *const hud, const uint64_t render, const uint64_t flush)
+{
+	if (!hud) {
+		return;
+	}
+	__atomic_store_n(&hud->render, render, __ATOMIC_RELAXED);
+	__atomic_store_n(&hud->flush, flush, __ATOMIC_RELAXED);
+}
+
+/*
+ * Compares tick durations for qsort
+ */
+static int h_compare(const void *a, const void *b)
+{
+	uint64_t first = *(const uint64_t *)a;
+	uint64_t second = *(const uint64_t *)b;
+	return (first > second) - (first < second);
+}
+
+/*
+ * Appends a field to the line if all of it fits, the line stops at the first field that does not
+ * \RETURNS: 1 if the field was appended, 0 otherwise
+ */
+static short h_append(char *const buffer, const size_t size, size_t *const length,
+		      const char *const field)
+{
+	size_t separator = *length > 0;
+	size_t field_length = strlen(field);
+	if (*length + separator + field_length >= size) {
+		return 0;
+	}
+	if (separator) {
+		buffer[(*length)++] = ' ';
+	}
+	memcpy(buffer + *length, field, field_length + 1);
+	*length += field_length;
+	return 1;
+}
+
+short h_format(hud *const hud, char *const buffer, const size_t size,
+	       const unsigned int input_depth)
+{
+	if (!hud || !buffer || size == 0) {
+		return 0;
+	}
+	uint64_t now = tw_now();
+	if (hud->shown && now - hud->updated < HUD_INTERVAL) {
+		return 0;
+	}
+	hud->updated = now;
+	hud->shown = 1;
+	/* Reading /proc is too slow for every frame, it is throttled along with the line */
+	hud->resident = u_resident();
+
+	uint64_t count = __atomic_load_n(&hud->tick_count, __ATOMIC_ACQUIRE);
+	size_t samples = count < HUD_TICKS ? (size_t)count : HUD_TICKS;
+	uint64_t ticks[HUD_TICKS];
+	for (size_t i = 0; i < samples; i++) {
+		ticks[i] = __atomic_load_n(&hud->ticks[i], __ATOMIC_RELAXED);
+	}
+	uint64_t last = samples ? __atomic_load_n(&hud->ticks[(count - 1) % HUD_TICKS],
+						  __ATOMIC_RELAXED)
+				: 0;
+	qsort(ticks, samples, sizeof(uint64_t), h_compare);
+	uint64_t p50 = samples ? ticks[samples / 2] : 0;
+	uint64_t p99 = samples ? ticks[samples - 1 - samples / 100] : 0;
+
+	char fields[HUD_FIELDS][48];
+	snprintf(fields[0], sizeof(fields[0]), "t %.1f/%.1f/%.1fus", (double)last / 1e3,
+		 (double)p50 / 1e3, (double)p99 / 1e3);
+	snprintf(fields[1], sizeof(fields[1]), "r %.1f",
+		 (double)__atomic_load_n(&hud->render, __ATOMIC_RELAXED) / 1e3);
+	snprintf(fields[2], sizeof(fields[2]), "f %.1f",
+		 (double)__atomic_load_n(&hud->flush, __ATOMIC_RELAXED) / 1e3);
+	snprintf(fields[3], sizeof(fields[3]), "q%u", input_depth);
+	snprintf(fields[4], sizeof(fields[4]), "b %llu/%llu",
+		 (unsigned long long)__atomic_load_n(&hud->body_length, __ATOMIC_RELAXED),
+		 (unsigned long long)__atomic_load_n(&hud->body_capacity, __ATOMIC_RELAXED));
+	snprintf(fields[5], sizeof(fields[5]), "%.1fM", (double)hud->resident / (1024.0 * 1024.0));
+
+	size_t length = 0;
+	buffer[0] = '\0';
+	for (size_t i = 0; i < HUD_FIELDS; i++) {
+		if (!h_append(buffer, size, &length, fields[i])) {
+			break;
+		}
+	}
+	return 1;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __HUD_H__
+#define __HUD_H__
+
+#include "monitor.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Number of most recent tick durations percentiles are taken from
+ */
+#define HUD_TICKS 128
+
+/*
+ * Minimum time between two HUD updates in nanoseconds
+ */
+#define HUD_INTERVAL 250000000
+
+/*
+ * Performance counters shown in the status window.
+ * Every group is written by a single thread with relaxed atomic stores and read by the
+ * windows thread without locking, groups sit on separate cache lines
+ */
+typedef struct hud {
+	/* Written by the game thread */
+	uint64_t ticks[HUD_TICKS];
+	uint64_t tick_count;
+	uint64_t body_length;
+	uint64_t body_capacity;
+	/* Written by the windows thread */
+	uint64_t render __attribute__((aligned(MONITOR_CACHE_LINE)));
+	uint64_t flush;
+	uint64_t updated;
+	size_t resident;
+	short shown;
+} hud;
+
+/*
+ * Creates new HUD with all counters zeroed
+ * \RETURNS: pointer to the newly created HUD, NULL on failure
+ */
+hud *h_malloc(void);
+
+/*
+ * Frees the given HUD
+ */
+void h_free(hud **hud);
+
+/*
+ * Records duration of a tick and the body size after it, does nothing if hud is NULL
+ */
+void h_record_tick(hud *const hud, const uint64_t duration, const uint64_t body_length,
+		   const uint64_t body_capacity);
+
+/*
+ * Records how long the windows thread drew a frame and flushed it to the terminal
+ */
+void h_record_render(hud *const hud, const uint64_t render, const uint64_t flush);
+
+/*
+ * Formats the HUD line if the previous one is older than HUD_INTERVAL or was never shown.
+ * Input depth is the number of moves queued for the game thread.
+ * The line ends at the last whole field that fits size, including the terminating null
+ * \RETURNS: 1 if buffer was filled, 0 otherwise
+ */
+short h_format(hud *const hud, char *const buffer, const size_t size,
+	       const unsigned int input_depth);
+
+#endif
@@ -21,6 +21,7 @@
  */
 
 #include "input.h"
+#include "trace.h"
 #include <ncurses.h>
 
 void i_handle_input(monitor *const monitor)
@@ -28,22 +29,28 @@ void i_handle_input(monitor *const monitor)
 	int exit_received = 0;
 	while (!exit_received) {
 		int value = getch();
-		pthread_mutex_lock(&(monitor->mutex));
+		TRACE_BEGIN(lock);
+		m_lock(monitor, __func__);
+		TRACE_END(lock, "i_handle_input lock wait");
 		if (i_handle_received_key(monitor, value)) {
-			pthread_mutex_unlock(&(monitor->mutex));
 			exit_received = 1;
 		}
-		pthread_mutex_unlock(&(monitor->mutex));
+		m_unlock(monitor);
 	}
 }
 
 short i_handle_received_key(monitor *const monitor, const int value)
 {
+	TRACE_SCOPE("i_handle_received_key");
 	switch (value) {
 	case (int)'q':
 	case (int)'Q':
 		i_handle_exit(monitor);
 		return 1;
+	case (int)'p':
+	case (int)'P':
+		monitor->hud_visible = !monitor->hud_visible;
+		return 0;
 	case KEY_UP:
 		i_handle_snake_move(monitor, SNAKE_MOVE_UP, SNAKE_MOVE_DOWN);
 		return 0;
@@ -61,6 +68,22 @@ short i_handle_received_key(monitor *const monitor, const int value)
 	}
 }
 
+enum m_snake_move i_key_to_move(const int value)
+{
+	switch (value) {
+	case KEY_UP:
+		return SNAKE_MOVE_UP;
+	case KEY_DOWN:
+		return SNAKE_MOVE_DOWN;
+	case KEY_RIGHT:
+		return SNAKE_MOVE_RIGHT;
+	case KEY_LEFT:
+		return SNAKE_MOVE_LEFT;
+	default:
+		return SNAKE_MOVE_EMPTY;
+	}
+}
+
 void i_handle_exit(monitor *const monitor)
 {
 	if (!monitor) {
@@ -68,7 +91,8 @@ void i_handle_exit(monitor *const monitor)
 	}
 	monitor->signal_snake = SIGNAL_SNAKE_GAME_EXIT;
 	monitor->signal_windows = SIGNAL_WINDOWS_GAME_EXIT;
-	pthread_cond_signal(&(monitor->conditional));
+	m_signal(&monitor->snake_event, __func__);
+	m_signal(&monitor->windows_event, __func__);
 }
 
 void i_handle_snake_move(monitor *const monitor, const enum m_snake_move next_move,
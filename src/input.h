@@ -33,6 +33,12 @@ void i_handle_input(monitor *const monitor);
  */
 short i_handle_received_key(monitor *const monitor, const int value);
 
+/*
+ * Maps arrow key to the snake move
+ * \RETURNS: move for the key, SNAKE_MOVE_EMPTY if key is not an arrow key
+ */
+enum m_snake_move i_key_to_move(const int value);
+
 /*
  * Handles game exit
  */
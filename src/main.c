@@ -20,14 +20,173 @@
  * SOFTWARE.
  */
 
+#include "board.h"
+#include "client.h"
+#include "allocator.h"
+#include "event_log.h"
+#include "map.h"
+#include "mcts.h"
 #include "monitor.h"
+#include "replay.h"
+#include "session.h"
 #include "snake.h"
 #include "threads.h"
+#include "trace.h"
+#include "usage.h"
 #include "windows.h"
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
-int main(void)
+/*
+ * Memory locking flags, every page is faulted in up front so ticks never take a first touch fault.
+ * The sanitizer reserves terabytes of shadow, which can only be locked as it is touched
+ */
+#ifdef __SANITIZE_ADDRESS__
+#define MAIN_LOCK_FLAGS (MCL_CURRENT | MCL_FUTURE | MCL_ONFAULT)
+#else
+#define MAIN_LOCK_FLAGS (MCL_CURRENT | MCL_FUTURE)
+#endif
+
+int main(int argc, char *argv[])
 {
+	const char *server_path = NULL;
+	const char *spectator_path = NULL;
+	int spectator_fd = -1;
+	short loop = 0;
+	short report = 0;
+	const char *trace_path = "snake-trace.json";
+	const char *log_path = NULL;
+	short lock_memory = 0;
+	long bot_workers = 0;
+	short compact = 0;
+	long food = 0;
+	const char *replay_path = NULL;
+	const char *map_path = NULL;
+	map *map = NULL;
+	mcts *bot = NULL;
+	t_options options;
+	t_options_initialize(&options);
+	int option;
+	while ((option = getopt(argc, argv, "c:s:f:e:ST:L:P:F:MA:Cm:n:R:")) != -1) {
+		switch (option) {
+		case 'c':
+			server_path = optarg;
+			break;
+		case 's':
+			spectator_path = optarg;
+			break;
+		case 'f':
+			spectator_fd = atoi(optarg);
+			break;
+		case 'e':
+			if (strcmp(optarg, "loop") != 0 && strcmp(optarg, "threads") != 0) {
+				fprintf(stderr, "ERROR: execution mode has to be loop or threads\n");
+				return EXIT_FAILURE;
+			}
+			loop = strcmp(optarg, "loop") == 0;
+			break;
+		case 'S':
+			report = 1;
+			break;
+		case 'T':
+			trace_path = optarg;
+			break;
+		case 'L':
+			log_path = optarg;
+			break;
+		case 'P':
+			if (!t_options_parse_cpus(&options, optarg)) {
+				fprintf(stderr, "ERROR: CPUs have to be game,input,windows CPUs"
+						" this process may run on\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'F':
+			options.priority = atoi(optarg);
+			if (options.priority < sched_get_priority_min(SCHED_FIFO)
+			    || options.priority > sched_get_priority_max(SCHED_FIFO)) {
+				fprintf(stderr, "ERROR: SCHED_FIFO priority is out of range\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'M':
+			lock_memory = 1;
+			break;
+		case 'A':
+			bot_workers = atol(optarg);
+			if (bot_workers < 1) {
+				fprintf(stderr, "ERROR: bot needs at least one thread\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'C':
+			compact = 1;
+			break;
+		case 'm':
+			map_path = optarg;
+			break;
+		case 'n':
+			food = atol(optarg);
+			if (food < 1) {
+				fprintf(stderr, "ERROR: there has to be at least one food item\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'R':
+			replay_path = optarg;
+			break;
+		default:
+			fprintf(stderr,
+				"Usage: %s [-c socket] [-s spectator socket] [-f spectator fd]"
+				" [-e threads|loop] [-S] [-T trace file] [-L event log]"
+				" [-P game,input,windows CPUs] [-F priority] [-M] [-A bot threads]"
+				" [-C] [-m map] [-n food items] [-R replay]\n",
+				argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (replay_path && food) {
+		fprintf(stderr, "ERROR: games with more than one food can not be recorded\n");
+		return EXIT_FAILURE;
+	}
+	/* Loaded before ncurses starts, so errors about the file can still be read */
+	if (map_path && !server_path) {
+		map = mp_load(map_path);
+		if (!map) {
+			return EXIT_FAILURE;
+		}
+	}
+	usage before, after;
+	unsigned long ticks = 0;
+	u_jitter jitter = { 0 };
+	/* Errors found while ncurses owns the screen are printed once it is finalized */
+	char error[128] = "";
+	int status = 0;
+
+	if (lock_memory && mlockall(MAIN_LOCK_FLAGS) != 0) {
+		perror("WARNING: mlockall failed, memory is not locked");
+	}
+
+	int server_fd = -1;
+	if (server_path) {
+		server_fd = c_connect(server_path);
+		if (server_fd < 0) {
+			return EXIT_FAILURE;
+		}
+	}
+
+	TRACE_INITIALIZE(trace_path);
+	if (log_path && !el_initialize(log_path)) {
+		if (server_fd >= 0) {
+			close(server_fd);
+		}
+		TRACE_FINALIZE();
+		mp_free(&map);
+		return EXIT_FAILURE;
+	}
 	w_ncurses_initialize();
 
 	struct timespec time;
@@ -36,15 +195,112 @@ int main(void)
 
 	windows *windows = w_malloc();
 	if (!windows) {
+		if (server_fd >= 0) {
+			close(server_fd);
+		}
 		goto main_finalize_ncurses;
 	}
 	w_initialize(windows);
+	if (server_fd >= 0) {
+		c_run(windows, server_fd);
+		goto main_finalize_windows;
+	}
+
+	windows->hud = h_malloc();
+
+	if (spectator_path || spectator_fd >= 0) {
+		windows->spectator = sp_malloc();
+		if (!windows->spectator) {
+			goto main_finalize_windows;
+		}
+		if (spectator_path && !sp_listen(windows->spectator, spectator_path)) {
+			goto main_finalize_windows;
+		}
+		if (spectator_fd >= 0 && !sp_subscribe(windows->spectator, spectator_fd)) {
+			goto main_finalize_windows;
+		}
+	}
+
+	int y_max, x_max;
+	getmaxyx(windows->game, y_max, x_max);
+	if (map) {
+		if (map->width > x_max || map->height > y_max) {
+			snprintf(error, sizeof(error),
+				 "ERROR: map of %dx%d does not fit the window of %dx%d\n", map->width,
+				 map->height, x_max, y_max);
+			status = EXIT_FAILURE;
+			goto main_finalize_windows;
+		}
+		x_max = map->width;
+		y_max = map->height;
+		w_map_display(windows, map);
+	}
+	if (food > (long)(x_max - 2) * (y_max - 2)) {
+		snprintf(error, sizeof(error), "ERROR: %ld food items do not fit the board of %dx%d\n",
+			 food, x_max, y_max);
+		status = EXIT_FAILURE;
+		goto main_finalize_windows;
+	}
+	if (bot_workers) {
+		bot = mc_malloc(x_max, y_max, (size_t)bot_workers, MCTS_PLAYOUTS, MCTS_TABLE_BITS);
+		if (!bot) {
+			goto main_finalize_windows;
+		}
+	}
+	if (loop) {
+		session *session = se_malloc(x_max, y_max);
+		if (!session) {
+			goto main_finalize_windows;
+		}
+		b_use_map(session->board, map);
+		if ((compact && !s_use_compact_body(session->snake))
+		    || (food && !s_use_food_set(session->snake, session->board, (uint32_t)food))) {
+			se_free(&session);
+			goto main_finalize_windows;
+		}
+		se_initialize(session, windows);
+		session->snake->bot = bot;
+		if (replay_path) {
+			session->snake->recorder =
+				rp_open(replay_path, session->snake, REPLAY_INTERVAL);
+			if (!session->snake->recorder) {
+				se_free(&session);
+				goto main_finalize_windows;
+			}
+		}
+		t_apply_options(&options, THREAD_GAME);
+		u_sample(&before);
+		se_run_interactive(session);
+		u_sample(&after);
+		ticks = session->ticks;
+		jitter = session->snake->jitter;
+		rp_close(&session->snake->recorder);
+		se_free(&session);
+		goto main_finalize_windows;
+	}
+	board *board = b_malloc(x_max, y_max);
+	if (!board) {
+		goto main_finalize_windows;
+	}
+	b_use_map(board, map);
 
 	snake *snake = s_malloc();
 	if (!snake) {
-		goto main_finalize_windows;
+		goto main_finalize_board;
+	}
+	if ((compact && !s_use_compact_body(snake))
+	    || (food && !s_use_food_set(snake, board, (uint32_t)food))) {
+		goto main_finalize_snake;
+	}
+	s_initialize(snake, board);
+	snake->hud = windows->hud;
+	snake->bot = bot;
+	if (replay_path) {
+		snake->recorder = rp_open(replay_path, snake, REPLAY_INTERVAL);
+		if (!snake->recorder) {
+			goto main_finalize_snake;
+		}
 	}
-	s_initialize(snake, windows->game);
 
 	monitor *monitor = m_malloc();
 	if (!monitor) {
@@ -53,15 +309,38 @@ int main(void)
 	m_initialize(monitor);
 
 	pthread_t threads[THREAD_TYPE_COUNT];
-	t_initialize_threads(threads, monitor, snake, windows);
+	u_sample(&before);
+	t_initialize_threads(threads, monitor, snake, windows, &options);
 	t_finalize_threads(threads);
+	u_sample(&after);
+	ticks = snake->ticks;
+	jitter = snake->jitter;
 
+	sp_frame_release(monitor->keyframe);
 	m_free(&monitor);
 main_finalize_snake:
+	rp_close(&snake->recorder);
 	s_free(&snake);
+main_finalize_board:
+	b_free(&board);
 main_finalize_windows:
+	sp_free(&windows->spectator);
 	w_free(&windows);
 main_finalize_ncurses:
 	w_ncurses_finalize();
-	return 0;
+	fputs(error, stderr);
+	TRACE_FINALIZE();
+	el_finalize();
+	if (report && ticks > 0) {
+		u_report(stderr, loop ? "loop" : "threads", &before, &after, ticks);
+		u_jitter_report(stderr, "game thread", &jitter);
+		t_options_report(&options, stderr);
+		a_report(stderr);
+		m_profile_report(stderr);
+		el_report(stderr);
+		mc_report(bot, stderr);
+	}
+	mc_free(&bot);
+	mp_free(&map);
+	return status;
 }
@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "map.h"
+#include "allocator.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * RETURNS: number of 64-bit words of a bitmap covering every cell of the map
+ */
+static uint32_t mp_bitmap_words(const int width, const int height)
+{
+	return (uint32_t)(((size_t)width * (size_t)height + 63) / 64);
+}
+
+/*
+ * Computes the distance of every cell to the nearest wall in two sweeps, the first one
+ * down and right from the walls above and to the left, the second one up and left
+ */
+static void mp_compute_distance(const uint64_t *const walls, const int width, const int height,
+				uint16_t *const distance)
+{
+	memset(distance, 0, (size_t)width * sizeof(uint16_t));
+	memset(distance + (size_t)(height - 1) * (size_t)width, 0, (size_t)width * sizeof(uint16_t));
+	for (int y = 1; y < height - 1; y++) {
+		uint16_t *row = distance + (size_t)y * (size_t)width;
+		const uint16_t *above = row - width;
+		size_t cell = (size_t)y * (size_t)width + 1;
+		row[0] = 0;
+		row[width - 1] = 0;
+		for (int x = 1; x < width - 1; x++, cell++) {
+			if ((walls[cell >> 6] >> (cell & 63)) & 1) {
+				row[x] = 0;
+				continue;
+			}
+			uint16_t up = above[x];
+			uint16_t left = row[x - 1];
+			row[x] = (uint16_t)((up < left ? up : left) + 1);
+		}
+	}
+	for (int y = height - 2; y > 0; y--) {
+		uint16_t *row = distance + (size_t)y * (size_t)width;
+		const uint16_t *below = row + width;
+		for (int x = width - 2; x > 0; x--) {
+			uint16_t down = (uint16_t)(below[x] + 1);
+			uint16_t right = (uint16_t)(row[x + 1] + 1);
+			uint16_t nearest = down < right ? down : right;
+			if (nearest < row[x]) {
+				row[x] = nearest;
+			}
+		}
+	}
+}
+
+/*
+ * Checks that every border cell is a wall in the bitmap and has distance 0, the board blocks
+ * cells by their distance while simulations look at the bitmap, so both have to agree there.
+ * Offsets of the header have to be checked against the mapping first
+ * \RETURNS: 1 if the border is closed, 0 otherwise
+ */
+static short mp_border_valid(const mp_header *const header)
+{
+	const uint64_t *walls = (const uint64_t *)((const char *)header + header->walls);
+	const uint16_t *distance = (const uint16_t *)((const char *)header + header->distance);
+	size_t width = (size_t)header->width;
+	size_t height = (size_t)header->height;
+	for (size_t y = 0; y < height; y++) {
+		size_t step = y == 0 || y == height - 1 ? 1 : width - 1;
+		for (size_t x = 0; x < width; x += step) {
+			size_t cell = y * width + x;
+			if (distance[cell] != 0 || !((walls[cell >> 6] >> (cell & 63)) & 1)) {
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+map *mp_load(const char *const path)
+{
+	if (!path) {
+		return NULL;
+	}
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		perror("ERROR: map open failed\n");
+		return NULL;
+	}
+	struct stat status;
+	if (fstat(fd, &status) != 0 || (size_t)status.st_size < sizeof(struct mp_header)) {
+		fprintf(stderr, "ERROR: %s is not a map\n", path);
+		close(fd);
+		return NULL;
+	}
+	size_t size = (size_t)status.st_size;
+	const mp_header *header = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (header == MAP_FAILED) {
+		perror("ERROR: map mmap failed\n");
+		return NULL;
+	}
+	size_t cells = (size_t)header->width * (size_t)header->height;
+	size_t bitmap_size = (size_t)header->bitmap_words * sizeof(uint64_t);
+	/* Offsets come from the file, they are compared before being added so nothing wraps */
+	if (memcmp(header->magic, MAP_MAGIC, sizeof(header->magic)) != 0
+	    || header->version != MAP_VERSION || header->size != size || header->width < 3
+	    || header->height < 3 || header->width > MAP_MAX_SIDE || header->height > MAP_MAX_SIDE
+	    || header->bitmap_words != mp_bitmap_words(header->width, header->height)
+	    || header->walls % sizeof(uint64_t) != 0 || header->walls < sizeof(struct mp_header)
+	    || header->walls > size || bitmap_size > size - header->walls
+	    || header->distance % sizeof(uint16_t) != 0
+	    || header->distance < header->walls + bitmap_size || header->distance > size
+	    || cells * sizeof(uint16_t) > size - header->distance
+	    || !mp_border_valid(header)) {
+		fprintf(stderr, "ERROR: %s is not a map of version %d\n", path, MAP_VERSION);
+		munmap((void *)header, size);
+		return NULL;
+	}
+
+	map *map = a_malloc(ALLOCATOR_TAG_MAP, sizeof(struct map));
+	if (!map) {
+		perror("ERROR: map malloc failed\n");
+		munmap((void *)header, size);
+		return NULL;
+	}
+	map->width = header->width;
+	map->height = header->height;
+	map->spawn_x = header->spawn_x;
+	map->spawn_y = header->spawn_y;
+	map->bitmap_words = header->bitmap_words;
+	map->size = size;
+	map->header = header;
+	map->walls = (const uint64_t *)((const char *)header + header->walls);
+	map->distance = (const uint16_t *)((const char *)header + header->distance);
+	if (mp_is_wall(map, map->spawn_x, map->spawn_y)) {
+		fprintf(stderr, "ERROR: spawn of %s is on a wall\n", path);
+		mp_free(&map);
+		return NULL;
+	}
+	return map;
+}
+
+void mp_free(map **map)
+{
+	if (!map || !*map) {
+		return;
+	}
+	munmap((void *)(*map)->header, (*map)->size);
+	a_free(ALLOCATOR_TAG_MAP, *map, sizeof(struct map));
+	*map = NULL;
+}
+
+short mp_write(const char *const path, const int width, const int height, const int spawn_x,
+	       const int spawn_y, const uint64_t *const walls)
+{
+	if (!path || !walls || width < 3 || height < 3 || width > MAP_MAX_SIDE
+	    || height > MAP_MAX_SIDE) {
+		return 0;
+	}
+	size_t cells = (size_t)width * (size_t)height;
+	uint16_t *distance = a_malloc(ALLOCATOR_TAG_MAP, cells * sizeof(uint16_t));
+	if (!distance) {
+		perror("ERROR: map distance malloc failed\n");
+		return 0;
+	}
+	mp_compute_distance(walls, width, height, distance);
+
+	mp_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAP_MAGIC, sizeof(header.magic));
+	header.version = MAP_VERSION;
+	header.width = width;
+	header.height = height;
+	header.spawn_x = spawn_x;
+	header.spawn_y = spawn_y;
+	header.bitmap_words = mp_bitmap_words(width, height);
+	header.walls = sizeof(struct mp_header);
+	header.distance = header.walls + header.bitmap_words * sizeof(uint64_t);
+	header.size = header.distance + cells * sizeof(uint16_t);
+
+	short written = 0;
+	FILE *file = fopen(path, "wb");
+	if (!file) {
+		perror("ERROR: map open failed\n");
+		goto mp_write_free;
+	}
+	written = fwrite(&header, sizeof(header), 1, file) == 1
+		  && fwrite(walls, sizeof(uint64_t), header.bitmap_words, file)
+			     == header.bitmap_words
+		  && fwrite(distance, sizeof(uint16_t), cells, file) == cells;
+	if (fclose(file) != 0 || !written) {
+		perror("ERROR: map write failed\n");
+		written = 0;
+	}
+
+mp_write_free:
+	a_free(ALLOCATOR_TAG_MAP, distance, cells * sizeof(uint16_t));
+	return written;
+}
+
+short mp_import(const char *const text_path, const char *const map_path)
+{
+	FILE *file = fopen(text_path, "r");
+	if (!file) {
+		perror("ERROR: text map open failed\n");
+		return 0;
+	}
+	short status = 0;
+	uint64_t *walls = NULL;
+	size_t words = 0;
+	char *line = NULL;
+	size_t line_size = 0;
+	ssize_t length;
+
+	/* First pass finds the size of the board, the second one sets the walls */
+	int columns = 0;
+	int rows = 0;
+	while ((length = getline(&line, &line_size, file)) >= 0) {
+		while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+			length--;
+		}
+		columns = length > columns ? (int)length : columns;
+		rows++;
+		if (columns > MAP_MAX_SIDE - 2 || rows > MAP_MAX_SIDE - 2) {
+			fprintf(stderr, "ERROR: %s is larger than %d cells\n", text_path,
+				MAP_MAX_SIDE);
+			goto mp_import_free;
+		}
+	}
+	if (!columns || !rows) {
+		fprintf(stderr, "ERROR: %s has no cells\n", text_path);
+		goto mp_import_free;
+	}
+	int width = columns + 2;
+	int height = rows + 2;
+	words = mp_bitmap_words(width, height);
+	walls = a_calloc(ALLOCATOR_TAG_MAP, words, sizeof(uint64_t));
+	if (!walls) {
+		perror("ERROR: text map walls calloc failed\n");
+		goto mp_import_free;
+	}
+	for (int x = 0; x < width; x++) {
+		size_t top = (size_t)x;
+		size_t bottom = (size_t)(height - 1) * (size_t)width + (size_t)x;
+		walls[top >> 6] |= 1ULL << (top & 63);
+		walls[bottom >> 6] |= 1ULL << (bottom & 63);
+	}
+	for (int y = 0; y < height; y++) {
+		size_t left = (size_t)y * (size_t)width;
+		size_t right = left + (size_t)width - 1;
+		walls[left >> 6] |= 1ULL << (left & 63);
+		walls[right >> 6] |= 1ULL << (right & 63);
+	}
+	int spawn_x = width / 2;
+	int spawn_y = height / 2;
+	rewind(file);
+	for (int y = 1; (length = getline(&line, &line_size, file)) >= 0; y++) {
+		for (int x = 1; x <= length; x++) {
+			if (line[x - 1] == '@') {
+				spawn_x = x;
+				spawn_y = y;
+			} else if (line[x - 1] == '#') {
+				size_t cell = (size_t)y * (size_t)width + (size_t)x;
+				walls[cell >> 6] |= 1ULL << (cell & 63);
+			}
+		}
+	}
+	status = mp_write(map_path, width, height, spawn_x, spawn_y, walls);
+
+mp_import_free:
+	a_free(ALLOCATOR_TAG_MAP, walls, words * sizeof(uint64_t));
+	free(line);
+	fclose(file);
+	return status;
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __MAP_H__
+#define __MAP_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MAP_MAGIC "SNAKEMAP"
+
+#define MAP_VERSION 1
+
+/*
+ * Longest side of a map, distances to the walls stay within 16 bits
+ */
+#define MAP_MAX_SIDE 32767
+
+/*
+ * Cells tried when food is placed on a map or among other food before it is left on a taken cell
+ */
+#define MAP_FOOD_ATTEMPTS 1024
+
+/*
+ * Start of a map file.
+ * Header is followed by the walls at offset walls from the start of the file, a bitmap of
+ * bitmap_words 64-bit words with bit y * width + x set for every wall cell, laid out like the
+ * bitmaps of game states. Cells on the border are walls whether their bits are set or not.
+ * Distance at its offset holds a 16-bit distance to the nearest wall for every cell, computed
+ * when the file is written. The snake starts at spawn, size is the size of the whole file
+ */
+typedef struct mp_header {
+	char magic[8];
+	uint32_t version;
+	int32_t width;
+	int32_t height;
+	int32_t spawn_x;
+	int32_t spawn_y;
+	uint32_t bitmap_words;
+	uint64_t walls;
+	uint64_t distance;
+	uint64_t size;
+} mp_header;
+
+/*
+ * Map file mapped into memory, walls and distance point into the mapping and are never copied.
+ * Distance is the number of steps from every cell to the nearest wall, 0 on walls and on the
+ * border, so pages of it are only read from the file once they are queried
+ */
+typedef struct map {
+	int width;
+	int height;
+	int spawn_x;
+	int spawn_y;
+	uint32_t bitmap_words;
+	size_t size;
+	const mp_header *header;
+	const uint64_t *walls;
+	const uint16_t *distance;
+} map;
+
+/*
+ * Maps the map file at path, nothing of it is read but the header and the border cells
+ * \RETURNS: pointer to the map, NULL if the file can not be read or is not a valid map
+ */
+map *mp_load(const char *const path);
+
+/*
+ * Unmaps given map
+ */
+void mp_free(map **map);
+
+/*
+ * Writes a map file of given size to path with the distances of its cells to the walls,
+ * walls is a bitmap with bit y * width + x set for every wall cell, the border included
+ * \RETURNS: 1 on success, 0 on failure
+ */
+short mp_write(const char *const path, const int width, const int height, const int spawn_x,
+	       const int spawn_y, const uint64_t *const walls);
+
+/*
+ * Converts a text map to a map file. Every line of the text is a row of the board,
+ * '#' is a wall, '@' the spawn and any other character an empty cell. The board is as wide as
+ * the longest line and gets walls around it, the spawn defaults to the middle of the board
+ * \RETURNS: 1 on success, 0 on failure
+ */
+short mp_import(const char *const text_path, const char *const map_path);
+
+/*
+ * RETURNS: steps from the cell at given coordinates to the nearest wall, 0 if it is a wall
+ * or outside of the map
+ */
+static inline uint16_t mp_distance(const map *const map, const int x, const int y)
+{
+	if (x < 0 || y < 0 || x >= map->width || y >= map->height) {
+		return 0;
+	}
+	return map->distance[(size_t)y * (size_t)map->width + (size_t)x];
+}
+
+/*
+ * RETURNS: 1 if the cell at given coordinates is a wall or outside of the map, 0 if not
+ */
+static inline short mp_is_wall(const map *const map, const int x, const int y)
+{
+	return mp_distance(map, x, y) == 0;
+}
+
+#endif
@@ -0,0 +1,491 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#define _GNU_SOURCE
+#include "mcts.h"
+#include "allocator.h"
+#include "map.h"
+#include "timing_wheel.h"
+#include <math.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const enum m_snake_move mc_moves[] = { SNAKE_MOVE_UP, SNAKE_MOVE_DOWN, SNAKE_MOVE_RIGHT,
+					      SNAKE_MOVE_LEFT };
+
+/*
+ * RETURNS: 1 if moving the snake of state in direction move keeps it alive, 0 otherwise
+ */
+static short mc_safe(const game_state *const state, const enum m_snake_move move)
+{
+	s_coordinates offset = s_get_move_offset(move);
+	uint16_t head = gs_head(state);
+	int x = head % state->width + offset.x;
+	int y = head / state->width + offset.y;
+	if (x < 1 || y < 1 || x > state->width - 2 || y > state->height - 2) {
+		return 0;
+	}
+	return !gs_taken(state, (uint32_t)(y * state->width + x));
+}
+
+/*
+ * RETURNS: Manhattan distance from the snake head to the food
+ */
+static int mc_food_distance(const game_state *const state)
+{
+	uint16_t head = gs_head(state);
+	return abs(head % state->width - state->food % state->width)
+	       + abs(head / state->width - state->food / state->width);
+}
+
+/*
+ * Picks a rollout move, three times out of four the safe move closest to the food,
+ * otherwise any safe move
+ * \RETURNS: the move, the current direction if no move is safe
+ */
+static enum m_snake_move mc_rollout_move(mc_worker *const worker, const game_state *const state)
+{
+	enum m_snake_move safe[4];
+	int count = 0;
+	for (int i = 0; i < 4; i++) {
+		if (mc_safe(state, mc_moves[i])) {
+			safe[count++] = mc_moves[i];
+		}
+	}
+	if (!count) {
+		return (enum m_snake_move)state->direction;
+	}
+	uint32_t random = s_random(&worker->random);
+	if (!(random & 3)) {
+		return safe[(random >> 2) % (uint32_t)count];
+	}
+	uint16_t head = gs_head(state);
+	int food_x = state->food % state->width;
+	int food_y = state->food / state->width;
+	const map *map = worker->mcts->map;
+	enum m_snake_move best = safe[0];
+	int distance = -1;
+	int room = 0;
+	for (int i = 0; i < count; i++) {
+		s_coordinates offset = s_get_move_offset(safe[i]);
+		int x = head % state->width + offset.x;
+		int y = head / state->width + offset.y;
+		int to_food = abs(x - food_x) + abs(y - food_y);
+		/* Equally close moves are told apart by how far they keep from the walls */
+		int to_wall = map ? mp_distance(map, x, y) : 0;
+		if (distance < 0 || to_food < distance || (to_food == distance && to_wall > room)) {
+			distance = to_food;
+			room = to_wall;
+			best = safe[i];
+		}
+	}
+	return best;
+}
+
+/*
+ * Scores a playout in range 0 to 1.
+ * Food counts by the ticks it took, or would still take by distance, beyond the shortest
+ * distance from the root, every wasted tick discounts it by MCTS_DISCOUNT.
+ * Dying scales the reward down the more the sooner it happens
+ * Eaten is the number of ticks until the first food was eaten, 0 if none was
+ */
+static float mc_reward(const game_state *const root, const game_state *const state,
+		       const uint64_t eaten)
+{
+	double ticks = (double)eaten;
+	if (!eaten) {
+		ticks = (double)(state->ticks - root->ticks)
+			+ (state->length ? mc_food_distance(state) : state->width + state->height);
+	}
+	double wasted = ticks - mc_food_distance(root);
+	double reward = 0.3 + 0.7 * pow(MCTS_DISCOUNT, wasted > 0 ? wasted : 0);
+	if (!state->alive) {
+		double survived = (double)(state->ticks - root->ticks);
+		reward *= 0.5 * (survived < MCTS_DEPTH ? survived / MCTS_DEPTH : 1.0);
+	}
+	return (float)reward;
+}
+
+/*
+ * Adds a child for every move except going back
+ */
+static void mc_expand(mc_worker *const worker, const uint32_t node,
+		      const game_state *const state)
+{
+	enum m_snake_move back = s_get_opposite_move((enum m_snake_move)state->direction);
+	uint32_t first = worker->used;
+	for (int i = 0; i < 4; i++) {
+		if (mc_moves[i] == back) {
+			continue;
+		}
+		mc_node *child = &worker->nodes[worker->used++];
+		memset(child, 0, sizeof(mc_node));
+		child->parent = node;
+		child->move = (uint8_t)mc_moves[i];
+	}
+	worker->nodes[node].children = first;
+	worker->nodes[node].count = (uint8_t)(worker->used - first);
+}
+
+/*
+ * RETURNS: child of node with the highest UCT value, unvisited children first.
+ * Mean reward of a child comes from the transposition table when it saw the position more often
+ */
+static uint32_t mc_select(mc_worker *const worker, const uint32_t node)
+{
+	const mc_node *nodes = worker->nodes;
+	const z_table *table = worker->mcts->table;
+	const mc_node *parent = &nodes[node];
+	double log_visits = log((double)parent->visits + 1.0);
+	uint32_t best = parent->children;
+	double best_value = -1.0;
+	for (uint32_t child = parent->children; child < parent->children + parent->count; child++) {
+		if (!nodes[child].visits) {
+			return child;
+		}
+		double visits = (double)nodes[child].visits;
+		double mean = nodes[child].reward / visits;
+		uint32_t shared_visits;
+		float shared_reward;
+		if (table) {
+			worker->probes++;
+			if (z_probe(table, nodes[child].hash, &shared_visits, &shared_reward)
+			    && shared_visits > nodes[child].visits) {
+				worker->hits++;
+				mean = (double)shared_reward / (double)shared_visits;
+			}
+		}
+		double value = mean + MCTS_EXPLORATION * sqrt(log_visits / visits);
+		if (value > best_value) {
+			best_value = value;
+			best = child;
+		}
+	}
+	return best;
+}
+
+/*
+ * Runs one playout: selects down the tree replaying moves on a clone of the root,
+ * expands the reached node, plays at random and propagates the reward back to the root
+ */
+static void mc_playout(mc_worker *const worker)
+{
+	mcts *mcts = worker->mcts;
+	game_state *state = worker->scratch;
+	mc_node *nodes = worker->nodes;
+	gs_clone(state, mcts->root);
+	uint32_t node = 0;
+	uint64_t eaten = 0;
+	while (!nodes[node].terminal) {
+		if (!nodes[node].children) {
+			if ((!nodes[node].visits && node) || worker->used + 4 > MCTS_POOL_NODES) {
+				break;
+			}
+			mc_expand(worker, node, state);
+		}
+		node = mc_select(worker, node);
+		if (!gs_step(state, (enum m_snake_move)nodes[node].move)) {
+			nodes[node].terminal = 1;
+		}
+		nodes[node].hash = state->hash ^ mcts->salt;
+		if (!eaten && state->score != mcts->root->score) {
+			eaten = state->ticks - mcts->root->ticks;
+		}
+	}
+	for (int depth = 0; depth < MCTS_DEPTH && state->alive; depth++) {
+		gs_step(state, mc_rollout_move(worker, state));
+		if (!eaten && state->score != mcts->root->score) {
+			eaten = state->ticks - mcts->root->ticks;
+		}
+	}
+	float reward = mc_reward(mcts->root, state, eaten);
+	while (1) {
+		nodes[node].visits++;
+		nodes[node].reward += reward;
+		if (!node) {
+			break;
+		}
+		if (mcts->table) {
+			z_update(mcts->table, nodes[node].hash, reward);
+		}
+		node = nodes[node].parent;
+	}
+}
+
+/*
+ * Runs playouts on the tree of worker until the deadline or the shared playout limit
+ */
+static void mc_worker_search(mc_worker *const worker)
+{
+	mcts *mcts = worker->mcts;
+	memset(&worker->nodes[0], 0, sizeof(mc_node));
+	worker->used = 1;
+	if (!mcts->root->alive || !mcts->root->length) {
+		return;
+	}
+	while (__atomic_sub_fetch(&mcts->remaining, 1, __ATOMIC_RELAXED) >= 0
+	       && tw_now() < mcts->deadline) {
+		mc_playout(worker);
+		worker->playouts++;
+	}
+}
+
+static void *mc_worker_thread(void *args)
+{
+	mc_worker *worker = args;
+	pthread_setname_np(pthread_self(), "mcts");
+	while (1) {
+		m_event_wait(&worker->wake, 0);
+		if (__atomic_load_n(&worker->mcts->stop, __ATOMIC_ACQUIRE)) {
+			return NULL;
+		}
+		mc_worker_search(worker);
+		if (__atomic_sub_fetch(&worker->mcts->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+			m_event_notify(&worker->mcts->done);
+		}
+	}
+}
+
+mcts *mc_malloc(const int width, const int height, const size_t workers, const long playouts,
+		const unsigned int table_bits)
+{
+	if (!workers || playouts < 1) {
+		fprintf(stderr, "ERROR: bot needs at least one worker and one playout\n");
+		return NULL;
+	}
+	mcts *mcts = a_calloc(ALLOCATOR_TAG_BOT, 1, sizeof(struct mcts));
+	if (!mcts) {
+		perror("ERROR: bot malloc failed\n");
+		return NULL;
+	}
+	mcts->count = workers;
+	mcts->playouts_limit = playouts;
+	mcts->move = SNAKE_MOVE_EMPTY;
+	mcts->root = gs_malloc(width, height);
+	mcts->free = bb_malloc(width, height);
+	mcts->reach = bb_malloc(width, height);
+	mcts->workers = a_calloc(ALLOCATOR_TAG_BOT, workers, sizeof(mc_worker));
+	if (table_bits && !(mcts->table = z_malloc(table_bits))) {
+		goto mc_malloc_failed;
+	}
+	if (!mcts->root || !mcts->free || !mcts->reach || !mcts->workers) {
+		goto mc_malloc_failed;
+	}
+	for (size_t i = 0; i < workers; i++) {
+		mc_worker *worker = &mcts->workers[i];
+		worker->mcts = mcts;
+		worker->random = (uint64_t)rand() << 32 | (uint64_t)rand() | 1;
+		worker->nodes = a_malloc(ALLOCATOR_TAG_BOT, MCTS_POOL_NODES * sizeof(mc_node));
+		worker->scratch = gs_malloc(width, height);
+		if (!worker->nodes || !worker->scratch) {
+			goto mc_malloc_failed;
+		}
+	}
+
+	/* Workers start with every signal blocked, signals stay with the threads handling them */
+	sigset_t all, previous;
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &previous);
+	for (mcts->started = 1; mcts->started < workers; mcts->started++) {
+		mc_worker *worker = &mcts->workers[mcts->started];
+		if (pthread_create(&worker->thread, NULL, mc_worker_thread, worker)) {
+			fprintf(stderr, "ERROR: creating bot worker failed\n");
+			break;
+		}
+	}
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+	if (mcts->started < workers) {
+		goto mc_malloc_failed;
+	}
+	return mcts;
+
+mc_malloc_failed:
+	mc_free(&mcts);
+	return NULL;
+}
+
+void mc_free(mcts **mcts)
+{
+	if (!mcts || !*mcts) {
+		return;
+	}
+	struct mcts *bot = *mcts;
+	__atomic_store_n(&bot->stop, 1, __ATOMIC_RELEASE);
+	for (size_t i = 1; i < bot->started; i++) {
+		m_event_notify(&bot->workers[i].wake);
+		pthread_join(bot->workers[i].thread, NULL);
+	}
+	for (size_t i = 0; bot->workers && i < bot->count; i++) {
+		a_free(ALLOCATOR_TAG_BOT, bot->workers[i].nodes, MCTS_POOL_NODES * sizeof(mc_node));
+		gs_free(&bot->workers[i].scratch);
+	}
+	a_free(ALLOCATOR_TAG_BOT, bot->workers, bot->count * sizeof(mc_worker));
+	z_free(&bot->table);
+	bb_free(&bot->free);
+	bb_free(&bot->reach);
+	gs_free(&bot->root);
+	a_free(ALLOCATOR_TAG_BOT, bot, sizeof(struct mcts));
+	*mcts = NULL;
+}
+
+/*
+ * RETURNS: number of cells reachable from the root head after moving in direction move
+ */
+static size_t mc_space(mcts *const mcts, const enum m_snake_move move)
+{
+	s_coordinates offset = s_get_move_offset(move);
+	uint16_t head = gs_head(mcts->root);
+	return bb_fill(mcts->free, mcts->reach, head % mcts->root->width + offset.x,
+		       head / mcts->root->width + offset.y);
+}
+
+/*
+ * Searches from the root of the bot with all workers and sums their root statistics
+ * \RETURNS: the move with the most visits that leaves the snake enough room,
+ * SNAKE_MOVE_EMPTY if there is none
+ */
+static enum m_snake_move mc_search_root(mcts *const mcts, const uint64_t deadline)
+{
+	uint64_t start = tw_now();
+	/* Positions of earlier searches were scored against another root, salt keeps them apart */
+	mcts->salt = z_key(ZOBRIST_SEARCH, (uint32_t)mcts->searches);
+	mcts->deadline = deadline;
+	mcts->remaining = mcts->playouts_limit;
+	mcts->pending = (uint32_t)(mcts->count - 1);
+	for (size_t i = 1; i < mcts->count; i++) {
+		m_event_notify(&mcts->workers[i].wake);
+	}
+	mc_worker_search(&mcts->workers[0]);
+	if (mcts->count > 1) {
+		m_event_wait(&mcts->done, 0);
+	}
+
+	uint64_t visits[5] = { 0 };
+	double rewards[5] = { 0 };
+	uint64_t playouts = 0;
+	for (size_t i = 0; i < mcts->count; i++) {
+		const mc_worker *worker = &mcts->workers[i];
+		const mc_node *root = &worker->nodes[0];
+		playouts += worker->playouts;
+		if (!root->children) {
+			continue;
+		}
+		for (uint32_t child = root->children; child < root->children + root->count; child++) {
+			visits[worker->nodes[child].move] += worker->nodes[child].visits;
+			rewards[worker->nodes[child].move] += worker->nodes[child].reward;
+		}
+	}
+
+	/* Playouts are too short to see a dead end longer than their depth, the flood fill is not */
+	short roomy[5] = { 0 };
+	short any_roomy = 0;
+	if (mcts->root->alive && mcts->root->length) {
+		bb_from_state(mcts->free, mcts->root);
+		for (int move = SNAKE_MOVE_UP; move <= SNAKE_MOVE_LEFT; move++) {
+			roomy[move] = visits[move]
+				      && mc_space(mcts, (enum m_snake_move)move) >= mcts->root->length;
+			any_roomy |= roomy[move];
+		}
+	}
+	enum m_snake_move best = SNAKE_MOVE_EMPTY;
+	enum m_snake_move most = SNAKE_MOVE_EMPTY;
+	for (int move = SNAKE_MOVE_UP; move <= SNAKE_MOVE_LEFT; move++) {
+		if (visits[move] > visits[most]) {
+			most = (enum m_snake_move)move;
+		}
+		if (any_roomy && !roomy[move]) {
+			continue;
+		}
+		if (visits[move] > visits[best]
+		    || (visits[move] && visits[move] == visits[best]
+			&& rewards[move] > rewards[best])) {
+			best = (enum m_snake_move)move;
+		}
+	}
+	if (visits[best] < visits[most]) {
+		mcts->traps++;
+	}
+	mcts->playouts = playouts;
+	mcts->searches++;
+	mcts->search_time += tw_now() - start;
+	return best;
+}
+
+enum m_snake_move mc_search(mcts *const mcts, const game_state *const state,
+			    const uint64_t deadline)
+{
+	if (!mcts || !state || state->size != mcts->root->size) {
+		return SNAKE_MOVE_EMPTY;
+	}
+	gs_clone(mcts->root, state);
+	return mc_search_root(mcts, deadline);
+}
+
+void mc_think(mcts *const mcts, const snake *const snake, const monitor *const monitor)
+{
+	if (!mcts || !snake || !monitor || !monitor->snake_alive) {
+		return;
+	}
+	if (!gs_snapshot(mcts->root, snake, monitor)) {
+		return;
+	}
+	mcts->map = snake->board->map;
+	mcts->move =
+		mc_search_root(mcts, tw_now() + (uint64_t)SNAKE_MOVE_INTERVAL / MCTS_BUDGET_DIVISOR);
+}
+
+enum m_snake_move mc_take(mcts *const mcts)
+{
+	enum m_snake_move move = mcts->move;
+	mcts->move = SNAKE_MOVE_EMPTY;
+	return move;
+}
+
+void mc_report(const mcts *const mcts, FILE *const stream)
+{
+	if (!mcts || !mcts->searches || !mcts->search_time) {
+		return;
+	}
+	fprintf(stream,
+		"bot: %llu searches with %zu workers, %.0f playouts per second,"
+		" %.0f playouts and %.2f ms per search\n",
+		(unsigned long long)mcts->searches, mcts->count,
+		(double)mcts->playouts * 1e9 / (double)mcts->search_time,
+		(double)mcts->playouts / (double)mcts->searches,
+		(double)mcts->search_time / (double)mcts->searches / 1e6);
+	if (mcts->traps) {
+		fprintf(stream, "bot: %llu moves into too small a region avoided\n",
+			(unsigned long long)mcts->traps);
+	}
+	uint64_t probes = 0;
+	uint64_t hits = 0;
+	for (size_t i = 0; i < mcts->count; i++) {
+		probes += mcts->workers[i].probes;
+		hits += mcts->workers[i].hits;
+	}
+	if (probes) {
+		fprintf(stream, "bot: transposition table used for %.1f%% of %llu selections\n",
+			100.0 * (double)hits / (double)probes, (unsigned long long)probes);
+	}
+}
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __MCTS_H__
+#define __MCTS_H__
+
+#include "bitboard.h"
+#include "game_state.h"
+#include "monitor.h"
+#include "zobrist.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Tree nodes owned by every worker, reused by every search
+ */
+#define MCTS_POOL_NODES 16384
+
+/*
+ * Ticks played at random after the end of the tree
+ */
+#define MCTS_DEPTH 48
+
+/*
+ * Playouts a single search runs at most
+ */
+#define MCTS_PLAYOUTS 20000
+
+/*
+ * Search time is the tick interval divided by this, the rest of the tick is left to the game
+ */
+#define MCTS_BUDGET_DIVISOR 2
+
+/*
+ * Transposition table of the interactive bot has 2^MCTS_TABLE_BITS entries
+ */
+#define MCTS_TABLE_BITS 16
+
+/*
+ * Reward factor for every tick the food is reached later than the shortest path allows
+ */
+#define MCTS_DISCOUNT 0.9
+
+/*
+ * UCT exploration constant
+ */
+#define MCTS_EXPLORATION 0.7
+
+/*
+ * Tree node, children are stored next to each other in the pool.
+ * Children 0 means the node was not expanded, the root is the only node at index 0.
+ * Hash is the hash of the position after the move salted with the search, set once visited
+ */
+typedef struct mc_node {
+	uint64_t hash;
+	uint32_t parent;
+	uint32_t children;
+	uint32_t visits;
+	float reward;
+	uint8_t count;
+	uint8_t move;
+	uint8_t terminal;
+} mc_node;
+
+struct mcts;
+
+/*
+ * Searches its own tree from the shared root, worker 0 runs on the thread calling mc_search
+ */
+typedef struct mc_worker {
+	struct mcts *mcts;
+	pthread_t thread;
+	m_event wake;
+	mc_node *nodes;
+	uint32_t used;
+	game_state *scratch;
+	uint64_t random;
+	uint64_t playouts;
+	uint64_t probes;
+	uint64_t hits;
+} mc_worker;
+
+/*
+ * Monte Carlo tree search bot.
+ * Every worker builds a separate tree from the same root, root visits are summed at the end.
+ * Workers share statistics of positions through the transposition table if there is one,
+ * so positions reached in another tree or by another order of moves are not learned again.
+ * Moves into a region with less room than the snake length are only taken when every move
+ * does, free and reach are the bitboards measuring that room.
+ * Map is the map of the snake last thought about, rollouts going toward the food prefer
+ * moves away from its walls.
+ * Move is the decision of the last mc_think waiting to be taken by s_handle_move
+ */
+typedef struct mcts {
+	game_state *root;
+	z_table *table;
+	uint64_t salt;
+	uint64_t deadline;
+	long remaining;
+	long playouts_limit;
+	uint32_t pending;
+	short stop;
+	m_event done;
+	size_t count;
+	size_t started;
+	mc_worker *workers;
+	bitboard *free;
+	bitboard *reach;
+	const struct map *map;
+	enum m_snake_move move;
+	uint64_t playouts;
+	uint64_t traps;
+	uint64_t searches;
+	uint64_t search_time;
+} mcts;
+
+/*
+ * Creates bot for given board size with workers threads (at least 1, the caller counts as one),
+ * at most playouts playouts per search and a transposition table of 2^table_bits entries,
+ * table_bits 0 searches without one
+ * \RETURNS: pointer to the bot, NULL on failure
+ */
+mcts *mc_malloc(const int width, const int height, const size_t workers, const long playouts,
+		const unsigned int table_bits);
+
+/*
+ * Stops the worker threads and frees the bot
+ */
+void mc_free(mcts **mcts);
+
+/*
+ * Searches from state until the monotonic deadline in nanoseconds or the playout limit
+ * \RETURNS: the move with the most visits, SNAKE_MOVE_EMPTY if there is none
+ */
+enum m_snake_move mc_search(mcts *const mcts, const game_state *const state,
+			    const uint64_t deadline);
+
+/*
+ * Searches the next move of snake for part of a tick, monitor gives the direction.
+ * Called by the game thread between ticks, it is the only writer of the monitor fields read,
+ * so the monitor is not locked. The move is taken by s_handle_move
+ */
+void mc_think(mcts *const mcts, const snake *const snake, const monitor *const monitor);
+
+/*
+ * Takes the move decided by mc_think
+ * \RETURNS: the move, SNAKE_MOVE_EMPTY if there was no new decision
+ */
+enum m_snake_move mc_take(mcts *const mcts);
+
+/*
+ * Prints searches, playouts per second, mean search time and transposition table hits
+ */
+void mc_report(const mcts *const mcts, FILE *const stream);
+
+#endif
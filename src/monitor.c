@@ -19,27 +19,125 @@
  * SOFTWARE.
  */
 
+#define _GNU_SOURCE
 #include "monitor.h"
+#include "allocator.h"
+#include "timing_wheel.h"
+#include <errno.h>
+#include <linux/futex.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifdef MONITOR_PROFILE
+
+/*
+ * Histograms have one bucket per power of two nanoseconds
+ */
+#define MONITOR_PROFILE_BUCKETS 32
+
+/*
+ * Distinct call sites a single thread can use
+ */
+#define MONITOR_PROFILE_SITES 8
+
+/*
+ * Lock statistics of one call site on one thread, only written by that thread
+ */
+typedef struct m_profile {
+	const char *site;
+	char thread_name[16];
+	unsigned long acquisitions;
+	unsigned long contended;
+	unsigned long signals;
+	unsigned long wakeups;
+	unsigned long spurious;
+	unsigned long wait[MONITOR_PROFILE_BUCKETS];
+	unsigned long hold[MONITOR_PROFILE_BUCKETS];
+	struct m_profile *next;
+} m_profile;
+
+static pthread_mutex_t m_profile_mutex = PTHREAD_MUTEX_INITIALIZER;
+static m_profile *m_profiles = NULL;
+static __thread m_profile *m_profile_local[MONITOR_PROFILE_SITES];
+static __thread m_profile *m_profile_held = NULL;
+static __thread uint64_t m_profile_locked_at = 0;
+
+/*
+ * RETURNS: profile of site for the calling thread, NULL if it can not be allocated
+ */
+static m_profile *m_profile_get(const char *const site)
+{
+	for (size_t i = 0; i < MONITOR_PROFILE_SITES; i++) {
+		if (m_profile_local[i] && m_profile_local[i]->site == site) {
+			return m_profile_local[i];
+		}
+		if (!m_profile_local[i]) {
+			m_profile *profile = calloc(1, sizeof(m_profile));
+			if (!profile) {
+				return NULL;
+			}
+			profile->site = site;
+			pthread_getname_np(pthread_self(), profile->thread_name,
+					   sizeof(profile->thread_name));
+			pthread_mutex_lock(&m_profile_mutex);
+			profile->next = m_profiles;
+			m_profiles = profile;
+			pthread_mutex_unlock(&m_profile_mutex);
+			m_profile_local[i] = profile;
+			return profile;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * RETURNS: histogram bucket of the duration
+ */
+static size_t m_profile_bucket(const uint64_t nanoseconds)
+{
+	size_t bucket = (size_t)(63 - __builtin_clzll(nanoseconds | 1));
+	return bucket < MONITOR_PROFILE_BUCKETS ? bucket : MONITOR_PROFILE_BUCKETS - 1;
+}
+
+/*
+ * RETURNS: upper bound of the bucket holding the percentile in microseconds
+ */
+static double m_profile_percentile(const unsigned long *const histogram, const double percentile)
+{
+	unsigned long total = 0;
+	for (size_t i = 0; i < MONITOR_PROFILE_BUCKETS; i++) {
+		total += histogram[i];
+	}
+	unsigned long seen = 0;
+	for (size_t i = 0; i < MONITOR_PROFILE_BUCKETS; i++) {
+		seen += histogram[i];
+		if (total && (double)seen >= percentile * (double)total) {
+			return (double)(2ULL << i) / 1e3;
+		}
+	}
+	return 0.0;
+}
+
+#endif
 
 monitor *m_malloc(void)
 {
-	monitor *monitor = (struct monitor *)malloc(sizeof(struct monitor));
+	monitor *monitor = a_aligned(ALLOCATOR_TAG_MONITOR, MONITOR_CACHE_LINE, sizeof(struct monitor));
 	if (!monitor) {
 		fprintf(stderr, "ERROR: malloc failed for monitor allocation\n");
 		return NULL;
 	}
 	if (pthread_mutex_init(&(monitor->mutex), NULL) != 0) {
 		fprintf(stderr, "ERROR: mutex creation failed\n");
-		goto m_monitor_free;
-	}
-	if (pthread_cond_init(&(monitor->conditional), NULL) != 0) {
-		pthread_mutex_destroy(&(monitor->mutex));
-m_monitor_free:
-		free(monitor);
+		a_free(ALLOCATOR_TAG_MONITOR, monitor, sizeof(struct monitor));
 		return NULL;
 	}
+	monitor->snake_event.state = EVENT_EMPTY;
+	monitor->windows_event.state = EVENT_EMPTY;
 
 	return monitor;
 }
@@ -52,12 +150,201 @@ void m_initialize(monitor *const monitor)
 	monitor->move_next[1] = SNAKE_MOVE_EMPTY;
 	monitor->move_previous = SNAKE_MOVE_RIGHT;
 	monitor->snake_alive = 1;
+	monitor->hud_visible = 0;
+	monitor->keyframe = NULL;
+	monitor->keyframe_wanted = 0;
 }
 
 void m_free(monitor **monitor)
 {
 	pthread_mutex_destroy(&((*monitor)->mutex));
-	pthread_cond_destroy(&((*monitor)->conditional));
-	free(*monitor);
+	a_free(ALLOCATOR_TAG_MONITOR, *monitor, sizeof(struct monitor));
 	*monitor = NULL;
 }
+
+void m_lock(monitor *const monitor, const char *const site)
+{
+#ifdef MONITOR_PROFILE
+	uint64_t start = tw_now();
+	short contended = 0;
+	if (pthread_mutex_trylock(&(monitor->mutex)) == EBUSY) {
+		contended = 1;
+		pthread_mutex_lock(&(monitor->mutex));
+	}
+	m_profile_locked_at = tw_now();
+	m_profile_held = m_profile_get(site);
+	if (m_profile_held) {
+		m_profile_held->acquisitions++;
+		m_profile_held->contended += (unsigned long)contended;
+		m_profile_held->wait[m_profile_bucket(m_profile_locked_at - start)]++;
+	}
+#else
+	(void)site;
+	pthread_mutex_lock(&(monitor->mutex));
+#endif
+}
+
+void m_unlock(monitor *const monitor)
+{
+#ifdef MONITOR_PROFILE
+	if (m_profile_held) {
+		m_profile_held->hold[m_profile_bucket(tw_now() - m_profile_locked_at)]++;
+		m_profile_held = NULL;
+	}
+#endif
+	pthread_mutex_unlock(&(monitor->mutex));
+}
+
+void m_wait(monitor *const monitor, m_event *const event, const char *const site,
+	    short (*ready)(const struct monitor *const))
+{
+#ifdef MONITOR_PROFILE
+	m_profile *profile = m_profile_get(site);
+#endif
+	while (!ready(monitor)) {
+		m_unlock(monitor);
+		m_event_wait(event, 0);
+		m_lock(monitor, site);
+#ifdef MONITOR_PROFILE
+		if (profile) {
+			profile->wakeups++;
+			profile->spurious += (unsigned long)!ready(monitor);
+		}
+#endif
+	}
+}
+
+void m_signal(m_event *const event, const char *const site)
+{
+#ifdef MONITOR_PROFILE
+	m_profile *profile = m_profile_get(site);
+	if (profile) {
+		profile->signals++;
+	}
+#else
+	(void)site;
+#endif
+	m_event_notify(event);
+}
+
+/*
+ * Sets event and wakes its waiter if it sleeps, private is FUTEX_PRIVATE_FLAG or 0
+ */
+static void m_event_set(m_event *const event, const int private)
+{
+	if (__atomic_exchange_n(&event->state, EVENT_SET, __ATOMIC_RELEASE) == EVENT_WAITING) {
+		syscall(SYS_futex, &event->state, FUTEX_WAKE | private, 1, NULL, NULL, 0);
+	}
+}
+
+void m_event_notify(m_event *const event)
+{
+	m_event_set(event, FUTEX_PRIVATE_FLAG);
+}
+
+short m_event_wait(m_event *const event, const uint64_t deadline)
+{
+	struct timespec timeout = { (time_t)(deadline / 1000000000),
+				    (long)(deadline % 1000000000) };
+	while (1) {
+		if (__atomic_exchange_n(&event->state, EVENT_EMPTY, __ATOMIC_ACQUIRE) == EVENT_SET) {
+			return 1;
+		}
+		if (deadline && tw_now() >= deadline) {
+			return 0;
+		}
+		uint32_t expected = EVENT_EMPTY;
+		if (!__atomic_compare_exchange_n(&event->state, &expected, EVENT_WAITING, 0,
+						 __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			continue;
+		}
+		/* Bitset wait takes an absolute CLOCK_MONOTONIC timeout, same clock as tw_now */
+		syscall(SYS_futex, &event->state, FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG, EVENT_WAITING,
+			deadline ? &timeout : NULL, NULL, FUTEX_BITSET_MATCH_ANY);
+	}
+}
+
+void m_event_notify_shared(m_event *const event)
+{
+	m_event_set(event, 0);
+}
+
+short m_event_wait_shared(m_event *const event, const unsigned int spins)
+{
+	for (unsigned int spin = 0; spin < spins; spin++) {
+		if (__atomic_load_n(&event->state, __ATOMIC_RELAXED) == EVENT_SET) {
+			break;
+		}
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#endif
+	}
+	while (1) {
+		if (__atomic_exchange_n(&event->state, EVENT_EMPTY, __ATOMIC_ACQUIRE) == EVENT_SET) {
+			return 1;
+		}
+		uint32_t expected = EVENT_EMPTY;
+		if (!__atomic_compare_exchange_n(&event->state, &expected, EVENT_WAITING, 0,
+						 __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			continue;
+		}
+		if (syscall(SYS_futex, &event->state, FUTEX_WAIT, EVENT_WAITING, NULL, NULL, 0) == -1
+		    && errno == EINTR) {
+			return 0;
+		}
+	}
+}
+
+short m_windows_ready(const monitor *const monitor)
+{
+	return monitor->signal_windows != SIGNAL_WINDOWS_EMPTY;
+}
+
+void m_profile_report(FILE *const stream)
+{
+#ifdef MONITOR_PROFILE
+	pthread_mutex_lock(&m_profile_mutex);
+	fprintf(stream, "%-12s %-24s %8s %9s %9s %9s %9s %9s %8s %8s %8s\n", "thread", "site",
+		"locks", "contended", "wait p50", "wait p99", "hold p50", "hold p99", "signals",
+		"wakeups", "spurious");
+	/* Threads with the same name and site are merged into the first of them */
+	for (m_profile *profile = m_profiles; profile; profile = profile->next) {
+		short merged = 0;
+		for (m_profile *other = m_profiles; other != profile && !merged; other = other->next) {
+			merged = other->site == profile->site
+				 && strcmp(other->thread_name, profile->thread_name) == 0;
+		}
+		if (merged) {
+			continue;
+		}
+		m_profile total = *profile;
+		for (m_profile *other = profile->next; other; other = other->next) {
+			if (other->site != profile->site
+			    || strcmp(other->thread_name, profile->thread_name) != 0) {
+				continue;
+			}
+			total.acquisitions += other->acquisitions;
+			total.contended += other->contended;
+			total.signals += other->signals;
+			total.wakeups += other->wakeups;
+			total.spurious += other->spurious;
+			for (size_t i = 0; i < MONITOR_PROFILE_BUCKETS; i++) {
+				total.wait[i] += other->wait[i];
+				total.hold[i] += other->hold[i];
+			}
+		}
+		fprintf(stream,
+			"%-12s %-24s %8lu %8.1f%% %7.1fus %7.1fus %7.1fus %7.1fus %8lu %8lu %8lu\n",
+			total.thread_name, total.site, total.acquisitions,
+			total.acquisitions ? 100.0 * (double)total.contended
+						     / (double)total.acquisitions
+					   : 0.0,
+			m_profile_percentile(total.wait, 0.5), m_profile_percentile(total.wait, 0.99),
+			m_profile_percentile(total.hold, 0.5), m_profile_percentile(total.hold, 0.99),
+			total.signals, total.wakeups, total.spurious);
+	}
+	pthread_mutex_unlock(&m_profile_mutex);
+#else
+	(void)stream;
+#endif
+}
@@ -24,6 +24,13 @@
 #define __MONITOR_H__
 
 #include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Monitor fields written by different threads are kept this many bytes apart
+ */
+#define MONITOR_CACHE_LINE 64
 
 /*
  * Signal type when to the snake thread when a key is pressed
@@ -59,16 +66,44 @@ typedef enum m_snake_move {
 } m_snake_move;
 
 /*
- * Monitor shared between threads
+ * States of a wakeup event
+ */
+typedef enum m_event_state {
+	EVENT_EMPTY,
+	EVENT_SET,
+	EVENT_WAITING
+} m_event_state;
+
+/*
+ * Futex based wakeup channel with a single consumer.
+ * Notifying an event nobody waits on only sets it, without a system call
+ */
+typedef struct m_event {
+	uint32_t state;
+} m_event;
+
+/*
+ * Monitor shared between threads.
+ * Every consumer has its own event, so a notification always wakes the thread it is meant for.
+ * Groups of fields written by different threads sit on separate cache lines
  */
 typedef struct monitor {
-	enum m_signal_snake signal_snake;
-	enum m_signal_windows signal_windows;
-	enum m_snake_move move_previous;
+	pthread_mutex_t mutex;
+	/* Written by the input thread, consumed by the game thread */
+	enum m_signal_snake signal_snake __attribute__((aligned(MONITOR_CACHE_LINE)));
 	enum m_snake_move move_next[2];
+	short hud_visible;
+	/* Written by the game thread */
+	enum m_signal_windows signal_windows __attribute__((aligned(MONITOR_CACHE_LINE)));
+	enum m_snake_move move_previous;
 	short snake_alive;
-	pthread_mutex_t mutex;
-	pthread_cond_t conditional;
+	/* Spectator keyframe taken by the game thread while the body was not changing */
+	struct sp_frame *keyframe;
+	/* Game thread sleeps on its event between ticks, windows thread until a signal */
+	m_event snake_event __attribute__((aligned(MONITOR_CACHE_LINE)));
+	m_event windows_event __attribute__((aligned(MONITOR_CACHE_LINE)));
+	/* Written by the windows thread when a spectator waits for a keyframe */
+	short keyframe_wanted;
 } monitor;
 
 /*
@@ -87,4 +122,63 @@ void m_initialize(monitor *const monitor);
  */
 void m_free(monitor **monitor);
 
+/*
+ * Locks the monitor mutex, site names the caller in the lock profile.
+ * With MONITOR_PROFILE (make PROFILE=1) records how long the calling thread waited
+ * and whether the mutex was already held
+ */
+void m_lock(monitor *const monitor, const char *const site);
+
+/*
+ * Unlocks the monitor mutex, records the hold time with MONITOR_PROFILE
+ */
+void m_unlock(monitor *const monitor);
+
+/*
+ * Waits on event until ready returns 1, the mutex has to be held and is released while waiting.
+ * Every wakeup with ready still returning 0 is counted as spurious
+ */
+void m_wait(monitor *const monitor, m_event *const event, const char *const site,
+	    short (*ready)(const struct monitor *const));
+
+/*
+ * Notifies event, site names the caller in the lock profile
+ */
+void m_signal(m_event *const event, const char *const site);
+
+/*
+ * Wakes the thread waiting on event, or lets its next wait return at once
+ */
+void m_event_notify(m_event *const event);
+
+/*
+ * Waits until event is notified or the monotonic deadline in nanoseconds passes,
+ * deadline 0 waits without a limit
+ * \RETURNS: 1 if the event was notified, 0 on timeout
+ */
+short m_event_wait(m_event *const event, const uint64_t deadline);
+
+/*
+ * Notifies an event placed in memory shared between processes
+ */
+void m_event_notify_shared(m_event *const event);
+
+/*
+ * Waits for an event placed in memory shared between processes, polling it spins times
+ * before sleeping, so a quick notification costs no system call on either side
+ * \RETURNS: 1 if the event was notified, 0 if a signal interrupted the wait
+ */
+short m_event_wait_shared(m_event *const event, const unsigned int spins);
+
+/*
+ * RETURNS: 1 if there is a signal for the windows thread, 0 otherwise
+ */
+short m_windows_ready(const monitor *const monitor);
+
+/*
+ * Prints lock profile of every thread and call site.
+ * Prints nothing when built without MONITOR_PROFILE
+ */
+void m_profile_report(FILE *const stream);
+
 #endif
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "observation.h"
+#include <string.h>
+
+/*
+ * Steps of the 16 rays clockwise from up, the 8 ray set takes every second one
+ */
+static const int32_t ob_steps_x[OBSERVATION_MAX_RAYS] = { 0,  1,  1,  2,  1,  2,  1,  1,
+							  0,  -1, -1, -2, -1, -2, -1, -1 };
+static const int32_t ob_steps_y[OBSERVATION_MAX_RAYS] = { -1, -2, -1, -1, 0,  1,  1,  2,
+							  1,  2,  1,  1,  0,  -1, -1, -2 };
+
+/*
+ * Index into the steps of the ray pointing in direction
+ */
+static unsigned int ob_heading(const m_snake_move direction)
+{
+	switch (direction) {
+	case SNAKE_MOVE_RIGHT:
+		return 4;
+	case SNAKE_MOVE_DOWN:
+		return 8;
+	case SNAKE_MOVE_LEFT:
+		return 12;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Distance from the head at cell to the nearest body cell of the row within limit steps,
+ * whole words of the row are tested at once
+ * \RETURNS: steps to the body, 0 if it is not on the row
+ */
+static int32_t ob_scan_row(const uint64_t *const bitmap, const int32_t cell, const int32_t step,
+			   const int32_t limit)
+{
+	if (limit < 1) {
+		return 0;
+	}
+	uint32_t first = (uint32_t)(step > 0 ? cell + 1 : cell - limit);
+	uint32_t last = (uint32_t)(step > 0 ? cell + limit : cell - 1);
+	if (step > 0) {
+		for (uint32_t word = first >> 6; word <= last >> 6; word++) {
+			uint64_t bits = bitmap[word];
+			if (word == first >> 6) {
+				bits &= ~0ULL << (first & 63);
+			}
+			if (word == last >> 6) {
+				bits &= ~0ULL >> (63 - (last & 63));
+			}
+			if (bits) {
+				return (int32_t)(word * 64 + (uint32_t)__builtin_ctzll(bits)) - cell;
+			}
+		}
+		return 0;
+	}
+	for (uint32_t word = last >> 6;; word--) {
+		uint64_t bits = bitmap[word];
+		if (word == first >> 6) {
+			bits &= ~0ULL << (first & 63);
+		}
+		if (word == last >> 6) {
+			bits &= ~0ULL >> (63 - (last & 63));
+		}
+		if (bits) {
+			return cell - (int32_t)(word * 64 + 63 - (uint32_t)__builtin_clzll(bits));
+		}
+		if (word == first >> 6) {
+			return 0;
+		}
+	}
+}
+
+#if defined(__GNUC__)
+/*
+ * One value of every ray, compiled to SIMD instructions where the target has them
+ */
+typedef int32_t ob_lanes __attribute__((vector_size(OBSERVATION_MAX_RAYS * sizeof(int32_t))));
+#endif
+
+short ob_cast(const uint64_t *const bitmap, const int width, const int height, const int head_x,
+	      const int head_y, const int food_x, const int food_y, const m_snake_move direction,
+	      const unsigned int rays, float *const observation)
+{
+	if (rays != 8 && rays != OBSERVATION_MAX_RAYS) {
+		return 0;
+	}
+	unsigned int stride = OBSERVATION_MAX_RAYS / rays;
+	unsigned int heading = ob_heading(direction);
+	int32_t steps_x[OBSERVATION_MAX_RAYS] = { 0 };
+	int32_t steps_y[OBSERVATION_MAX_RAYS] = { 0 };
+	for (unsigned int ray = 0; ray < rays; ray++) {
+		unsigned int index = (heading + ray * stride) % OBSERVATION_MAX_RAYS;
+		steps_x[ray] = ob_steps_x[index];
+		steps_y[ray] = ob_steps_y[index];
+	}
+
+	/* Steps each ray stays inside the walls, and how many steps away the food is on it */
+	int32_t inside[OBSERVATION_MAX_RAYS];
+	int32_t food[OBSERVATION_MAX_RAYS];
+#if defined(__GNUC__)
+	ob_lanes step_x, step_y;
+	memcpy(&step_x, steps_x, sizeof(ob_lanes));
+	memcpy(&step_y, steps_y, sizeof(ob_lanes));
+	/* Comparisons give -1 in lanes where they hold, lanes are selected with masks */
+	const ob_lanes far = (ob_lanes){ 0 } + (width + height);
+	ob_lanes zero_x = step_x == 0;
+	ob_lanes zero_y = step_y == 0;
+	/* Steps are 1 or 2 cells long on an axis, so divisions by them are shifts */
+	ob_lanes sign_x = (step_x < 0) - (step_x > 0);
+	ob_lanes sign_y = (step_y < 0) - (step_y > 0);
+	ob_lanes length_x = step_x * sign_x;
+	ob_lanes length_y = step_y * sign_y;
+	ob_lanes shift_x = (length_x - 1) & ~zero_x;
+	ob_lanes shift_y = (length_y - 1) & ~zero_y;
+	ob_lanes room_x = ((step_x > 0) & (width - 2 - head_x)) | ((step_x < 0) & (head_x - 1));
+	ob_lanes room_y = ((step_y > 0) & (height - 2 - head_y)) | ((step_y < 0) & (head_y - 1));
+	ob_lanes limit_x = (far & zero_x) | ((room_x >> shift_x) & ~zero_x);
+	ob_lanes limit_y = (far & zero_y) | ((room_y >> shift_y) & ~zero_y);
+	ob_lanes shorter = limit_x < limit_y;
+	ob_lanes limit = (limit_x & shorter) | (limit_y & ~shorter);
+
+	/* Food is on a ray when the same positive number of steps reaches it on both axes */
+	ob_lanes offset_x = (ob_lanes){ 0 } + (food_x - head_x);
+	ob_lanes offset_y = (ob_lanes){ 0 } + (food_y - head_y);
+	ob_lanes distance_x = offset_x * sign_x;
+	ob_lanes distance_y = offset_y * sign_y;
+	ob_lanes along_x = distance_x >> shift_x;
+	ob_lanes along_y = distance_y >> shift_y;
+	ob_lanes along = (along_x & ~zero_x) | (along_y & zero_x);
+	ob_lanes hit = (along_x * length_x == distance_x) & (along_y * length_y == distance_y)
+		       & (~zero_x | (offset_x == 0)) & (~zero_y | (offset_y == 0))
+		       & (zero_x | zero_y | (along_x == along_y)) & (along > 0) & (along <= limit);
+	ob_lanes food_steps = along & hit;
+	memcpy(inside, &limit, sizeof(ob_lanes));
+	memcpy(food, &food_steps, sizeof(ob_lanes));
+#else
+	for (unsigned int ray = 0; ray < OBSERVATION_MAX_RAYS; ray++) {
+		int32_t x = steps_x[ray];
+		int32_t y = steps_y[ray];
+		int32_t limit_x = x > 0 ? (width - 2 - head_x) / x
+				  : x < 0 ? (head_x - 1) / -x
+					  : width + height;
+		int32_t limit_y = y > 0 ? (height - 2 - head_y) / y
+				  : y < 0 ? (head_y - 1) / -y
+					  : width + height;
+		inside[ray] = limit_x < limit_y ? limit_x : limit_y;
+		int32_t along = x ? (food_x - head_x) / x : (food_y - head_y) / (y ? y : 1);
+		food[ray] = along > 0 && along <= inside[ray] && head_x + along * x == food_x
+				    && head_y + along * y == food_y
+			    ? along
+			    : 0;
+	}
+#endif
+
+	/* Rays along the row scan its words, the others walk the bitmap until they meet the body */
+	int32_t body[OBSERVATION_MAX_RAYS] = { 0 };
+	for (unsigned int ray = 0; ray < rays; ray++) {
+		int32_t step = steps_y[ray] * width + steps_x[ray];
+		int32_t cell = head_y * width + head_x;
+		if (steps_y[ray] == 0) {
+			body[ray] = ob_scan_row(bitmap, cell, step, inside[ray]);
+			continue;
+		}
+		for (int32_t distance = 1; distance <= inside[ray]; distance++) {
+			cell += step;
+			if ((bitmap[cell >> 6] >> (cell & 63)) & 1) {
+				body[ray] = distance;
+				break;
+			}
+		}
+	}
+
+	for (unsigned int ray = 0; ray < rays; ray++) {
+		float *features = observation + ray * OBSERVATION_FEATURES;
+		features[0] = 1.0f / (float)(inside[ray] + 1);
+		features[1] = body[ray] ? 1.0f / (float)body[ray] : 0.0f;
+		features[2] = food[ray] ? 1.0f / (float)food[ray] : 0.0f;
+	}
+	return 1;
+}
+
+short ob_from_state(const game_state *const state, const unsigned int rays,
+		    float *const observation)
+{
+	uint16_t head = gs_head(state);
+	return ob_cast(state->data, state->width, state->height, head % state->width,
+		       head / state->width, state->food % state->width, state->food / state->width,
+		       (m_snake_move)state->direction, rays, observation);
+}
+
+short ob_from_batch(const batch *const batch, const uint32_t environment, const unsigned int rays,
+		    float *const observation)
+{
+	return ob_cast(batch->bitmaps + (size_t)environment * batch->bitmap_words, batch->width,
+		       batch->height, batch->head_x[environment], batch->head_y[environment],
+		       batch->food_x[environment], batch->food_y[environment],
+		       (m_snake_move)batch->direction[environment], rays, observation);
+}
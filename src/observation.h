@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __OBSERVATION_H__
+#define __OBSERVATION_H__
+
+#include "batch.h"
+#include "game_state.h"
+#include <stdint.h>
+
+/*
+ * Rays cast from the head, 8 or up to this many
+ */
+#define OBSERVATION_MAX_RAYS 16
+
+/*
+ * Features of one ray: inverse distances to the wall, the body and the food,
+ * the body and the food give 0 when they are not on the ray
+ */
+#define OBSERVATION_FEATURES 3
+
+/*
+ * Casts rays from the head at head_x, head_y over a board of taken cells, a bitmap with bit
+ * y * width + x set for every cell of the body. Rays are egocentric: the first points where
+ * the snake heads in direction, the rest follow clockwise, 8 rays are the straight and
+ * diagonal directions and 16 add the knight moves between them.
+ * Writes rays * OBSERVATION_FEATURES floats to observation
+ * \RETURNS: 1 on success, 0 if rays is neither 8 nor 16
+ */
+short ob_cast(const uint64_t *const bitmap, const int width, const int height, const int head_x,
+	      const int head_y, const int food_x, const int food_y, const m_snake_move direction,
+	      const unsigned int rays, float *const observation);
+
+/*
+ * Casts rays for the snake of state, which must hold at least one cell
+ * \RETURNS: 1 on success, 0 if rays is neither 8 nor 16
+ */
+short ob_from_state(const game_state *const state, const unsigned int rays,
+		    float *const observation);
+
+/*
+ * Casts rays for the snake of environment in batch
+ * \RETURNS: 1 on success, 0 if rays is neither 8 nor 16
+ */
+short ob_from_batch(const batch *const batch, const uint32_t environment, const unsigned int rays,
+		    float *const observation);
+
+#endif
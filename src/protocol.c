@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "protocol.h"
+#include <string.h>
+
+size_t p_encode_welcome(void *const buffer, const size_t size, const uint16_t player,
+			const int width, const int height)
+{
+	size_t total = sizeof(struct p_header) + sizeof(struct p_welcome);
+	if (!buffer || size < total) {
+		return 0;
+	}
+	p_header header = { RECORD_WELCOME, SIGNAL_WINDOWS_EMPTY, player, sizeof(struct p_welcome) };
+	p_welcome welcome = { width, height };
+	memcpy(buffer, &header, sizeof(header));
+	memcpy((char *)buffer + sizeof(header), &welcome, sizeof(welcome));
+	return total;
+}
+
+/*
+ * Fills wire delta from the snake
+ */
+static void p_fill_delta(p_delta *const delta, const snake *const snake)
+{
+	delta->score = snake->score;
+	delta->head = (p_point){ snake->head.x, snake->head.y };
+	delta->tail = (p_point){ snake->tail.x, snake->tail.y };
+	delta->food = (p_point){ snake->food.x, snake->food.y };
+}
+
+size_t p_encode_delta(void *const buffer, const size_t size, const uint16_t player,
+		      const enum m_signal_windows signal, const snake *const snake)
+{
+	size_t total = sizeof(struct p_header) + sizeof(struct p_delta);
+	if (!buffer || !snake || size < total) {
+		return 0;
+	}
+	p_header header = { RECORD_DELTA, (uint8_t)signal, player, sizeof(struct p_delta) };
+	p_delta delta;
+	p_fill_delta(&delta, snake);
+	memcpy(buffer, &header, sizeof(header));
+	memcpy((char *)buffer + sizeof(header), &delta, sizeof(delta));
+	return total;
+}
+
+size_t p_encode_body(void *const buffer, const size_t size, const enum p_record_type type,
+		     const uint16_t player, const snake *const snake)
+{
+	if (!buffer || !snake) {
+		return 0;
+	}
+	size_t length = sizeof(struct p_delta) + s_body_length(snake) * sizeof(struct p_point);
+	size_t total = sizeof(struct p_header) + length;
+	if (size < total || length > UINT32_MAX) {
+		return 0;
+	}
+	p_header header = { (uint8_t)type, SIGNAL_WINDOWS_SNAKE_AND_FOOD_REFRESH, player,
+			    (uint32_t)length };
+	p_delta delta;
+	p_fill_delta(&delta, snake);
+	char *position = buffer;
+	memcpy(position, &header, sizeof(header));
+	position += sizeof(header);
+	memcpy(position, &delta, sizeof(delta));
+	position += sizeof(delta);
+	s_body_iterator part;
+	for (short more = s_body_begin(snake, &part); more; more = s_body_next(&part)) {
+		p_point point = { part.at.x, part.at.y };
+		memcpy(position, &point, sizeof(point));
+		position += sizeof(point);
+	}
+	return total;
+}
+
+size_t p_record_size(const void *const buffer, const size_t size)
+{
+	if (!buffer || size < sizeof(struct p_header)) {
+		return 0;
+	}
+	p_header header;
+	memcpy(&header, buffer, sizeof(header));
+	size_t total = sizeof(struct p_header) + header.length;
+	if (size < total) {
+		return 0;
+	}
+	return total;
+}
+
+short p_record_valid(const p_header *const header)
+{
+	if (!header) {
+		return 0;
+	}
+	switch (header->type) {
+	case RECORD_WELCOME:
+		return header->length >= sizeof(struct p_welcome);
+	case RECORD_DELTA:
+		return header->length >= sizeof(struct p_delta);
+	case RECORD_KEYFRAME:
+	case RECORD_LEAVE:
+		return header->length >= sizeof(struct p_delta)
+		       && (header->length - sizeof(struct p_delta)) % sizeof(struct p_point) == 0;
+	default:
+		return 0;
+	}
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __PROTOCOL_H__
+#define __PROTOCOL_H__
+
+#include "monitor.h"
+#include "snake.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Default Unix domain socket path of the server
+ */
+#define PROTOCOL_SOCKET_PATH "/tmp/snake.sock"
+
+/*
+ * Record types sent from the server to clients.
+ * Keyframe and leave records carry the delta followed by every body segment
+ */
+typedef enum p_record_type {
+	RECORD_EMPTY,
+	RECORD_WELCOME,
+	RECORD_DELTA,
+	RECORD_KEYFRAME,
+	RECORD_LEAVE,
+	RECORD_TYPE_COUNT
+} p_record_type;
+
+/*
+ * Header in front of every record, length is the payload size in bytes
+ */
+typedef struct p_header {
+	uint8_t type;
+	uint8_t signal;
+	uint16_t player;
+	uint32_t length;
+} p_header;
+
+/*
+ * Cell coordinates on the wire
+ */
+typedef struct p_point {
+	int32_t x;
+	int32_t y;
+} p_point;
+
+/*
+ * Board size sent to a newly connected client
+ */
+typedef struct p_welcome {
+	int32_t width;
+	int32_t height;
+} p_welcome;
+
+/*
+ * Per tick change of one snake
+ */
+typedef struct p_delta {
+	uint32_t score;
+	struct p_point head;
+	struct p_point tail;
+	struct p_point food;
+} p_delta;
+
+/*
+ * Encodes welcome record into the buffer
+ * \RETURNS: number of bytes written, 0 if buffer is too small
+ */
+size_t p_encode_welcome(void *const buffer, const size_t size, const uint16_t player,
+			const int width, const int height);
+
+/*
+ * Encodes snake change produced by a tick into the buffer
+ * \RETURNS: number of bytes written, 0 if buffer is too small
+ */
+size_t p_encode_delta(void *const buffer, const size_t size, const uint16_t player,
+		      const enum m_signal_windows signal, const snake *const snake);
+
+/*
+ * Encodes the whole snake body as a keyframe or leave record into the buffer
+ * \RETURNS: number of bytes written, 0 if buffer is too small
+ */
+size_t p_encode_body(void *const buffer, const size_t size, const enum p_record_type type,
+		     const uint16_t player, const snake *const snake);
+
+/*
+ * Checks whether the buffer starts with a complete record
+ * \RETURNS: size of the record, 0 if it is not complete yet
+ */
+size_t p_record_size(const void *const buffer, const size_t size);
+
+/*
+ * Checks whether the payload length fits the record type, welcome and delta records carry
+ * their fixed payload, keyframe and leave records a delta followed by whole points
+ * \RETURNS: 1 if the record can be decoded, 0 otherwise
+ */
+short p_record_valid(const p_header *const header);
+
+#endif
@@ -0,0 +1,495 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "replay.h"
+#include "allocator.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Verification thread, checks the segments it takes from next until none are left.
+ * Failed counts the segments that differ, first is the lowest of them
+ */
+typedef struct rp_worker {
+	const struct replay *replay;
+	uint32_t *next;
+	game_state *state;
+	void *packed;
+	size_t packed_capacity;
+	uint32_t failed;
+	uint32_t first;
+	pthread_t thread;
+} rp_worker;
+
+/*
+ * RETURNS: size rounded up to a multiple of 8 bytes
+ */
+static size_t rp_align(const size_t size)
+{
+	return (size + 7) & ~(size_t)7;
+}
+
+/*
+ * RETURNS: bytes taken by the moves of count ticks
+ */
+static size_t rp_moves_size(const uint64_t count)
+{
+	return rp_align((size_t)((count + REPLAY_MOVES_PER_BYTE - 1) / REPLAY_MOVES_PER_BYTE));
+}
+
+/*
+ * Writes size bytes of data and zeros up to the next multiple of 8 bytes
+ */
+static void rp_write(rp_recorder *const recorder, const void *const data, const size_t size)
+{
+	static const uint64_t zero = 0;
+	size_t padding = rp_align(size) - size;
+	if (fwrite(data, 1, size, recorder->file) != size
+	    || fwrite(&zero, 1, padding, recorder->file) != padding) {
+		recorder->failed = 1;
+	}
+	recorder->offset += size + padding;
+}
+
+/*
+ * Writes the last keyframe taken with the moves recorded after it
+ */
+static void rp_flush(rp_recorder *const recorder)
+{
+	const rp_entry *entry = &recorder->index[recorder->keyframes - 1];
+	uint64_t count = recorder->ticks - entry->tick;
+	size_t moves = (size_t)((count + REPLAY_MOVES_PER_BYTE - 1) / REPLAY_MOVES_PER_BYTE);
+	rp_write(recorder, recorder->packed, recorder->packed_size);
+	rp_write(recorder, recorder->moves, moves);
+	memset(recorder->moves, 0, moves);
+}
+
+/*
+ * Takes a keyframe of the current tick from the snake and adds it to the index
+ * \RETURNS: 1 on success, 0 if the index could not grow
+ */
+static short rp_keyframe(rp_recorder *const recorder, const short alive)
+{
+	if (recorder->keyframes == recorder->index_capacity) {
+		size_t old_size = recorder->index_capacity * sizeof(rp_entry);
+		rp_entry *index = a_realloc(ALLOCATOR_TAG_REPLAY, recorder->index, old_size,
+					    old_size * 2);
+		if (!index) {
+			perror("ERROR: replay index realloc failed\n");
+			return 0;
+		}
+		recorder->index = index;
+		recorder->index_capacity *= 2;
+	}
+	gs_snapshot(recorder->state, recorder->snake, NULL);
+	recorder->state->direction = recorder->direction;
+	recorder->state->alive = (uint8_t)(alive != 0);
+	recorder->packed_size =
+		gs_pack(recorder->state, recorder->packed, recorder->packed_capacity);
+	recorder->index[recorder->keyframes++] =
+		(rp_entry){ recorder->ticks, recorder->offset, recorder->packed_size };
+	return 1;
+}
+
+/*
+ * Takes the last keyframe unless there is one of the current tick, alive is 0 if the snake died
+ * in it, then writes the index and the header. The recorder takes no more ticks
+ */
+static void rp_finish(rp_recorder *const recorder, const short alive)
+{
+	if (recorder->finished) {
+		return;
+	}
+	recorder->finished = 1;
+	if (recorder->index[recorder->keyframes - 1].tick != recorder->ticks) {
+		rp_flush(recorder);
+		if (!rp_keyframe(recorder, alive)) {
+			recorder->failed = 1;
+			return;
+		}
+	}
+	rp_flush(recorder);
+	rp_header header = { REPLAY_MAGIC,
+			     REPLAY_VERSION,
+			     recorder->state->width,
+			     recorder->state->height,
+			     recorder->interval,
+			     recorder->keyframes,
+			     recorder->state->walled ? recorder->state->bitmap_words : 0,
+			     0,
+			     recorder->ticks,
+			     recorder->offset,
+			     recorder->offset + recorder->keyframes * sizeof(rp_entry) };
+	rp_write(recorder, recorder->index, recorder->keyframes * sizeof(rp_entry));
+	if (fseek(recorder->file, 0, SEEK_SET) != 0
+	    || fwrite(&header, sizeof(header), 1, recorder->file) != 1) {
+		recorder->failed = 1;
+	}
+}
+
+rp_recorder *rp_open(const char *const path, const snake *const snake, const uint32_t interval)
+{
+	if (!path || !snake || !snake->board || interval < 1) {
+		return NULL;
+	}
+	if (snake->foods) {
+		fprintf(stderr, "ERROR: games with more than one food can not be recorded\n");
+		return NULL;
+	}
+	rp_recorder *recorder = a_calloc(ALLOCATOR_TAG_REPLAY, 1, sizeof(struct rp_recorder));
+	if (!recorder) {
+		perror("ERROR: replay recorder malloc failed\n");
+		return NULL;
+	}
+	/* Nothing is written on close until the first keyframe is taken */
+	recorder->finished = 1;
+	recorder->snake = snake;
+	recorder->interval = interval;
+	recorder->direction = SNAKE_MOVE_RIGHT;
+	recorder->ticks = snake->ticks;
+	recorder->state = gs_malloc(snake->board->width, snake->board->height);
+	recorder->packed_capacity = gs_packed_size(snake->board->width, snake->board->height);
+	recorder->index_capacity = 64;
+	recorder->packed = a_malloc(ALLOCATOR_TAG_REPLAY, recorder->packed_capacity);
+	recorder->moves = a_calloc(ALLOCATOR_TAG_REPLAY, rp_moves_size(interval), 1);
+	recorder->index =
+		a_malloc(ALLOCATOR_TAG_REPLAY, recorder->index_capacity * sizeof(rp_entry));
+	if (!recorder->state || !recorder->packed || !recorder->moves || !recorder->index) {
+		perror("ERROR: replay recorder buffers malloc failed\n");
+		goto rp_open_failed;
+	}
+	recorder->file = fopen(path, "wb");
+	if (!recorder->file) {
+		perror("ERROR: replay open failed\n");
+		goto rp_open_failed;
+	}
+	/* Header is written again with the index once the game is over */
+	rp_header header = { 0 };
+	rp_write(recorder, &header, sizeof(header));
+	rp_keyframe(recorder, 1);
+	if (recorder->state->walled) {
+		size_t size = recorder->state->bitmap_words * sizeof(uint64_t);
+		uint64_t *walls = a_malloc(ALLOCATOR_TAG_REPLAY, size);
+		if (!walls) {
+			perror("ERROR: replay walls malloc failed\n");
+			goto rp_open_failed;
+		}
+		gs_walls(recorder->state, walls);
+		rp_write(recorder, walls, size);
+		a_free(ALLOCATOR_TAG_REPLAY, walls, size);
+		/* The first keyframe follows the walls */
+		recorder->index[0].offset = recorder->offset;
+	}
+	if (recorder->failed) {
+		perror("ERROR: replay write failed\n");
+		goto rp_open_failed;
+	}
+	recorder->finished = 0;
+	return recorder;
+
+rp_open_failed:
+	rp_close(&recorder);
+	return NULL;
+}
+
+void rp_record(rp_recorder *const recorder, const m_snake_move move, const short alive)
+{
+	if (!recorder || recorder->finished) {
+		return;
+	}
+	m_snake_move played = move >= SNAKE_MOVE_UP && move <= SNAKE_MOVE_LEFT
+				      ? move
+				      : (m_snake_move)recorder->direction;
+	uint64_t position = recorder->ticks - recorder->index[recorder->keyframes - 1].tick;
+	recorder->moves[position / REPLAY_MOVES_PER_BYTE] |=
+		(uint8_t)((played - SNAKE_MOVE_UP) << (position % REPLAY_MOVES_PER_BYTE * 2));
+	recorder->ticks++;
+	if (!alive) {
+		rp_finish(recorder, 0);
+		return;
+	}
+	/* Game states keep the direction of the last tick the snake survived */
+	recorder->direction = (uint8_t)played;
+	if (recorder->ticks % recorder->interval == 0) {
+		rp_flush(recorder);
+		if (!rp_keyframe(recorder, 1)) {
+			recorder->failed = 1;
+			recorder->finished = 1;
+		}
+	}
+}
+
+short rp_close(rp_recorder **recorder)
+{
+	if (!recorder || !*recorder) {
+		return 0;
+	}
+	rp_recorder *closed = *recorder;
+	rp_finish(closed, 1);
+	if (closed->file && fclose(closed->file) != 0) {
+		closed->failed = 1;
+	}
+	if (closed->failed) {
+		perror("ERROR: replay write failed\n");
+	}
+	short written = closed->file && !closed->failed;
+	gs_free(&closed->state);
+	a_free(ALLOCATOR_TAG_REPLAY, closed->packed, closed->packed_capacity);
+	a_free(ALLOCATOR_TAG_REPLAY, closed->moves, rp_moves_size(closed->interval));
+	a_free(ALLOCATOR_TAG_REPLAY, closed->index, closed->index_capacity * sizeof(rp_entry));
+	a_free(ALLOCATOR_TAG_REPLAY, closed, sizeof(struct rp_recorder));
+	*recorder = NULL;
+	return written;
+}
+
+replay *rp_load(const char *const path)
+{
+	if (!path) {
+		return NULL;
+	}
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		perror("ERROR: replay open failed\n");
+		return NULL;
+	}
+	struct stat status;
+	if (fstat(fd, &status) != 0 || (size_t)status.st_size < sizeof(struct rp_header)) {
+		fprintf(stderr, "ERROR: %s is not a replay\n", path);
+		close(fd);
+		return NULL;
+	}
+	size_t size = (size_t)status.st_size;
+	const rp_header *header = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (header == MAP_FAILED) {
+		perror("ERROR: replay mmap failed\n");
+		return NULL;
+	}
+	size_t walls = (size_t)header->walls_words * sizeof(uint64_t);
+	if (memcmp(header->magic, REPLAY_MAGIC, sizeof(header->magic)) != 0
+	    || header->version != REPLAY_VERSION || header->size != size
+	    || !gs_size(header->width, header->height) || header->interval < 1
+	    || header->keyframes < 1
+	    || (header->walls_words
+		&& header->walls_words != ((size_t)header->width * header->height + 63) / 64)
+	    || header->index % sizeof(uint64_t) != 0
+	    || header->index < sizeof(struct rp_header) + walls || header->index > size
+	    || (size - header->index) / sizeof(rp_entry) < header->keyframes) {
+		fprintf(stderr, "ERROR: %s is not a replay of version %d\n", path, REPLAY_VERSION);
+		munmap((void *)header, size);
+		return NULL;
+	}
+
+	replay *replay = a_malloc(ALLOCATOR_TAG_REPLAY, sizeof(struct replay));
+	if (!replay) {
+		perror("ERROR: replay malloc failed\n");
+		munmap((void *)header, size);
+		return NULL;
+	}
+	replay->width = header->width;
+	replay->height = header->height;
+	replay->interval = header->interval;
+	replay->keyframes = header->keyframes;
+	replay->ticks = header->ticks;
+	replay->size = size;
+	replay->header = header;
+	replay->walls = walls ? (const uint64_t *)(header + 1) : NULL;
+	replay->index = (const rp_entry *)((const char *)header + header->index);
+	/* Keyframes are interval ticks apart but the last, segments lie between walls and index */
+	for (uint32_t i = 0; i < replay->keyframes; i++) {
+		const rp_entry *entry = &replay->index[i];
+		uint64_t tick = i + 1 < replay->keyframes ? (uint64_t)i * replay->interval
+							  : replay->ticks;
+		uint64_t next = i + 1 < replay->keyframes ? entry[1].tick : tick;
+		if (entry->tick != tick || next < tick || next - tick > replay->interval
+		    || entry->offset % sizeof(uint64_t) != 0
+		    || entry->offset < sizeof(struct rp_header) + walls
+		    || entry->offset > header->index || entry->size < sizeof(struct gs_packed)
+		    || entry->size > header->index
+		    || header->index - entry->offset
+			       < rp_align((size_t)entry->size) + rp_moves_size(next - tick)) {
+			fprintf(stderr, "ERROR: keyframe %u of %s is not valid\n", i, path);
+			rp_free(&replay);
+			return NULL;
+		}
+	}
+	return replay;
+}
+
+void rp_free(replay **replay)
+{
+	if (!replay || !*replay) {
+		return;
+	}
+	munmap((void *)(*replay)->header, (*replay)->size);
+	a_free(ALLOCATOR_TAG_REPLAY, *replay, sizeof(struct replay));
+	*replay = NULL;
+}
+
+/*
+ * RETURNS: keyframe whose segment holds the move of tick, 1 to ticks
+ */
+static uint32_t rp_segment(const replay *const replay, const uint64_t tick)
+{
+	return (uint32_t)((tick - 1) / replay->interval);
+}
+
+m_snake_move rp_move(const replay *const replay, const uint64_t tick)
+{
+	const rp_entry *entry = &replay->index[rp_segment(replay, tick)];
+	const uint8_t *moves =
+		(const uint8_t *)replay->header + entry->offset + rp_align((size_t)entry->size);
+	uint64_t position = tick - 1 - entry->tick;
+	unsigned int bits = moves[position / REPLAY_MOVES_PER_BYTE]
+			    >> (position % REPLAY_MOVES_PER_BYTE * 2);
+	return (m_snake_move)(SNAKE_MOVE_UP + (bits & 3));
+}
+
+/*
+ * Puts keyframe into state
+ * \RETURNS: 1 on success, 0 if the keyframe is not a valid state of the board of the replay
+ */
+static short rp_restore(const replay *const replay, game_state *const state,
+			const uint32_t keyframe)
+{
+	const rp_entry *entry = &replay->index[keyframe];
+	return gs_unpack(state, (const char *)replay->header + entry->offset, (size_t)entry->size,
+			 replay->walls);
+}
+
+short rp_seek(const replay *const replay, game_state *const state, const uint64_t tick)
+{
+	if (!replay || !state || tick > replay->ticks || state->width != replay->width
+	    || state->height != replay->height) {
+		return 0;
+	}
+	uint32_t keyframe = (uint32_t)(tick / replay->interval);
+	if (keyframe >= replay->keyframes) {
+		keyframe = replay->keyframes - 1;
+	}
+	if (!rp_restore(replay, state, keyframe)) {
+		return 0;
+	}
+	for (uint64_t at = replay->index[keyframe].tick + 1; at <= tick; at++) {
+		gs_step(state, rp_move(replay, at));
+	}
+	return 1;
+}
+
+/*
+ * Checks the segment before keyframe next by playing it from the keyframe before
+ * \RETURNS: 1 if the game arrives at keyframe next, 0 if it does not
+ */
+static short rp_check_segment(rp_worker *const worker, const uint32_t next)
+{
+	const replay *replay = worker->replay;
+	if (!rp_restore(replay, worker->state, next - 1)) {
+		return 0;
+	}
+	for (uint64_t at = replay->index[next - 1].tick + 1; at <= replay->index[next].tick; at++) {
+		gs_step(worker->state, rp_move(replay, at));
+	}
+	const rp_entry *entry = &replay->index[next];
+	size_t size = gs_pack(worker->state, worker->packed, worker->packed_capacity);
+	return size == entry->size
+	       && memcmp(worker->packed, (const char *)replay->header + entry->offset, size) == 0;
+}
+
+static void *rp_worker_thread(void *args)
+{
+	rp_worker *worker = args;
+	while (1) {
+		uint32_t next = __atomic_add_fetch(worker->next, 1, __ATOMIC_RELAXED);
+		if (next >= worker->replay->keyframes) {
+			return NULL;
+		}
+		if (!rp_check_segment(worker, next)) {
+			worker->first = worker->failed ? worker->first : next - 1;
+			worker->failed++;
+		}
+	}
+}
+
+uint32_t rp_verify(const replay *const replay, const size_t threads)
+{
+	if (!replay || threads < 1) {
+		return 0;
+	}
+	uint32_t failed = 0;
+	uint32_t next = 0;
+	size_t started = 0;
+	rp_worker *workers = a_calloc(ALLOCATOR_TAG_REPLAY, threads, sizeof(rp_worker));
+	if (!workers) {
+		perror("ERROR: replay workers malloc failed\n");
+		return replay->keyframes;
+	}
+	size_t packed_capacity = gs_packed_size(replay->width, replay->height);
+	for (size_t i = 0; i < threads; i++) {
+		workers[i].replay = replay;
+		workers[i].next = &next;
+		workers[i].state = gs_malloc(replay->width, replay->height);
+		workers[i].packed = a_malloc(ALLOCATOR_TAG_REPLAY, packed_capacity);
+		workers[i].packed_capacity = packed_capacity;
+		if (!workers[i].state || !workers[i].packed) {
+			perror("ERROR: replay worker buffers malloc failed\n");
+			failed = replay->keyframes;
+			goto rp_verify_free;
+		}
+	}
+	/* The calling thread checks segments too, as the first worker */
+	for (started = 1; started < threads; started++) {
+		if (pthread_create(&workers[started].thread, NULL, rp_worker_thread,
+				   &workers[started])) {
+			fprintf(stderr, "ERROR: creating replay worker failed\n");
+			break;
+		}
+	}
+	rp_worker_thread(&workers[0]);
+	uint32_t first = replay->keyframes;
+	for (size_t i = 0; i < threads; i++) {
+		if (i > 0 && i < started) {
+			pthread_join(workers[i].thread, NULL);
+		}
+		failed += workers[i].failed;
+		if (workers[i].failed && workers[i].first < first) {
+			first = workers[i].first;
+		}
+	}
+	if (failed) {
+		fprintf(stderr, "ERROR: replay segment from keyframe %u at tick %llu differs\n",
+			first, (unsigned long long)replay->index[first].tick);
+	}
+
+rp_verify_free:
+	for (size_t i = 0; i < threads; i++) {
+		gs_free(&workers[i].state);
+		a_free(ALLOCATOR_TAG_REPLAY, workers[i].packed, packed_capacity);
+	}
+	a_free(ALLOCATOR_TAG_REPLAY, workers, threads * sizeof(rp_worker));
+	return failed;
+}
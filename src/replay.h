@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include "game_state.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define REPLAY_MAGIC "SNAKEREP"
+
+#define REPLAY_VERSION 1
+
+/*
+ * Ticks between two keyframes, a seek simulates at most this many ticks
+ */
+#define REPLAY_INTERVAL 256
+
+/*
+ * Moves packed into a byte, 2 bits each
+ */
+#define REPLAY_MOVES_PER_BYTE 4
+
+/*
+ * Start of a replay file, in host byte order.
+ * Header is followed by the walls of the map the game was played on, walls_words 64-bit words
+ * laid out like the bitmaps of game states, none without a map. Segments follow, each is
+ * a keyframe, a packed game state, and the moves of the ticks up to the next keyframe.
+ * Index at its offset holds an entry for each of the keyframes, the first at tick 0 and the
+ * last at ticks, the last tick of the game. Size is the size of the whole file
+ */
+typedef struct rp_header {
+	char magic[8];
+	uint32_t version;
+	uint16_t width;
+	uint16_t height;
+	uint32_t interval;
+	uint32_t keyframes;
+	uint32_t walls_words;
+	uint32_t reserved;
+	uint64_t ticks;
+	uint64_t index;
+	uint64_t size;
+} rp_header;
+
+/*
+ * Index entry of a keyframe, offset of its packed state in the file and the size of it.
+ * The moves of the following ticks start at the next multiple of 8 bytes after the state,
+ * move of tick t + 1 is the 2 bits t % 4 of byte t / 4 counted from the keyframe tick,
+ * stored as the move minus SNAKE_MOVE_UP
+ */
+typedef struct rp_entry {
+	uint64_t tick;
+	uint64_t offset;
+	uint64_t size;
+} rp_entry;
+
+/*
+ * Writes the replay of a game of a snake as it is played.
+ * Keyframes are taken from snapshots of the snake, so a verified replay shows that gs_step
+ * plays the recorded moves into the same states the game went through.
+ * State is the last keyframe taken, packed its packed copy waiting for the moves after it,
+ * moves those moves and index the entries of every keyframe so far.
+ * Failed is set once a write failed, the file is then not a valid replay
+ */
+typedef struct rp_recorder {
+	FILE *file;
+	const struct snake *snake;
+	game_state *state;
+	uint32_t interval;
+	uint8_t direction;
+	short finished;
+	short failed;
+	uint64_t ticks;
+	uint64_t offset;
+	void *packed;
+	size_t packed_size;
+	size_t packed_capacity;
+	uint8_t *moves;
+	rp_entry *index;
+	uint32_t keyframes;
+	uint32_t index_capacity;
+} rp_recorder;
+
+/*
+ * Replay file mapped into memory, walls and index point into the mapping
+ */
+typedef struct replay {
+	int width;
+	int height;
+	uint32_t interval;
+	uint32_t keyframes;
+	uint64_t ticks;
+	size_t size;
+	const rp_header *header;
+	const uint64_t *walls;
+	const rp_entry *index;
+} replay;
+
+/*
+ * Starts recording the game snake has just started to path, with a keyframe every interval
+ * ticks. Snakes with a food set can not be recorded, game states keep only one food
+ * \RETURNS: pointer to the recorder, NULL on failure
+ */
+rp_recorder *rp_open(const char *const path, const struct snake *const snake,
+		     const uint32_t interval);
+
+/*
+ * Records the tick snake has just played with move, alive is 0 if the snake died in it.
+ * The replay is finished after the death
+ */
+void rp_record(rp_recorder *const recorder, const m_snake_move move, const short alive);
+
+/*
+ * Finishes the replay with a keyframe of the current tick unless the snake died,
+ * writes the index and frees the recorder
+ * \RETURNS: 1 if the file was written, 0 on failure
+ */
+short rp_close(rp_recorder **recorder);
+
+/*
+ * Maps the replay file at path and checks its header and index
+ * \RETURNS: pointer to the replay, NULL if the file can not be read or is not a valid replay
+ */
+replay *rp_load(const char *const path);
+
+/*
+ * Unmaps given replay
+ */
+void rp_free(replay **replay);
+
+/*
+ * RETURNS: move played in tick, which has to be between 1 and the ticks of the replay
+ */
+m_snake_move rp_move(const replay *const replay, const uint64_t tick);
+
+/*
+ * Puts the game at tick into state, created for the board of the replay, by restoring the
+ * keyframe at or before tick and playing the moves after it
+ * \RETURNS: 1 on success, 0 if tick is past the end or the keyframe is not valid
+ */
+short rp_seek(const replay *const replay, game_state *const state, const uint64_t tick);
+
+/*
+ * Plays the moves of every segment from its keyframe and compares the result with the next
+ * keyframe, threads check segments in parallel. The first segment that differs is reported
+ * to stderr
+ * \RETURNS: number of segments that differ, 0 if the replay is consistent
+ */
+uint32_t rp_verify(const replay *const replay, const size_t threads);
+
+#endif
@@ -0,0 +1,643 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include "server.h"
+#include "input.h"
+#include "protocol.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+server *sv_malloc(void)
+{
+	struct server *server = malloc(sizeof(struct server));
+	if (!server) {
+		perror("ERROR: server malloc failed\n");
+		return NULL;
+	}
+	server->listen_fd = -1;
+	server->stop_fd = -1;
+	server->path = NULL;
+	server->room_count = 0;
+	server->worker_count = 0;
+	server->rooms = NULL;
+	server->workers = NULL;
+	return server;
+}
+
+/*
+ * Adds file descriptor to the epoll instance of the worker
+ * \RETURNS: 1 on success, 0 on failure
+ */
+static short sv_watch(const sv_worker *const worker, const int fd, const uint32_t events,
+		      void *const data)
+{
+	struct epoll_event event = { .events = events, .data.ptr = data };
+	if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+		perror("ERROR: epoll_ctl failed\n");
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * Creates room with an empty board
+ * \RETURNS: pointer to the newly created room
+ */
+static sv_room *sv_room_malloc(const size_t id, const int width, const int height)
+{
+	sv_room *room = calloc(1, sizeof(struct sv_room));
+	if (!room) {
+		perror("ERROR: room calloc failed\n");
+		return NULL;
+	}
+	room->board = b_malloc(width, height);
+	if (!room->board) {
+		free(room);
+		return NULL;
+	}
+	room->id = id;
+	tw_timer_initialize(&room->timer, sv_room_tick, room);
+	return room;
+}
+
+short sv_initialize(server *const server, const char *const path, const int width,
+		    const int height, const size_t room_count, const size_t worker_count)
+{
+	/* A worker without rooms could not accept, the pending connection would keep waking it */
+	if (!server || !path || room_count == 0 || worker_count == 0
+	    || worker_count > SERVER_MAX_WORKERS || worker_count > room_count) {
+		return 0;
+	}
+	struct sockaddr_un address = { .sun_family = AF_UNIX };
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		fprintf(stderr, "ERROR: socket path is too long\n");
+		return 0;
+	}
+	strcpy(address.sun_path, path);
+	if (width < 1 || height < 1 || (size_t)width * (size_t)height > SERVER_MAX_CELLS) {
+		fprintf(stderr, "ERROR: board can have at most %zu cells\n", SERVER_MAX_CELLS);
+		return 0;
+	}
+
+	server->rooms = calloc(room_count, sizeof(struct sv_room *));
+	server->workers = calloc(worker_count, sizeof(struct sv_worker));
+	if (!server->rooms || !server->workers) {
+		perror("ERROR: server calloc failed\n");
+		return 0;
+	}
+	server->room_count = room_count;
+	server->worker_count = worker_count;
+	/* Set before anything can fail, sv_free closes every worker epoll_fd that is not -1 */
+	for (size_t i = 0; i < worker_count; i++) {
+		server->workers[i].server = server;
+		server->workers[i].epoll_fd = -1;
+	}
+	for (size_t i = 0; i < worker_count; i++) {
+		sv_worker *worker = &server->workers[i];
+		worker->rooms = calloc(room_count / worker_count + 1, sizeof(struct sv_room *));
+		if (!worker->rooms) {
+			perror("ERROR: worker calloc failed\n");
+			return 0;
+		}
+	}
+	for (size_t i = 0; i < room_count; i++) {
+		server->rooms[i] = sv_room_malloc(i, width, height);
+		if (!server->rooms[i]) {
+			return 0;
+		}
+		sv_worker *worker = &server->workers[i % worker_count];
+		server->rooms[i]->worker = worker;
+		worker->rooms[worker->room_count++] = server->rooms[i];
+	}
+
+	server->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if (server->listen_fd < 0) {
+		perror("ERROR: socket failed\n");
+		return 0;
+	}
+	unlink(path);
+	if (bind(server->listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0
+	    || listen(server->listen_fd, SOMAXCONN) != 0) {
+		perror("ERROR: socket bind failed\n");
+		return 0;
+	}
+	server->path = path;
+
+	server->stop_fd = eventfd(0, EFD_NONBLOCK);
+	if (server->stop_fd < 0) {
+		perror("ERROR: eventfd failed\n");
+		return 0;
+	}
+
+	for (size_t i = 0; i < worker_count; i++) {
+		sv_worker *worker = &server->workers[i];
+		worker->epoll_fd = epoll_create1(0);
+		if (worker->epoll_fd < 0) {
+			perror("ERROR: epoll_create1 failed\n");
+			return 0;
+		}
+		/* Only one worker is woken up for each incoming connection */
+		if (!sv_watch(worker, server->listen_fd, EPOLLIN | EPOLLEXCLUSIVE, &server->listen_fd)
+		    || !sv_watch(worker, server->stop_fd, EPOLLIN, &server->stop_fd)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+void sv_free(server **server)
+{
+	if (!server || !*server) {
+		return;
+	}
+	for (size_t i = 0; i < (*server)->worker_count; i++) {
+		sv_worker *worker = &(*server)->workers[i];
+		sv_free_removed(worker);
+		if (worker->epoll_fd >= 0) {
+			close(worker->epoll_fd);
+		}
+		free(worker->rooms);
+	}
+	for (size_t i = 0; i < (*server)->room_count; i++) {
+		sv_room *room = (*server)->rooms[i];
+		if (!room) {
+			continue;
+		}
+		for (size_t j = 0; j < SERVER_MAX_PLAYERS; j++) {
+			sv_player *player = room->players[j];
+			if (player) {
+				close(player->fd);
+				s_free(&player->snake);
+				m_free(&player->monitor);
+				free(player);
+			}
+		}
+		b_free(&room->board);
+		free(room);
+	}
+	if ((*server)->stop_fd >= 0) {
+		close((*server)->stop_fd);
+	}
+	if ((*server)->listen_fd >= 0) {
+		close((*server)->listen_fd);
+		if ((*server)->path) {
+			unlink((*server)->path);
+		}
+	}
+	free((*server)->rooms);
+	free((*server)->workers);
+	free(*server);
+	*server = NULL;
+}
+
+void sv_run(server *const server)
+{
+	if (!server) {
+		return;
+	}
+	/* Workers inherit the mask, so only sigwait below receives the signals */
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+	size_t started = 0;
+	while (started < server->worker_count) {
+		sv_worker *worker = &server->workers[started];
+		if (pthread_create(&worker->thread, NULL, sv_worker_run, worker) != 0) {
+			perror("Worker thread create failed:\n");
+			break;
+		}
+		started++;
+	}
+	if (started == server->worker_count) {
+		int signal;
+		sigwait(&signals, &signal);
+	}
+
+	uint64_t stop = 1;
+	if (write(server->stop_fd, &stop, sizeof(stop)) < 0) {
+		perror("ERROR: stop write failed\n");
+	}
+	for (size_t i = 0; i < started; i++) {
+		if (pthread_join(server->workers[i].thread, NULL) != 0) {
+			perror("Worker thread join failed:\n");
+		}
+	}
+}
+
+void *sv_worker_run(void *args)
+{
+	if (!args) {
+		return NULL;
+	}
+	sv_worker *worker = (struct sv_worker *)args;
+	server *server = worker->server;
+	tw_initialize(&worker->wheel, tw_now());
+
+	struct epoll_event events[SERVER_EVENTS];
+	while (1) {
+		int64_t timeout = tw_next_timeout(&worker->wheel, tw_now());
+		/* Rounded up, waking before the deadline would only spin */
+		int timeout_ms = timeout < 0 ? -1 : (int)((timeout + 999999) / 1000000);
+		int count = epoll_wait(worker->epoll_fd, events, SERVER_EVENTS, timeout_ms);
+		if (count < 0 && errno != EINTR) {
+			perror("ERROR: epoll_wait failed\n");
+			return NULL;
+		}
+		for (int i = 0; i < count; i++) {
+			void *data = events[i].data.ptr;
+			if (data == &server->stop_fd) {
+				return NULL;
+			}
+			if (data == &server->listen_fd) {
+				sv_accept(worker);
+				continue;
+			}
+			sv_player *player = data;
+			if (player->removed) {
+				continue;
+			}
+			if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+				sv_remove_player(player);
+				continue;
+			}
+			if ((events[i].events & EPOLLOUT) && !sv_flush(player)) {
+				sv_remove_player(player);
+				continue;
+			}
+			if (events[i].events & EPOLLIN) {
+				sv_handle_input(player);
+			}
+		}
+		tw_advance(&worker->wheel, tw_now());
+		sv_free_removed(worker);
+	}
+}
+
+/*
+ * Finds a free cell with a free cell to the right of it for a new snake
+ * \RETURNS: 1 if such cell was found, 0 if not
+ */
+static short sv_find_spawn(const board *const board, unsigned int *const seed,
+			   s_coordinates *const spawn)
+{
+	for (int i = 0; i < 128; i++) {
+		int x = rand_r(seed) % (board->width - 4) + 1;
+		int y = rand_r(seed) % (board->height - 2) + 1;
+		if (b_cell_get(board, x, y) == BOARD_CELL_EMPTY
+		    && b_cell_get(board, x + 1, y) == BOARD_CELL_EMPTY) {
+			*spawn = (s_coordinates){ x, y };
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Appends record of the room to the frame sent on the next tick, a record that does not fit
+ * leaves the clients out of sync, so the next tick sends them the whole game instead
+ */
+static void sv_room_record(sv_room *const room, const enum p_record_type type,
+			   const sv_player *const player)
+{
+	size_t length = p_encode_body(room->frame + room->frame_length,
+				      sizeof(room->frame) - room->frame_length, type, player->id,
+				      player->snake);
+	if (!length) {
+		room->resync = 1;
+	}
+	room->frame_length += length;
+}
+
+/*
+ * Sends the player a welcome, which clears its board, and keyframes of the players in the room
+ * other than skip
+ * \RETURNS: 1 on success, 0 if the player could not take all of it
+ */
+static short sv_send_game(sv_room *const room, sv_player *const player,
+			  const sv_player *const skip)
+{
+	char buffer[SERVER_OUTPUT_SIZE];
+	size_t length = p_encode_welcome(buffer, sizeof(buffer), player->id, room->board->width,
+					 room->board->height);
+	if (!sv_send(player, buffer, length)) {
+		return 0;
+	}
+	for (size_t i = 0; i < SERVER_MAX_PLAYERS; i++) {
+		sv_player *other = room->players[i];
+		if (!other || other == skip) {
+			continue;
+		}
+		length = p_encode_body(buffer, sizeof(buffer), RECORD_KEYFRAME, other->id,
+				       other->snake);
+		if (!length || !sv_send(player, buffer, length)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Sends the frame to every player of the room and starts a new one,
+ * players removed on the way append their leave records to the new frame
+ */
+static void sv_room_flush(sv_room *const room)
+{
+	char frame[SERVER_OUTPUT_SIZE];
+	size_t frame_length = room->frame_length;
+	memcpy(frame, room->frame, frame_length);
+	room->frame_length = 0;
+	for (size_t i = 0; i < SERVER_MAX_PLAYERS && frame_length > 0; i++) {
+		sv_player *player = room->players[i];
+		if (player && !sv_send(player, frame, frame_length)) {
+			sv_remove_player(player);
+		}
+	}
+}
+
+/*
+ * Replaces the pending frame, which is missing records, with the whole game sent to every player
+ */
+static void sv_room_resync(sv_room *const room)
+{
+	room->resync = 0;
+	room->frame_length = 0;
+	for (size_t i = 0; i < SERVER_MAX_PLAYERS; i++) {
+		sv_player *player = room->players[i];
+		if (player && !sv_send_game(room, player, NULL)) {
+			sv_remove_player(player);
+		}
+	}
+}
+
+/*
+ * Creates a player in the room and sends it the current game
+ * \RETURNS: 1 on success, 0 on failure
+ */
+static short sv_add_player(sv_worker *const worker, sv_room *const room, const int fd)
+{
+	size_t slot = 0;
+	while (slot < SERVER_MAX_PLAYERS && room->players[slot]) {
+		slot++;
+	}
+	unsigned int seed = (unsigned int)tw_now();
+	s_coordinates spawn;
+	if (slot == SERVER_MAX_PLAYERS || !sv_find_spawn(room->board, &seed, &spawn)) {
+		return 0;
+	}
+	sv_player *player = malloc(sizeof(struct sv_player));
+	if (!player) {
+		perror("ERROR: player malloc failed\n");
+		return 0;
+	}
+	player->fd = fd;
+	player->id = (uint16_t)slot;
+	player->playing = 1;
+	player->writing = 0;
+	player->removed = 0;
+	player->room = room;
+	player->next_removed = NULL;
+	player->output_length = 0;
+	player->snake = s_malloc();
+	player->monitor = m_malloc();
+	if (!player->snake || !player->monitor || !sv_watch(worker, fd, EPOLLIN, player)) {
+		s_free(&player->snake);
+		m_free(&player->monitor);
+		free(player);
+		return 0;
+	}
+	m_initialize(player->monitor);
+	s_initialize_at(player->snake, room->board, spawn);
+	room->players[slot] = player;
+	if (room->player_count++ == 0) {
+		room->deadline = tw_now() + (uint64_t)SNAKE_MOVE_INTERVAL;
+		tw_add(&worker->wheel, &room->timer, room->deadline);
+	}
+
+	if (!sv_send_game(room, player, player)) {
+		sv_remove_player(player);
+		return 1;
+	}
+	sv_room_record(room, RECORD_KEYFRAME, player);
+	return 1;
+}
+
+void sv_accept(sv_worker *const worker)
+{
+	if (!worker || worker->room_count == 0) {
+		return;
+	}
+	while (1) {
+		int fd = accept4(worker->server->listen_fd, NULL, NULL, SOCK_NONBLOCK);
+		if (fd < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				perror("ERROR: accept failed\n");
+			}
+			return;
+		}
+		/* Rooms are filled round robin, skipping the ones without space */
+		short added = 0;
+		for (size_t i = 0; i < worker->room_count && !added; i++) {
+			sv_room *room = worker->rooms[worker->room_next];
+			worker->room_next = (worker->room_next + 1) % worker->room_count;
+			added = sv_add_player(worker, room, fd);
+		}
+		if (!added) {
+			close(fd);
+		}
+	}
+}
+
+void sv_handle_input(sv_player *const player)
+{
+	if (!player) {
+		return;
+	}
+	unsigned char input[SERVER_INPUT_SIZE];
+	ssize_t length = recv(player->fd, input, sizeof(input), 0);
+	if (length == 0 || (length < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+		sv_remove_player(player);
+		return;
+	}
+	for (ssize_t i = 0; i < length; i++) {
+		enum m_snake_move move = (enum m_snake_move)input[i];
+		if (move == SNAKE_MOVE_EMPTY || move > SNAKE_MOVE_LEFT) {
+			continue;
+		}
+		i_handle_snake_move(player->monitor, move, s_get_opposite_move(move));
+	}
+}
+
+void sv_room_tick(tw_timer *const timer, void *const data)
+{
+	if (!timer || !data) {
+		return;
+	}
+	sv_room *room = (struct sv_room *)data;
+	uint64_t now = tw_now();
+	u_jitter_add(&room->jitter, now > room->deadline ? now - room->deadline : 0);
+	room->deadline += (uint64_t)SNAKE_MOVE_INTERVAL;
+	if (room->deadline <= now) {
+		room->deadline = now + (uint64_t)SNAKE_MOVE_INTERVAL;
+	}
+	tw_add(&room->worker->wheel, timer, room->deadline);
+	if (room->resync) {
+		sv_room_resync(room);
+	}
+
+	for (size_t i = 0; i < SERVER_MAX_PLAYERS; i++) {
+		sv_player *player = room->players[i];
+		if (!player || !player->playing) {
+			continue;
+		}
+		s_handle_signal(player->snake, player->monitor);
+		enum m_signal_windows signal = s_advance(player->snake,
+							 player->monitor->snake_alive);
+		if (signal == SIGNAL_WINDOWS_SNAKE_DIED) {
+			player->playing = 0;
+		}
+		size_t length = p_encode_delta(room->frame + room->frame_length,
+					       sizeof(room->frame) - room->frame_length, player->id,
+					       signal, player->snake);
+		if (!length) {
+			/* Frame is full of join and leave records, they are sent ahead of the deltas */
+			sv_room_flush(room);
+			length = p_encode_delta(room->frame + room->frame_length,
+						sizeof(room->frame) - room->frame_length, player->id,
+						signal, player->snake);
+		}
+		if (!length) {
+			room->resync = 1;
+		}
+		room->frame_length += length;
+		/* Clients clear the tail once, same as w_snake_clear_tail does locally */
+		player->snake->tail = (s_coordinates){ -1, -1 };
+	}
+
+	sv_room_flush(room);
+}
+
+short sv_send(sv_player *const player, const void *const data, const size_t length)
+{
+	if (!player || !data) {
+		return 0;
+	}
+	if (length > SERVER_OUTPUT_SIZE - player->output_length) {
+		return 0;
+	}
+	memcpy(player->output + player->output_length, data, length);
+	player->output_length += length;
+	if (player->writing) {
+		return 1;
+	}
+	return sv_flush(player);
+}
+
+short sv_flush(sv_player *const player)
+{
+	if (!player) {
+		return 0;
+	}
+	size_t written = 0;
+	while (written < player->output_length) {
+		ssize_t result = send(player->fd, player->output + written,
+				      player->output_length - written, MSG_NOSIGNAL);
+		if (result < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			}
+			return 0;
+		}
+		written += (size_t)result;
+	}
+	player->output_length -= written;
+	memmove(player->output, player->output + written, player->output_length);
+
+	short writing = player->output_length > 0;
+	if (writing != player->writing) {
+		struct epoll_event event = { .events = EPOLLIN | (writing ? EPOLLOUT : 0),
+					     .data.ptr = player };
+		epoll_ctl(player->room->worker->epoll_fd, EPOLL_CTL_MOD, player->fd, &event);
+		player->writing = writing;
+	}
+	return 1;
+}
+
+void sv_remove_player(sv_player *const player)
+{
+	if (!player || player->removed) {
+		return;
+	}
+	sv_room *room = player->room;
+	sv_worker *worker = room->worker;
+	player->removed = 1;
+	player->next_removed = worker->removed;
+	worker->removed = player;
+	room->players[player->id] = NULL;
+	if (--room->player_count == 0) {
+		tw_cancel(&worker->wheel, &room->timer);
+	}
+	epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, player->fd, NULL);
+	close(player->fd);
+
+	sv_room_record(room, RECORD_LEAVE, player);
+	s_clear_snake_body(player->snake);
+}
+
+void sv_free_removed(sv_worker *const worker)
+{
+	if (!worker) {
+		return;
+	}
+	while (worker->removed) {
+		sv_player *player = worker->removed;
+		worker->removed = player->next_removed;
+		s_free(&player->snake);
+		m_free(&player->monitor);
+		free(player);
+	}
+}
+
+void sv_report(const server *const server, FILE *const stream)
+{
+	if (!server || !stream) {
+		return;
+	}
+	for (size_t i = 0; i < server->room_count; i++) {
+		char label[32];
+		snprintf(label, sizeof(label), "room %zu", i);
+		u_jitter_report(stream, label, &server->rooms[i]->jitter);
+	}
+}
@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include "board.h"
+#include "monitor.h"
+#include "protocol.h"
+#include "snake.h"
+#include "timing_wheel.h"
+#include "usage.h"
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Maximum number of simultaneously connected players in a room
+ */
+#define SERVER_MAX_PLAYERS 256
+
+/*
+ * Maximum number of worker threads
+ */
+#define SERVER_MAX_WORKERS 256
+
+/*
+ * Size of the per player output buffer, a player that falls further
+ * behind is disconnected
+ */
+#define SERVER_OUTPUT_SIZE 65536
+
+/*
+ * Maximum number of board cells. A frame with a delta and a keyframe or leave record of every
+ * player fits the buffer, their bodies never take more cells than the board has.
+ * The whole game sent to a player on join or resync fits it too
+ */
+#define SERVER_MAX_CELLS                                                                 \
+	((SERVER_OUTPUT_SIZE                                                             \
+	  - 2 * SERVER_MAX_PLAYERS * (sizeof(struct p_header) + sizeof(struct p_delta))) \
+	 / sizeof(struct p_point))
+
+/*
+ * Size of the input read from a player at once
+ */
+#define SERVER_INPUT_SIZE 64
+
+/*
+ * Maximum number of events handled per epoll wakeup
+ */
+#define SERVER_EVENTS 64
+
+/*
+ * Default board size
+ */
+#define SERVER_BOARD_WIDTH 80
+#define SERVER_BOARD_HEIGHT 23
+
+/*
+ * Connected player with its own snake and move state
+ */
+typedef struct sv_player {
+	int fd;
+	uint16_t id;
+	short playing;
+	short writing;
+	short removed;
+	struct sv_room *room;
+	struct sv_player *next_removed;
+	snake *snake;
+	monitor *monitor;
+	size_t output_length;
+	char output[SERVER_OUTPUT_SIZE];
+} sv_player;
+
+/*
+ * Authoritative game shared by players of the room.
+ * Frame collects records produced since the last tick,
+ * resync is set when a record did not fit it and every player is sent the whole game instead.
+ * Room only ticks while somebody is connected to it
+ */
+typedef struct sv_room {
+	size_t id;
+	board *board;
+	struct sv_worker *worker;
+	tw_timer timer;
+	uint64_t deadline;
+	size_t player_count;
+	u_jitter jitter;
+	size_t frame_length;
+	short resync;
+	char frame[SERVER_OUTPUT_SIZE];
+	struct sv_player *players[SERVER_MAX_PLAYERS];
+} sv_room;
+
+/*
+ * Thread running its own epoll loop and timing wheel for a subset of the rooms.
+ * Removed players are freed after the current batch of events is handled
+ */
+typedef struct sv_worker {
+	pthread_t thread;
+	struct server *server;
+	int epoll_fd;
+	timing_wheel wheel;
+	size_t room_count;
+	size_t room_next;
+	struct sv_room **rooms;
+	struct sv_player *removed;
+} sv_worker;
+
+/*
+ * Server sharing one listening socket between all workers
+ */
+typedef struct server {
+	int listen_fd;
+	int stop_fd;
+	const char *path;
+	size_t room_count;
+	size_t worker_count;
+	struct sv_room **rooms;
+	struct sv_worker *workers;
+} server;
+
+/*
+ * Creates new server object
+ * \RETURNS: pointer to the newly created server
+ */
+server *sv_malloc(void);
+
+/*
+ * Creates the rooms, workers, listening socket and their epoll instances,
+ * every worker has to own at least one room
+ * \RETURNS: 1 on success, 0 on failure
+ */
+short sv_initialize(server *const server, const char *const path, const int width,
+		    const int height, const size_t room_count, const size_t worker_count);
+
+/*
+ * Disconnects all players and frees the given server object
+ */
+void sv_free(server **server);
+
+/*
+ * Runs workers until SIGINT or SIGTERM is received
+ */
+void sv_run(server *const server);
+
+/*
+ * Runs worker event loop, used as a thread start routine
+ */
+void *sv_worker_run(void *args);
+
+/*
+ * Accepts pending connections into the rooms of the worker
+ */
+void sv_accept(sv_worker *const worker);
+
+/*
+ * Reads moves sent by the player
+ */
+void sv_handle_input(sv_player *const player);
+
+/*
+ * Timer callback advancing every playing snake of the room and broadcasting the frame
+ */
+void sv_room_tick(tw_timer *const timer, void *const data);
+
+/*
+ * Appends data to the player output and tries to flush it
+ * \RETURNS: 1 on success, 0 if the output buffer is full or the socket failed
+ */
+short sv_send(sv_player *const player, const void *const data, const size_t length);
+
+/*
+ * Writes as much of the player output as the socket accepts
+ * \RETURNS: 1 on success, 0 if the socket failed
+ */
+short sv_flush(sv_player *const player);
+
+/*
+ * Disconnects the player and tells others to remove its snake
+ */
+void sv_remove_player(sv_player *const player);
+
+/*
+ * Frees players removed while handling the last batch of events
+ */
+void sv_free_removed(sv_worker *const worker);
+
+/*
+ * Prints tick jitter of every room that has run
+ */
+void sv_report(const server *const server, FILE *const stream);
+
+#endif
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "env_server.h"
+#include "event_log.h"
+#include "protocol.h"
+#include "server.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[])
+{
+	const char *path = PROTOCOL_SOCKET_PATH;
+	int width = SERVER_BOARD_WIDTH;
+	int height = SERVER_BOARD_HEIGHT;
+	long rooms = 1;
+	long workers = 1;
+	const char *log_path = NULL;
+	const char *environment_path = NULL;
+	long environments = 1;
+	int option;
+	while ((option = getopt(argc, argv, "s:W:H:r:t:L:E:n:")) != -1) {
+		switch (option) {
+		case 's':
+			path = optarg;
+			break;
+		case 'W':
+			width = atoi(optarg);
+			break;
+		case 'H':
+			height = atoi(optarg);
+			break;
+		case 'r':
+			rooms = atol(optarg);
+			break;
+		case 't':
+			workers = atol(optarg);
+			break;
+		case 'L':
+			log_path = optarg;
+			break;
+		case 'E':
+			environment_path = optarg;
+			break;
+		case 'n':
+			environments = atol(optarg);
+			break;
+		default:
+			fprintf(stderr,
+				"Usage: %s [-s socket] [-W width] [-H height] [-r rooms] [-t threads]"
+				" [-L event log] [-E shared region -n environments]\n",
+				argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (width < 8 || height < 4) {
+		fprintf(stderr, "ERROR: board has to be at least 8x4\n");
+		return EXIT_FAILURE;
+	}
+	if (rooms < 1 || workers < 1 || workers > SERVER_MAX_WORKERS) {
+		fprintf(stderr, "ERROR: invalid number of rooms or threads\n");
+		return EXIT_FAILURE;
+	}
+	if (workers > rooms) {
+		fprintf(stderr, "ERROR: there can not be more threads than rooms\n");
+		return EXIT_FAILURE;
+	}
+
+	struct timespec time;
+	clock_gettime(CLOCK_REALTIME, &time);
+	srand((unsigned int)time.tv_nsec);
+
+	if (environment_path) {
+		if (environments < 1 || environments > UINT32_MAX) {
+			fprintf(stderr, "ERROR: invalid number of environments\n");
+			return EXIT_FAILURE;
+		}
+		es_region *region = es_create(environment_path, (uint32_t)environments, width, height,
+					      (uint64_t)time.tv_nsec);
+		if (!region) {
+			return EXIT_FAILURE;
+		}
+		es_serve(region);
+		fprintf(stderr, "environment server: %llu steps of %ld environments\n",
+			(unsigned long long)region->header->steps, environments);
+		es_close(&region);
+		return EXIT_SUCCESS;
+	}
+
+	if (log_path && !el_initialize(log_path)) {
+		return EXIT_FAILURE;
+	}
+	server *server = sv_malloc();
+	if (!server) {
+		el_finalize();
+		return EXIT_FAILURE;
+	}
+	int status = EXIT_FAILURE;
+	if (sv_initialize(server, path, width, height, (size_t)rooms, (size_t)workers)) {
+		sv_run(server);
+		sv_report(server, stderr);
+		status = EXIT_SUCCESS;
+	}
+	sv_free(&server);
+	el_finalize();
+	el_report(stderr);
+	return status;
+}
@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "session.h"
+#include "input.h"
+#include "mcts.h"
+#include <errno.h>
+#include <ncurses.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+session *se_malloc(const int width, const int height)
+{
+	struct session *session = malloc(sizeof(struct session));
+	if (!session) {
+		perror("ERROR: session malloc failed\n");
+		return NULL;
+	}
+	session->board = b_malloc(width, height);
+	if (!session->board) {
+		goto se_free_session;
+	}
+	session->snake = s_malloc();
+	if (!session->snake) {
+		goto se_free_board;
+	}
+	session->monitor = m_malloc();
+	if (!session->monitor) {
+		s_free(&session->snake);
+se_free_board:
+		b_free(&session->board);
+se_free_session:
+		free(session);
+		return NULL;
+	}
+	session->wheel = NULL;
+	session->deadline = 0;
+	tw_timer_initialize(&session->timer, NULL, session);
+	return session;
+}
+
+void se_initialize(session *const session, windows *const windows)
+{
+	if (!session) {
+		return;
+	}
+	session->state = SESSION_STATE_INPUT;
+	session->windows = windows;
+	session->snake->hud = windows ? windows->hud : NULL;
+	session->ticks = 0;
+	session->seed = (unsigned int)rand();
+	m_initialize(session->monitor);
+	s_initialize(session->snake, session->board);
+}
+
+void se_free(session **session)
+{
+	if (!session || !*session) {
+		return;
+	}
+	m_free(&(*session)->monitor);
+	s_free(&(*session)->snake);
+	b_free(&(*session)->board);
+	free(*session);
+	*session = NULL;
+}
+
+void se_key(session *const session, const int value)
+{
+	if (!session) {
+		return;
+	}
+	if (session->state == SESSION_STATE_DEAD) {
+		if (value == 'q' || value == 'Q') {
+			session->state = SESSION_STATE_EXIT;
+		}
+		return;
+	}
+	if (session->state != SESSION_STATE_INPUT) {
+		return;
+	}
+	if (i_handle_received_key(session->monitor, value)) {
+		/* Exit is rendered like any other windows signal */
+		session->state = SESSION_STATE_RENDER;
+		se_resume(session);
+	}
+}
+
+void se_tick(session *const session)
+{
+	if (!session || session->state != SESSION_STATE_INPUT) {
+		return;
+	}
+	session->state = SESSION_STATE_TICK;
+	se_resume(session);
+}
+
+void se_resume(session *const session)
+{
+	if (!session) {
+		return;
+	}
+	monitor *monitor = session->monitor;
+	while (1) {
+		switch (session->state) {
+		case SESSION_STATE_TICK:
+			if (s_handle_signal(session->snake, monitor)) {
+				session->state = SESSION_STATE_RENDER;
+				break;
+			}
+			monitor->signal_windows = s_advance(session->snake, monitor->snake_alive);
+			session->ticks++;
+			session->state = SESSION_STATE_RENDER;
+			break;
+		case SESSION_STATE_RENDER: {
+			enum m_signal_windows signal = monitor->signal_windows;
+			if (session->windows) {
+				spectator *spectator = session->windows->spectator;
+				sp_frame *keyframe = sp_keyframe_wanted(spectator)
+							     ? sp_encode_keyframe(session->snake)
+							     : NULL;
+				sp_publish(spectator, signal, session->snake, keyframe);
+				sp_frame_release(keyframe);
+				w_handle_signal(session->windows, monitor, session->snake);
+			}
+			monitor->signal_windows = SIGNAL_WINDOWS_EMPTY;
+			if (signal == SIGNAL_WINDOWS_GAME_EXIT) {
+				session->state = SESSION_STATE_EXIT;
+			} else if (signal == SIGNAL_WINDOWS_SNAKE_DIED) {
+				session->state = SESSION_STATE_DEAD;
+			} else {
+				session->state = SESSION_STATE_INPUT;
+			}
+			break;
+		}
+		default:
+			return;
+		}
+	}
+}
+
+void se_restart(session *const session)
+{
+	if (!session) {
+		return;
+	}
+	unsigned long ticks = session->ticks;
+	s_clear_snake_body(session->snake);
+	se_initialize(session, session->windows);
+	session->ticks = ticks;
+}
+
+size_t se_memory_usage(const session *const session)
+{
+	if (!session) {
+		return 0;
+	}
+	return sizeof(struct session) + sizeof(struct snake) + sizeof(struct monitor)
+	       + s_body_memory_usage(session->snake) + b_memory_usage(session->board);
+}
+
+void se_run_interactive(session *const session)
+{
+	if (!session || !session->windows) {
+		return;
+	}
+	int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+	if (timer_fd < 0) {
+		perror("ERROR: timerfd_create failed\n");
+		return;
+	}
+	struct itimerspec interval = { { 0, (long)SNAKE_MOVE_INTERVAL },
+				       { 0, (long)SNAKE_MOVE_INTERVAL } };
+	timerfd_settime(timer_fd, 0, &interval, NULL);
+	uint64_t deadline = tw_now() + (uint64_t)SNAKE_MOVE_INTERVAL;
+	nodelay(stdscr, 1);
+
+	w_snake_display_head(session->windows, session->snake, COLOR_PAIR_GREEN);
+	w_snake_display_food(session->windows, session->snake);
+	wrefresh(session->windows->game);
+
+	struct pollfd fds[] = { { .fd = STDIN_FILENO, .events = POLLIN },
+				{ .fd = timer_fd, .events = POLLIN } };
+	while (session->state != SESSION_STATE_EXIT) {
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror("ERROR: poll failed\n");
+			break;
+		}
+		/* Keys are handled first so a move pressed before the deadline is not late */
+		if (fds[0].revents) {
+			int value;
+			while ((value = getch()) != ERR) {
+				se_key(session, value);
+			}
+		}
+		uint64_t expirations;
+		if (fds[1].revents && read(timer_fd, &expirations, sizeof(expirations)) > 0) {
+			/* Lateness is measured from the last expiration, earlier ones were missed */
+			deadline += (expirations - 1) * (uint64_t)SNAKE_MOVE_INTERVAL;
+			uint64_t now = tw_now();
+			u_jitter_add(&session->snake->jitter, now > deadline ? now - deadline : 0);
+			deadline += (uint64_t)SNAKE_MOVE_INTERVAL;
+			se_tick(session);
+			if (session->snake->bot && session->state == SESSION_STATE_INPUT) {
+				mc_think(session->snake->bot, session->snake, session->monitor);
+			}
+		}
+	}
+	close(timer_fd);
+}
+
+/*
+ * Timer callback feeding random input to the headless session and ticking it
+ */
+static void se_headless_tick(tw_timer *const timer, void *const data)
+{
+	static const int keys[] = { KEY_UP, KEY_DOWN, KEY_LEFT, KEY_RIGHT };
+	session *session = (struct session *)data;
+	if (rand_r(&session->seed) % 4 == 0) {
+		se_key(session, keys[rand_r(&session->seed) % 4]);
+	}
+	se_tick(session);
+	if (session->state == SESSION_STATE_DEAD || session->state == SESSION_STATE_EXIT) {
+		se_restart(session);
+	}
+	session->deadline += (uint64_t)SNAKE_MOVE_INTERVAL;
+	tw_add(session->wheel, timer, session->deadline);
+}
+
+void se_run_headless(session **const sessions, const size_t count, const uint64_t duration)
+{
+	if (!sessions || count == 0) {
+		return;
+	}
+	timing_wheel wheel;
+	uint64_t start = tw_now();
+	tw_initialize(&wheel, start);
+	for (size_t i = 0; i < count; i++) {
+		sessions[i]->wheel = &wheel;
+		tw_timer_initialize(&sessions[i]->timer, se_headless_tick, sessions[i]);
+		/* Deadlines are spread so sessions do not all wake up at once */
+		sessions[i]->deadline = start + (uint64_t)SNAKE_MOVE_INTERVAL * i / count;
+		tw_add(&wheel, &sessions[i]->timer, sessions[i]->deadline);
+	}
+
+	uint64_t now = start;
+	while (now - start < duration) {
+		int64_t timeout = tw_next_timeout(&wheel, now);
+		if (timeout > 0) {
+			struct timespec sleep_time = { (time_t)(timeout / 1000000000),
+						       (long)(timeout % 1000000000) };
+			nanosleep(&sleep_time, NULL);
+		}
+		now = tw_now();
+		tw_advance(&wheel, now);
+	}
+	for (size_t i = 0; i < count; i++) {
+		tw_cancel(&wheel, &sessions[i]->timer);
+		sessions[i]->wheel = NULL;
+	}
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __SESSION_H__
+#define __SESSION_H__
+
+#include "board.h"
+#include "monitor.h"
+#include "snake.h"
+#include "timing_wheel.h"
+#include "windows.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Session states, a session only waits for events in input and dead states
+ */
+typedef enum se_state {
+	SESSION_STATE_INPUT,
+	SESSION_STATE_TICK,
+	SESSION_STATE_RENDER,
+	SESSION_STATE_DEAD,
+	SESSION_STATE_EXIT
+} se_state;
+
+/*
+ * Single game driven as a state machine by an event loop instead of threads.
+ * Monitor is only used for its move state and is never locked,
+ * windows are NULL for headless sessions.
+ * Wheel is the timing wheel of the loop driving the session
+ */
+typedef struct session {
+	enum se_state state;
+	monitor *monitor;
+	snake *snake;
+	board *board;
+	windows *windows;
+	timing_wheel *wheel;
+	tw_timer timer;
+	uint64_t deadline;
+	unsigned long ticks;
+	unsigned int seed;
+} session;
+
+/*
+ * Creates new session with its own board of given size
+ * \RETURNS: pointer to the newly created session
+ */
+session *se_malloc(const int width, const int height);
+
+/*
+ * Initializes session to the start of a new game rendered to given windows
+ */
+void se_initialize(session *const session, windows *const windows);
+
+/*
+ * Frees the given session
+ */
+void se_free(session **session);
+
+/*
+ * Handles pressed key while session waits for events
+ */
+void se_key(session *const session, const int value);
+
+/*
+ * Makes session run its next tick
+ */
+void se_tick(session *const session);
+
+/*
+ * Runs session states until it has to wait for the next event
+ */
+void se_resume(session *const session);
+
+/*
+ * Clears the board and starts a new game in the same session, keeping the tick count
+ */
+void se_restart(session *const session);
+
+/*
+ * RETURNS: number of bytes owned by the session
+ */
+size_t se_memory_usage(const session *const session);
+
+/*
+ * Runs interactive session on the calling thread until the user exits.
+ * Waits with poll on a timerfd for tick deadlines and on stdin for keys,
+ * so ticks and rendering run back to back without any locking
+ */
+void se_run_interactive(session *const session);
+
+/*
+ * Runs headless sessions on the calling thread for given number of nanoseconds.
+ * Every tick a session may receive a random arrow key, dead sessions are restarted
+ */
+void se_run_headless(session **const sessions, const size_t count, const uint64_t duration);
+
+#endif
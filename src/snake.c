@@ -21,41 +21,153 @@
  */
 
 #include "snake.h"
+#include "allocator.h"
+#include "compact_body.h"
+#include "event_log.h"
+#include "food_set.h"
+#include "hud.h"
+#include "map.h"
+#include "mcts.h"
+#include "replay.h"
+#include "spectator.h"
+#include "timing_wheel.h"
+#include "trace.h"
+#include "zobrist.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+
+/*
+ * RETURNS: index of the cell at coordinates, the way game states and hashes number cells
+ */
+static uint32_t s_cell(const snake *const snake, const s_coordinates coordinates)
+{
+	return (uint32_t)(coordinates.y * snake->max.x + coordinates.x);
+}
+
+/*
+ * RETURNS: 1 if food can not be placed on cell, a wall or the body on maps or other food
+ */
+static short s_food_taken(const snake *const snake, const s_coordinates food)
+{
+	if (snake->foods && fs_has(snake->foods, s_cell(snake, food))) {
+		return 1;
+	}
+	return snake->board && snake->board->map && b_is_blocked(snake->board, food.x, food.y);
+}
+
+/*
+ * Picks a cell for new food from the generator of snake, again while it is taken
+ * RETURNS: the cell, which is still taken if every attempt was
+ */
+static s_coordinates s_roll_food(snake *const snake)
+{
+	s_coordinates food;
+	int attempts = 0;
+	do {
+		food.x = (int)(s_random(&snake->random) % (uint32_t)(snake->max.x - 2)) + 1;
+		food.y = (int)(s_random(&snake->random) % (uint32_t)(snake->max.y - 2)) + 1;
+	} while (++attempts < MAP_FOOD_ATTEMPTS && s_food_taken(snake, food));
+	return food;
+}
+
+/*
+ * RETURNS: move from the newest body segment to the head, which is not pushed yet
+ */
+static m_snake_move s_played_move(const snake *const snake)
+{
+	s_coordinates previous = snake->head;
+	if (snake->compact && snake->compact->length) {
+		previous = snake->compact->head;
+	} else if (!snake->compact && cdq_tail(snake->body)) {
+		previous = *(const s_coordinates *)cdq_tail(snake->body);
+	}
+	if (snake->head.x != previous.x) {
+		return snake->head.x > previous.x ? SNAKE_MOVE_RIGHT : SNAKE_MOVE_LEFT;
+	}
+	if (snake->head.y != previous.y) {
+		return snake->head.y > previous.y ? SNAKE_MOVE_DOWN : SNAKE_MOVE_UP;
+	}
+	return SNAKE_MOVE_EMPTY;
+}
+
+/*
+ * Logs the end of the game the snake plays, if it played one
+ */
+static void s_log_game_end(const snake *const snake)
+{
+	if (!snake->game) {
+		return;
+	}
+	const u_jitter *jitter = &snake->jitter;
+	el_log(EVENT_LOG_GAME_END, snake->game, snake->score, (uint32_t)snake->ticks,
+	       jitter->ticks ? (uint32_t)(jitter->total / jitter->ticks / 1000) : 0,
+	       (uint32_t)(jitter->max / 1000));
+}
 
 snake *s_malloc(void)
 {
-	struct snake *snake = malloc(sizeof(struct snake));
+	struct snake *snake = a_malloc(ALLOCATOR_TAG_SNAKE, sizeof(struct snake));
 	if (!snake) {
 		perror("ERROR: Snake malloc failed\n");
 		return NULL;
 	}
 	snake->body = cdq_malloc(sizeof(s_coordinates));
 	if (!snake->body) {
-		free(snake);
+		a_free(ALLOCATOR_TAG_SNAKE, snake, sizeof(struct snake));
 		return NULL;
 	}
+	snake->compact = NULL;
+	snake->foods = NULL;
+	snake->board = NULL;
+	snake->hud = NULL;
+	snake->bot = NULL;
+	snake->recorder = NULL;
+	snake->ticks = 0;
+	snake->game = 0;
+	s_seed(snake, (uint64_t)rand() << 32 | (uint64_t)rand());
 	return snake;
 }
 
-void s_initialize(snake *const snake, WINDOW *const game_window)
+void s_initialize(snake *const snake, board *const board)
 {
-	if (!snake || !game_window) {
+	if (!snake || !board) {
 		return;
 	}
-	int y_win, x_win;
-	getmaxyx(game_window, y_win, x_win);
-	s_coordinates head = { x_win / 2, y_win / 2 };
-	s_coordinates max = { x_win, y_win };
+	s_coordinates head = { board->width / 2, board->height / 2 };
+	if (board->map) {
+		head = (s_coordinates){ board->map->spawn_x, board->map->spawn_y };
+	}
+	s_initialize_at(snake, board, head);
+}
+
+void s_initialize_at(snake *const snake, board *const board, const s_coordinates head)
+{
+	if (!snake || !board) {
+		return;
+	}
+	s_coordinates max = { board->width, board->height };
 	s_coordinates tail = { -1, -1 };
+	s_coordinates food = { -1, -1 };
 
+	s_log_game_end(snake);
+	snake->game = el_next_game();
+	snake->board = board;
+	snake->food = food;
 	snake->head = head;
 	snake->max = max;
 	snake->tail = tail;
 	snake->score = 0;
+	snake->ticks = 0;
+	snake->hash = 0;
+	memset(&snake->jitter, 0, sizeof(snake->jitter));
 	s_generate_food(snake);
-	cdq_push(snake->body, &head);
+	for (uint32_t i = 1; snake->foods && i < snake->foods->capacity; i++) {
+		s_generate_food(snake);
+	}
+	s_push_snake_head(snake);
+	el_log(EVENT_LOG_GAME_START, snake->game, (uint32_t)head.x, (uint32_t)head.y,
+	       (uint32_t)max.x, (uint32_t)max.y);
 }
 
 void s_free(snake **snake)
@@ -65,9 +177,12 @@ void s_free(snake **snake)
 		return;
 	}
 
+	s_log_game_end(*snake);
 	cdq_free(&((*snake)->body));
 	(*snake)->body = NULL;
-	free(*snake);
+	cb_free(&(*snake)->compact);
+	fs_free(&(*snake)->foods);
+	a_free(ALLOCATOR_TAG_SNAKE, *snake, sizeof(struct snake));
 	*snake = NULL;
 }
 
@@ -77,33 +192,70 @@ void s_move(snake *const snake, monitor *const monitor)
 		return;
 	}
 
-	struct timespec sleep_time;
-	sleep_time.tv_sec = 0;
-	sleep_time.tv_nsec = SNAKE_MOVE_INTERVAL;
-
+	uint64_t deadline = tw_now();
 	while (1) {
-		pthread_mutex_lock(&(monitor->mutex));
+		TRACE_BEGIN(lock);
+		m_lock(monitor, __func__);
+		TRACE_END(lock, "s_move lock wait");
 		if (s_handle_signal(snake, monitor)) {
-			pthread_mutex_unlock(&(monitor->mutex));
+			m_unlock(monitor);
 			return;
 		}
-		pthread_mutex_unlock(&(monitor->mutex));
+		short alive = monitor->snake_alive;
+		m_unlock(monitor);
 
-		if (!monitor->snake_alive) {
-			s_remove_snake_tail(snake);
-			s_signal_windows(monitor, SIGNAL_WINDOWS_SNAKE_DIED);
+		enum m_signal_windows signal = s_advance(snake, alive);
+		s_signal_windows(monitor, signal, snake);
+		if (signal == SIGNAL_WINDOWS_SNAKE_DIED) {
 			return;
 		}
+		if (snake->bot) {
+			mc_think(snake->bot, snake, monitor);
+		}
+		/* Ticks keep a fixed rate, a late tick does not make the following ones early */
+		uint64_t now = tw_now();
+		deadline += (uint64_t)SNAKE_MOVE_INTERVAL;
+		if (deadline < now) {
+			deadline = now + (uint64_t)SNAKE_MOVE_INTERVAL;
+		}
+		if (!m_event_wait(&monitor->snake_event, deadline)) {
+			uint64_t woke = tw_now();
+			u_jitter_add(&snake->jitter, woke > deadline ? woke - deadline : 0);
+		}
+	}
+}
 
-		cdq_push(snake->body, &snake->head);
+enum m_signal_windows s_advance(snake *const snake, const short alive)
+{
+	if (!snake) {
+		return SIGNAL_WINDOWS_EMPTY;
+	}
+	TRACE_SCOPE("s_advance");
+	uint64_t start = snake->hud ? tw_now() : 0;
+	enum m_signal_windows signal = SIGNAL_WINDOWS_SNAKE_REFRESH;
+	m_snake_move move = snake->recorder ? s_played_move(snake) : SNAKE_MOVE_EMPTY;
+	snake->ticks++;
+	if (!alive) {
+		s_remove_snake_tail(snake);
+		signal = SIGNAL_WINDOWS_SNAKE_DIED;
+		el_log(EVENT_LOG_DEATH, snake->game, snake->score, (uint32_t)s_body_length(snake),
+		       (uint32_t)snake->ticks, 0);
+	} else {
+		s_push_snake_head(snake);
 		if (s_handle_food(snake)) {
-			s_signal_windows(monitor, SIGNAL_WINDOWS_SNAKE_AND_FOOD_REFRESH);
+			signal = SIGNAL_WINDOWS_SNAKE_AND_FOOD_REFRESH;
 		} else {
 			s_remove_snake_tail(snake);
-			s_signal_windows(monitor, SIGNAL_WINDOWS_SNAKE_REFRESH);
 		}
-		nanosleep(&sleep_time, NULL);
 	}
+	if (snake->recorder) {
+		rp_record(snake->recorder, move, alive);
+	}
+	if (snake->hud) {
+		h_record_tick(snake->hud, tw_now() - start, s_body_length(snake),
+			      s_body_capacity(snake));
+	}
+	return signal;
 }
 
 short s_handle_signal(snake *const snake, monitor *const monitor)
@@ -135,10 +287,11 @@ void s_handle_move(snake *const snake, monitor *const monitor)
 		return;
 	}
 
-	enum m_snake_move move = SNAKE_MOVE_EMPTY;
-	if (monitor->move_next[0] != SNAKE_MOVE_EMPTY) {
+	/* Move decided by the bot wins over the keys, which are still consumed */
+	enum m_snake_move move = snake->bot ? mc_take(snake->bot) : SNAKE_MOVE_EMPTY;
+	if (move == SNAKE_MOVE_EMPTY && monitor->move_next[0] != SNAKE_MOVE_EMPTY) {
 		move = monitor->move_next[0];
-	} else {
+	} else if (move == SNAKE_MOVE_EMPTY) {
 		move = monitor->move_previous;
 	}
 
@@ -152,6 +305,22 @@ void s_handle_move(snake *const snake, monitor *const monitor)
 	monitor->move_previous = move;
 }
 
+enum m_snake_move s_get_opposite_move(const m_snake_move move)
+{
+	switch (move) {
+	case SNAKE_MOVE_UP:
+		return SNAKE_MOVE_DOWN;
+	case SNAKE_MOVE_DOWN:
+		return SNAKE_MOVE_UP;
+	case SNAKE_MOVE_RIGHT:
+		return SNAKE_MOVE_LEFT;
+	case SNAKE_MOVE_LEFT:
+		return SNAKE_MOVE_RIGHT;
+	default:
+		return SNAKE_MOVE_EMPTY;
+	}
+}
+
 struct s_coordinates s_get_move_offset(const m_snake_move move)
 {
 	switch (move) {
@@ -190,16 +359,8 @@ short s_check_new_location(const snake *const snake, const int x, const int y)
 	if (!snake) {
 		return 0;
 	}
-	if (x < 1 || y < 1 || x > snake->max.x - 2 || y > snake->max.y - 2) {
-		return 0;
-	}
-	for (unsigned int i = 0; i < snake->body->size_current; i++) {
-		s_coordinates *body_part = (struct s_coordinates *)cdq_index(snake->body, i);
-		if (x == body_part->x && y == body_part->y) {
-			return 0;
-		}
-	}
-	return 1;
+	TRACE_SCOPE("s_check_new_location");
+	return !b_is_blocked(snake->board, x, y);
 }
 
 void s_generate_food(snake *const snake)
@@ -207,8 +368,25 @@ void s_generate_food(snake *const snake)
 	if (!snake) {
 		return;
 	}
-	snake->food.x = rand() % (snake->max.x - 2) + 1;
-	snake->food.y = rand() % (snake->max.y - 2) + 1;
+	TRACE_SCOPE("s_generate_food");
+	if (snake->foods) {
+		s_coordinates food = s_roll_food(snake);
+		/* Every attempt landed on food, the set is one item short until the next is eaten */
+		if (!fs_add(snake->foods, s_cell(snake, food))) {
+			return;
+		}
+		snake->food = food;
+		b_cell_set(snake->board, food.x, food.y, BOARD_CELL_FOOD);
+		snake->hash ^= z_key(ZOBRIST_FOOD, s_cell(snake, food));
+		return;
+	}
+	b_cell_clear(snake->board, snake->food.x, snake->food.y, BOARD_CELL_FOOD);
+	if (snake->food.x >= 0) {
+		snake->hash ^= z_key(ZOBRIST_FOOD, s_cell(snake, snake->food));
+	}
+	snake->food = s_roll_food(snake);
+	b_cell_set(snake->board, snake->food.x, snake->food.y, BOARD_CELL_FOOD);
+	snake->hash ^= z_key(ZOBRIST_FOOD, s_cell(snake, snake->food));
 }
 
 short s_check_food(const snake *const snake)
@@ -216,6 +394,11 @@ short s_check_food(const snake *const snake)
 	if (!snake) {
 		return 0;
 	}
+	if (snake->foods) {
+		return snake->head.x >= 0 && snake->head.x < snake->max.x && snake->head.y >= 0
+		       && snake->head.y < snake->max.y
+		       && fs_has(snake->foods, s_cell(snake, snake->head));
+	}
 	if (snake->head.x == snake->food.x && snake->head.y == snake->food.y) {
 		return 1;
 	}
@@ -228,6 +411,16 @@ short s_handle_food(snake *const snake)
 		return 0;
 	}
 	if (s_check_food(snake)) {
+		el_log(EVENT_LOG_FOOD, snake->game, (uint32_t)snake->head.x, (uint32_t)snake->head.y,
+		       snake->score + 1, (uint32_t)s_body_length(snake));
+		if (snake->foods) {
+			fs_remove(snake->foods, s_cell(snake, snake->head));
+			b_cell_clear(snake->board, snake->head.x, snake->head.y, BOARD_CELL_FOOD);
+			snake->hash ^= z_key(ZOBRIST_FOOD, s_cell(snake, snake->head));
+			if (snake->food.x == snake->head.x && snake->food.y == snake->head.y) {
+				snake->food = (s_coordinates){ -1, -1 };
+			}
+		}
 		s_generate_food(snake);
 		snake->score++;
 		return 1;
@@ -235,23 +428,189 @@ short s_handle_food(snake *const snake)
 	return 0;
 }
 
-void s_signal_windows(monitor *const monitor, const enum m_signal_windows signal)
+void s_signal_windows(monitor *const monitor, const enum m_signal_windows signal,
+		      const snake *const snake)
 {
-	if (!monitor || signal == SIGNAL_WINDOWS_EMPTY) {
+	if (!monitor || !snake || signal == SIGNAL_WINDOWS_EMPTY) {
 		return;
 	}
-	pthread_mutex_lock(&(monitor->mutex));
+	TRACE_BEGIN(lock);
+	m_lock(monitor, __func__);
+	TRACE_END(lock, "s_signal_windows lock wait");
 	monitor->signal_windows = signal;
-	pthread_cond_signal(&(monitor->conditional));
-	pthread_mutex_unlock(&(monitor->mutex));
+	/* Body only changes on this thread, the keyframe matches the signal it is published with */
+	if (monitor->keyframe_wanted) {
+		sp_frame_release(monitor->keyframe);
+		monitor->keyframe = sp_encode_keyframe(snake);
+	}
+	m_unlock(monitor);
+	/* Notified after unlocking so the woken windows thread does not block on the mutex */
+	m_signal(&monitor->windows_event, __func__);
+}
+
+void s_clear_snake_body(snake *const snake)
+{
+	if (!snake) {
+		return;
+	}
+	while (s_body_length(snake)) {
+		s_remove_snake_tail(snake);
+	}
+	if (snake->foods) {
+		for (uint32_t i = 0; i < snake->foods->count; i++) {
+			uint32_t cell = fs_item(snake->foods, i);
+			b_cell_clear(snake->board, (int)(cell % snake->foods->width),
+				     (int)(cell / snake->foods->width), BOARD_CELL_FOOD);
+			snake->hash ^= z_key(ZOBRIST_FOOD, cell);
+		}
+		fs_clear(snake->foods);
+		snake->food = (s_coordinates){ -1, -1 };
+		return;
+	}
+	b_cell_clear(snake->board, snake->food.x, snake->food.y, BOARD_CELL_FOOD);
+	if (snake->food.x >= 0) {
+		snake->hash ^= z_key(ZOBRIST_FOOD, s_cell(snake, snake->food));
+		snake->food = (s_coordinates){ -1, -1 };
+	}
+}
+
+void s_push_snake_head(snake *const snake)
+{
+	if (!snake) {
+		return;
+	}
+	int64_t previous = -1;
+	if (snake->compact) {
+		if (snake->compact->length) {
+			previous = s_cell(snake, snake->compact->head);
+		}
+		if (!cb_push(snake->compact, snake->head)) {
+			fprintf(stderr, "ERROR: compact body head has to be next to the old head\n");
+			return;
+		}
+	} else {
+		const s_coordinates *tail = cdq_tail(snake->body);
+		if (tail) {
+			previous = s_cell(snake, *tail);
+		}
+		cdq_push(snake->body, &snake->head);
+	}
+	snake->hash ^= z_push(previous, s_cell(snake, snake->head));
+	b_cell_set(snake->board, snake->head.x, snake->head.y, BOARD_CELL_SNAKE);
 }
 
 void s_remove_snake_tail(snake *const snake)
 {
-	s_coordinates *tail = (s_coordinates *)cdq_head(snake->body);
-	if (!tail) {
+	size_t length = s_body_length(snake);
+	if (!length) {
+		return;
+	}
+	if (snake->compact) {
+		snake->tail = snake->compact->tail;
+		cb_pop(snake->compact);
+	} else {
+		snake->tail = *(const s_coordinates *)cdq_head(snake->body);
+		cdq_pop(snake->body);
+	}
+	snake->hash ^= z_pop(s_cell(snake, snake->tail), length == 1);
+	b_cell_clear(snake->board, snake->tail.x, snake->tail.y, BOARD_CELL_SNAKE);
+}
+
+short s_use_compact_body(snake *const snake)
+{
+	if (!snake || snake->compact || s_body_length(snake)) {
+		return 0;
+	}
+	snake->compact = cb_malloc();
+	if (!snake->compact) {
+		return 0;
+	}
+	cdq_free(&snake->body);
+	return 1;
+}
+
+short s_use_food_set(snake *const snake, const board *const board, const uint32_t count)
+{
+	if (!snake || !board || snake->foods || s_body_length(snake)) {
+		return 0;
+	}
+	snake->foods = fs_malloc(board->width, board->height, count);
+	return snake->foods != NULL;
+}
+
+size_t s_body_length(const snake *const snake)
+{
+	return snake->compact ? snake->compact->length : snake->body->size_current;
+}
+
+size_t s_body_capacity(const snake *const snake)
+{
+	/* One more segment than steps, the head and tail are kept as coordinates */
+	return snake->compact ? snake->compact->capacity + 1 : snake->body->size_max;
+}
+
+size_t s_body_memory_usage(const snake *const snake)
+{
+	if (snake->compact) {
+		return cb_memory_usage(snake->compact);
+	}
+	return sizeof(struct circular_dynamic_queue) + snake->body->size_max * snake->body->offset;
+}
+
+short s_body_begin(const snake *const snake, s_body_iterator *const iterator)
+{
+	iterator->snake = snake;
+	iterator->index = 0;
+	if (!s_body_length(snake)) {
+		return 0;
+	}
+	iterator->at = snake->compact ? snake->compact->tail
+				      : *(const s_coordinates *)cdq_head(snake->body);
+	return 1;
+}
+
+short s_body_next(s_body_iterator *const iterator)
+{
+	const snake *snake = iterator->snake;
+	if (snake->compact) {
+		if (!cb_next(snake->compact, iterator->index, &iterator->at)) {
+			return 0;
+		}
+	} else {
+		const s_coordinates *next = cdq_index(snake->body, iterator->index + 1);
+		if (!next) {
+			return 0;
+		}
+		iterator->at = *next;
+	}
+	iterator->index++;
+	return 1;
+}
+
+void s_seed(snake *const snake, const uint64_t seed)
+{
+	if (!snake) {
 		return;
 	}
-	snake->tail = *tail;
-	cdq_pop(snake->body);
+	snake->random = s_seed_random(seed);
+}
+
+uint64_t s_seed_random(const uint64_t seed)
+{
+	/* Splitmix64 step spreads similar seeds apart, xorshift state must not be zero */
+	uint64_t random = seed + 0x9e3779b97f4a7c15ULL;
+	random = (random ^ (random >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	random = (random ^ (random >> 27)) * 0x94d049bb133111ebULL;
+	random ^= random >> 31;
+	return random ? random : 1;
+}
+
+uint32_t s_random(uint64_t *const state)
+{
+	uint64_t random = *state;
+	random ^= random >> 12;
+	random ^= random << 25;
+	random ^= random >> 27;
+	*state = random;
+	return (uint32_t)((random * 0x2545f4914f6cdd1dULL) >> 32);
 }
@@ -23,9 +23,10 @@
 #ifndef __SNAKE_H__
 #define __SNAKE_H__
 
+#include "board.h"
 #include "circular_dynamic_queue.h"
 #include "monitor.h"
-#include <ncurses.h>
+#include "usage.h"
 #include <time.h>
 
 /*
@@ -41,18 +42,51 @@ typedef struct s_coordinates {
 	int y;
 } s_coordinates;
 
+struct compact_body;
+struct food_set;
+struct hud;
+struct mcts;
+struct rp_recorder;
+
 /*
- * Struct for storing snake information
+ * Struct for storing snake information.
+ * Jitter is how late s_move woke up for its ticks, ticks are recorded to hud if it is set.
+ * Random is the state of the generator placing food, owned by the snake.
+ * Bot, if set, chooses the moves instead of the keys.
+ * Hash is the Zobrist hash of the body, head and food, updated with every change of them.
+ * Body is kept in compact instead of the queue after s_use_compact_body, the queue is then NULL.
+ * Foods holds every food item after s_use_food_set, food is then the item placed last.
+ * Recorder, if set, writes every tick to a replay
  */
 typedef struct snake {
 	unsigned int score;
+	unsigned long ticks;
+	uint32_t game;
+	uint64_t random;
+	uint64_t hash;
+	u_jitter jitter;
 	struct s_coordinates head;
 	struct s_coordinates tail;
 	struct s_coordinates max;
 	struct s_coordinates food;
 	struct circular_dynamic_queue *body;
+	struct compact_body *compact;
+	struct food_set *foods;
+	struct board *board;
+	struct hud *hud;
+	struct mcts *bot;
+	struct rp_recorder *recorder;
 } snake;
 
+/*
+ * Walks the body of a snake from the tail to the head, at is the current segment
+ */
+typedef struct s_body_iterator {
+	s_coordinates at;
+	size_t index;
+	const struct snake *snake;
+} s_body_iterator;
+
 /*
  * Creates new snake object
  * \RETURNS: pointer to the newly created snake object
@@ -60,9 +94,15 @@ typedef struct snake {
 snake *s_malloc(void);
 
 /*
- * Initializes snake with default values
+ * Initializes snake with default values in the middle of the given board.
+ * Board is not owned by the snake and has to outlive it
+ */
+void s_initialize(snake *const snake, board *const board);
+
+/*
+ * Initializes snake with default values and given head position on the board
  */
-void s_initialize(snake *const snake, WINDOW *const game_window);
+void s_initialize_at(snake *const snake, board *const board, const s_coordinates head);
 
 /*
  * Frees the given snake object
@@ -74,6 +114,13 @@ void s_free(snake **snake);
  */
 void s_move(snake *const snake, monitor *const monitor);
 
+/*
+ * Advances snake by one tick after its move was handled.
+ * Does not touch the monitor, so it can be driven without locking
+ * \RETURNS: windows signal describing what has changed on the board
+ */
+enum m_signal_windows s_advance(snake *const snake, const short alive);
+
 /*
  * Handles received signal type from input
  * \RETURNS: 1 if exit was signaled, 0 if not
@@ -85,6 +132,12 @@ short s_handle_signal(snake *const snake, monitor *const monitor);
  */
 void s_handle_move(snake *const snake, monitor *const monitor);
 
+/*
+ * Gets move in the opposite direction
+ * \RETURNS: opposite move, SNAKE_MOVE_EMPTY if there is none
+ */
+enum m_snake_move s_get_opposite_move(const m_snake_move move);
+
 /*
  * Gets snake move offset
  * \RETURNS: offset struct
@@ -98,14 +151,13 @@ struct s_coordinates s_get_move_offset(const m_snake_move move);
 short s_move_direction(snake *const snake, const s_coordinates offset);
 
 /*
- * Checks if given coordinates are not out of bounds
- * and not inside snake body
+ * Checks if given coordinates are not a wall and not inside snake body
  * \RETURNS: 1 if move was valid (aka snake has not died), 0 if not
  */
 short s_check_new_location(const snake *const snake, const int x, const int y);
 
 /*
- * Generates snake food
+ * Places new snake food, replacing the old one unless the snake uses a food set
  */
 void s_generate_food(snake *const snake);
 
@@ -122,13 +174,82 @@ short s_check_food(const snake *const snake);
 short s_handle_food(snake *const snake);
 
 /*
- * Signals windows to update the screen depending on signal type
+ * Signals windows to update the screen depending on signal type,
+ * takes a spectator keyframe of snake when the windows thread wants one
  */
-void s_signal_windows(monitor *const monitor, const enum m_signal_windows signal);
+void s_signal_windows(monitor *const monitor, const enum m_signal_windows signal,
+		      const snake *const snake);
+
+/*
+ * Removes the whole snake body and all of its food from the board
+ */
+void s_clear_snake_body(snake *const snake);
+
+/*
+ * Pushes current head position to the snake body
+ */
+void s_push_snake_head(snake *const snake);
 
 /*
  * Removes snake tail
  */
 void s_remove_snake_tail(snake *const snake);
 
+/*
+ * Switches an empty snake to the compact body, 2 bits per segment instead of its coordinates
+ * \RETURNS: 1 on success, 0 if the body is not empty or allocation failed
+ */
+short s_use_compact_body(snake *const snake);
+
+/*
+ * Switches an empty snake to count food items at once, kept in a food set for a board of the
+ * size of board, which the snake has to be initialized on
+ * \RETURNS: 1 on success, 0 if the body is not empty, count does not fit the board
+ * or allocation failed
+ */
+short s_use_food_set(snake *const snake, const board *const board, const uint32_t count);
+
+/*
+ * RETURNS: number of body segments
+ */
+size_t s_body_length(const snake *const snake);
+
+/*
+ * RETURNS: number of segments the body holds before it has to grow
+ */
+size_t s_body_capacity(const snake *const snake);
+
+/*
+ * RETURNS: bytes used by the body
+ */
+size_t s_body_memory_usage(const snake *const snake);
+
+/*
+ * Starts iterator at the tail of the snake
+ * \RETURNS: 1 if the body has a segment, 0 if it is empty
+ */
+short s_body_begin(const snake *const snake, s_body_iterator *const iterator);
+
+/*
+ * Moves iterator one segment towards the head
+ * \RETURNS: 1 if it moved, 0 if it was at the head
+ */
+short s_body_next(s_body_iterator *const iterator);
+
+/*
+ * Seeds the food generator of the snake, games started after it repeat for the same seed
+ */
+void s_seed(snake *const snake, const uint64_t seed);
+
+/*
+ * RETURNS: generator state s_seed gives a snake for seed
+ */
+uint64_t s_seed_random(const uint64_t seed);
+
+/*
+ * Advances generator state, the same generator is used by game state copies of the snake
+ * \RETURNS: next pseudo random number
+ */
+uint32_t s_random(uint64_t *const state);
+
 #endif
@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include "spectator.h"
+#include "protocol.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+spectator *sp_malloc(void)
+{
+	struct spectator *spectator = malloc(sizeof(struct spectator));
+	if (!spectator) {
+		perror("ERROR: spectator malloc failed\n");
+		return NULL;
+	}
+	spectator->listen_fd = -1;
+	spectator->path = NULL;
+	spectator->subscriber_count = 0;
+	memset(spectator->subscribers, 0, sizeof(spectator->subscribers));
+	/* Closed readers are handled by write errors */
+	signal(SIGPIPE, SIG_IGN);
+	return spectator;
+}
+
+short sp_listen(spectator *const spectator, const char *const path)
+{
+	if (!spectator || !path) {
+		return 0;
+	}
+	struct sockaddr_un address = { .sun_family = AF_UNIX };
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		fprintf(stderr, "ERROR: socket path is too long\n");
+		return 0;
+	}
+	strcpy(address.sun_path, path);
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if (fd < 0) {
+		perror("ERROR: socket failed\n");
+		return 0;
+	}
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0
+	    || listen(fd, SOMAXCONN) != 0) {
+		perror("ERROR: spectator socket bind failed\n");
+		close(fd);
+		return 0;
+	}
+	spectator->listen_fd = fd;
+	spectator->path = path;
+	return 1;
+}
+
+void sp_free(spectator **spectator)
+{
+	if (!spectator || !*spectator) {
+		return;
+	}
+	for (size_t i = 0; i < SPECTATOR_MAX_SUBSCRIBERS; i++) {
+		sp_unsubscribe(*spectator, (*spectator)->subscribers[i]);
+	}
+	if ((*spectator)->listen_fd >= 0) {
+		close((*spectator)->listen_fd);
+		unlink((*spectator)->path);
+	}
+	free(*spectator);
+	*spectator = NULL;
+}
+
+short sp_subscribe(spectator *const spectator, const int fd)
+{
+	if (!spectator || fd < 0) {
+		return 0;
+	}
+	size_t slot = 0;
+	while (slot < SPECTATOR_MAX_SUBSCRIBERS && spectator->subscribers[slot]) {
+		slot++;
+	}
+	if (slot == SPECTATOR_MAX_SUBSCRIBERS) {
+		return 0;
+	}
+	int flags = fcntl(fd, F_GETFL);
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+		return 0;
+	}
+	sp_subscriber *subscriber = calloc(1, sizeof(struct sp_subscriber));
+	if (!subscriber) {
+		return 0;
+	}
+	subscriber->fd = fd;
+	subscriber->resync = 1;
+	spectator->subscribers[slot] = subscriber;
+	spectator->subscriber_count++;
+	return 1;
+}
+
+void sp_unsubscribe(spectator *const spectator, sp_subscriber *const subscriber)
+{
+	if (!spectator || !subscriber) {
+		return;
+	}
+	for (size_t i = 0; i < SPECTATOR_MAX_SUBSCRIBERS; i++) {
+		if (spectator->subscribers[i] == subscriber) {
+			spectator->subscribers[i] = NULL;
+			spectator->subscriber_count--;
+			break;
+		}
+	}
+	for (size_t i = 0; i < subscriber->count; i++) {
+		sp_frame_release(subscriber->queue[(subscriber->head + i) % SPECTATOR_QUEUE_SIZE]);
+	}
+	close(subscriber->fd);
+	free(subscriber);
+}
+
+/*
+ * Accepts every pending subscriber without blocking
+ */
+static void sp_accept(spectator *const spectator)
+{
+	if (spectator->listen_fd < 0) {
+		return;
+	}
+	int fd;
+	while ((fd = accept4(spectator->listen_fd, NULL, NULL, SOCK_NONBLOCK)) >= 0) {
+		/* Spectators never send anything meaningful */
+		shutdown(fd, SHUT_RD);
+		if (!sp_subscribe(spectator, fd)) {
+			close(fd);
+		}
+	}
+}
+
+sp_frame *sp_encode_keyframe(const snake *const snake)
+{
+	size_t size = 2 * sizeof(struct p_header) + sizeof(struct p_welcome)
+		      + sizeof(struct p_delta) + s_body_length(snake) * sizeof(struct p_point);
+	sp_frame *frame = sp_frame_malloc(size);
+	if (!frame) {
+		return NULL;
+	}
+	frame->length = p_encode_welcome(frame->data, size, 0, snake->max.x, snake->max.y);
+	frame->length += p_encode_body(frame->data + frame->length, size - frame->length,
+				       RECORD_KEYFRAME, 0, snake);
+	return frame;
+}
+
+short sp_keyframe_wanted(const spectator *const spectator)
+{
+	if (!spectator) {
+		return 0;
+	}
+	for (size_t i = 0; i < SPECTATOR_MAX_SUBSCRIBERS; i++) {
+		if (spectator->subscribers[i] && spectator->subscribers[i]->resync) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void sp_publish(spectator *const spectator, const enum m_signal_windows signal,
+		const snake *const snake, sp_frame *const keyframe)
+{
+	if (!spectator || !snake) {
+		return;
+	}
+	sp_accept(spectator);
+	if (spectator->subscriber_count == 0 || signal == SIGNAL_WINDOWS_EMPTY
+	    || signal == SIGNAL_WINDOWS_GAME_EXIT) {
+		return;
+	}
+
+	/* Delta is encoded at most once per tick, the keyframe comes from the caller */
+	sp_frame *delta = NULL;
+	for (size_t i = 0; i < SPECTATOR_MAX_SUBSCRIBERS; i++) {
+		sp_subscriber *subscriber = spectator->subscribers[i];
+		if (!subscriber) {
+			continue;
+		}
+		if (subscriber->resync) {
+			if (!keyframe) {
+				continue;
+			}
+			subscriber->resync = 0;
+			sp_enqueue(subscriber, keyframe);
+		} else {
+			if (!delta) {
+				delta = sp_frame_malloc(sizeof(struct p_header) + sizeof(struct p_delta));
+				if (!delta) {
+					continue;
+				}
+				delta->length = p_encode_delta(delta->data, sizeof(struct p_header)
+								   + sizeof(struct p_delta),
+							       0, signal, snake);
+			}
+			sp_enqueue(subscriber, delta);
+		}
+		if (!sp_flush(subscriber)) {
+			sp_unsubscribe(spectator, subscriber);
+		}
+	}
+	sp_frame_release(delta);
+}
+
+sp_frame *sp_frame_malloc(const size_t size)
+{
+	sp_frame *frame = malloc(sizeof(struct sp_frame) + size);
+	if (!frame) {
+		perror("ERROR: spectator frame malloc failed\n");
+		return NULL;
+	}
+	frame->references = 1;
+	frame->length = 0;
+	return frame;
+}
+
+void sp_frame_release(sp_frame *const frame)
+{
+	if (frame && --frame->references == 0) {
+		free(frame);
+	}
+}
+
+void sp_enqueue(sp_subscriber *const subscriber, sp_frame *const frame)
+{
+	if (!subscriber || !frame) {
+		return;
+	}
+	if (subscriber->count == SPECTATOR_QUEUE_SIZE) {
+		/* Partially written frame has to be finished to keep the stream aligned */
+		size_t keep = subscriber->offset > 0;
+		for (size_t i = keep; i < subscriber->count; i++) {
+			sp_frame_release(
+				subscriber->queue[(subscriber->head + i) % SPECTATOR_QUEUE_SIZE]);
+		}
+		subscriber->count = keep;
+		subscriber->resync = 1;
+		return;
+	}
+	frame->references++;
+	subscriber->queue[(subscriber->head + subscriber->count) % SPECTATOR_QUEUE_SIZE] = frame;
+	subscriber->count++;
+}
+
+short sp_flush(sp_subscriber *const subscriber)
+{
+	if (!subscriber) {
+		return 0;
+	}
+	if (subscriber->count == 0) {
+		return 1;
+	}
+	struct iovec vectors[SPECTATOR_QUEUE_SIZE];
+	for (size_t i = 0; i < subscriber->count; i++) {
+		sp_frame *frame = subscriber->queue[(subscriber->head + i) % SPECTATOR_QUEUE_SIZE];
+		vectors[i].iov_base = frame->data;
+		vectors[i].iov_len = frame->length;
+	}
+	vectors[0].iov_base = (char *)vectors[0].iov_base + subscriber->offset;
+	vectors[0].iov_len -= subscriber->offset;
+
+	ssize_t result = writev(subscriber->fd, vectors, (int)subscriber->count);
+	if (result < 0) {
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+	}
+	size_t written = (size_t)result + subscriber->offset;
+	while (subscriber->count > 0) {
+		sp_frame *frame = subscriber->queue[subscriber->head];
+		if (written < frame->length) {
+			break;
+		}
+		written -= frame->length;
+		sp_frame_release(frame);
+		subscriber->head = (subscriber->head + 1) % SPECTATOR_QUEUE_SIZE;
+		subscriber->count--;
+	}
+	subscriber->offset = written;
+	return 1;
+}
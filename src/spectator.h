@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __SPECTATOR_H__
+#define __SPECTATOR_H__
+
+#include "monitor.h"
+#include "snake.h"
+#include <stddef.h>
+
+/*
+ * Maximum number of simultaneously watching subscribers
+ */
+#define SPECTATOR_MAX_SUBSCRIBERS 256
+
+/*
+ * Number of frames queued for a subscriber before it is resynced
+ */
+#define SPECTATOR_QUEUE_SIZE 64
+
+/*
+ * Encoded frame shared by all subscribers.
+ * Frames are only touched by the windows thread, so references are not atomic
+ */
+typedef struct sp_frame {
+	unsigned int references;
+	size_t length;
+	char data[];
+} sp_frame;
+
+/*
+ * Subscriber with a ring of frames that were not written yet.
+ * Offset is the number of bytes of the first queued frame already written
+ */
+typedef struct sp_subscriber {
+	int fd;
+	short resync;
+	size_t offset;
+	size_t head;
+	size_t count;
+	struct sp_frame *queue[SPECTATOR_QUEUE_SIZE];
+} sp_subscriber;
+
+/*
+ * Spectator feed of the local game
+ */
+typedef struct spectator {
+	int listen_fd;
+	const char *path;
+	size_t subscriber_count;
+	struct sp_subscriber *subscribers[SPECTATOR_MAX_SUBSCRIBERS];
+} spectator;
+
+/*
+ * Creates new spectator object without any subscribers
+ * \RETURNS: pointer to the newly created spectator
+ */
+spectator *sp_malloc(void);
+
+/*
+ * Starts listening for subscribers on the given Unix domain socket
+ * \RETURNS: 1 on success, 0 on failure
+ */
+short sp_listen(spectator *const spectator, const char *const path);
+
+/*
+ * Frees the given spectator, closing all of the subscribers
+ */
+void sp_free(spectator **spectator);
+
+/*
+ * Adds already opened pipe or socket as a subscriber
+ * \RETURNS: 1 on success, 0 on failure
+ */
+short sp_subscribe(spectator *const spectator, const int fd);
+
+/*
+ * Removes the subscriber and releases its queued frames
+ */
+void sp_unsubscribe(spectator *const spectator, sp_subscriber *const subscriber);
+
+/*
+ * Encodes the change the windows are about to draw once and sends it to every subscriber.
+ * Subscribers waiting for a resync get keyframe instead, they keep waiting while it is NULL
+ */
+void sp_publish(spectator *const spectator, const enum m_signal_windows signal,
+		const snake *const snake, sp_frame *const keyframe);
+
+/*
+ * RETURNS: 1 if a subscriber waits for a keyframe, 0 if not or spectator is NULL
+ */
+short sp_keyframe_wanted(const spectator *const spectator);
+
+/*
+ * Encodes board size followed by the whole snake so a subscriber can redraw from scratch.
+ * Walks the body, so it has to be called by the thread changing it
+ * \RETURNS: newly created frame, NULL on failure
+ */
+sp_frame *sp_encode_keyframe(const snake *const snake);
+
+/*
+ * Allocates frame with a single reference held by the caller
+ * \RETURNS: pointer to the newly created frame
+ */
+sp_frame *sp_frame_malloc(const size_t size);
+
+/*
+ * Drops one reference and frees the frame when it was the last one
+ */
+void sp_frame_release(sp_frame *const frame);
+
+/*
+ * Queues the frame for the subscriber taking a new reference.
+ * Subscriber whose queue is full is marked for resync instead
+ */
+void sp_enqueue(sp_subscriber *const subscriber, sp_frame *const frame);
+
+/*
+ * Writes queued frames with a single writev call
+ * \RETURNS: 1 on success, 0 if the subscriber has to be dropped
+ */
+short sp_flush(sp_subscriber *const subscriber);
+
+#endif
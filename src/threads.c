@@ -20,13 +20,198 @@
  * SOFTWARE.
  */
 
+#define _GNU_SOURCE
 #include "threads.h"
+#include "allocator.h"
 #include "input.h"
 #include "snake.h"
 #include "windows.h"
+#include <sched.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * Nice value the game thread falls back to when SCHED_FIFO is denied
+ */
+#define THREADS_FALLBACK_NICE -10
+
+/*
+ * Runs the calling thread under SCHED_FIFO, falls back to a raised nice value
+ * when real time scheduling is not permitted
+ */
+static void t_apply_scheduling(t_options *const options)
+{
+	if (!options || options->priority <= 0) {
+		return;
+	}
+	struct sched_param parameter = { .sched_priority = options->priority };
+	if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameter) == 0) {
+		options->scheduling = SCHEDULING_FIFO;
+		return;
+	}
+	/* Nice applies to a single thread when given its thread id */
+	if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), THREADS_FALLBACK_NICE) == 0) {
+		options->scheduling = SCHEDULING_NICE;
+		return;
+	}
+	options->scheduling = SCHEDULING_DENIED;
+}
+
+/*
+ * Names of the threads in reports
+ */
+static const char *const t_names[THREAD_TYPE_COUNT] = {
+	[THREAD_INPUT] = "input",
+	[THREAD_GAME] = "game",
+	[THREAD_WINDOWS] = "windows",
+};
+
+/*
+ * RETURNS: attributes pinning a new thread to its CPU, NULL if it is not pinned
+ */
+static pthread_attr_t *t_attributes(pthread_attr_t *const attributes, t_options *const options,
+				    const w_thread thread)
+{
+	if (!options || options->cpus[thread] < 0) {
+		return NULL;
+	}
+	if (pthread_attr_init(attributes) != 0) {
+		options->pinning[thread] = PINNING_FAILED;
+		return NULL;
+	}
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET((size_t)options->cpus[thread], &set);
+	if (pthread_attr_setaffinity_np(attributes, sizeof(set), &set) != 0) {
+		options->pinning[thread] = PINNING_FAILED;
+		pthread_attr_destroy(attributes);
+		return NULL;
+	}
+	return attributes;
+}
+
+/*
+ * Creates a thread pinned through its attributes, starts it unpinned if that is refused
+ * \RETURNS: 0 on success, error number otherwise
+ */
+static int t_create(pthread_t *const thread, pthread_attr_t *const attribute,
+		    t_options *const options, const w_thread type, void *(*routine)(void *),
+		    void *args)
+{
+	if (attribute) {
+		if (pthread_create(thread, attribute, routine, args) == 0) {
+			options->pinning[type] = PINNING_PINNED;
+			return 0;
+		}
+		options->pinning[type] = PINNING_FAILED;
+	}
+	return pthread_create(thread, NULL, routine, args);
+}
+
+void t_options_initialize(t_options *const options)
+{
+	if (!options) {
+		return;
+	}
+	for (int i = 0; i < THREAD_TYPE_COUNT; i++) {
+		options->cpus[i] = -1;
+		options->pinning[i] = PINNING_NONE;
+	}
+	options->priority = 0;
+	options->scheduling = SCHEDULING_NORMAL;
+}
+
+short t_options_parse_cpus(t_options *const options, const char *const list)
+{
+	if (!options || !list) {
+		return 0;
+	}
+	const w_thread order[] = { THREAD_GAME, THREAD_INPUT, THREAD_WINDOWS };
+	/* Only CPUs in the cpuset the process was started in can be pinned to */
+	cpu_set_t allowed;
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+		perror("Process CPU affinity get failed");
+		return 0;
+	}
+	const char *cursor = list;
+	for (int i = 0; i < THREAD_TYPE_COUNT && *cursor; i++) {
+		char *end = NULL;
+		if (*cursor == '-') {
+			end = (char *)cursor + 1;
+		} else {
+			long cpu = strtol(cursor, &end, 10);
+			if (end == cursor || cpu < 0 || cpu >= CPU_SETSIZE
+			    || !CPU_ISSET((size_t)cpu, &allowed)) {
+				return 0;
+			}
+			options->cpus[order[i]] = (int)cpu;
+		}
+		if (*end != ',' && *end != '\0') {
+			return 0;
+		}
+		cursor = *end == ',' ? end + 1 : end;
+	}
+	return *cursor == '\0';
+}
+
+void t_apply_options(t_options *const options, const w_thread thread)
+{
+	if (!options) {
+		return;
+	}
+	if (options->cpus[thread] >= 0) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET((size_t)options->cpus[thread], &set);
+		if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+			options->pinning[thread] = PINNING_PINNED;
+		} else {
+			options->pinning[thread] = PINNING_FAILED;
+		}
+	}
+	if (thread == THREAD_GAME) {
+		t_apply_scheduling(options);
+	}
+}
+
+void t_options_report(const t_options *const options, FILE *const stream)
+{
+	if (!options || !stream) {
+		return;
+	}
+	for (int i = 0; i < THREAD_TYPE_COUNT; i++) {
+		switch (options->pinning[i]) {
+		case PINNING_PINNED:
+			fprintf(stream, "%s thread: pinned to CPU %d\n", t_names[i], options->cpus[i]);
+			break;
+		case PINNING_FAILED:
+			fprintf(stream, "%s thread: pinning to CPU %d failed, unpinned\n", t_names[i],
+				options->cpus[i]);
+			break;
+		default:
+			break;
+		}
+	}
+	if (options->priority <= 0) {
+		return;
+	}
+	switch (options->scheduling) {
+	case SCHEDULING_FIFO:
+		fprintf(stream, "game thread: SCHED_FIFO priority %d\n", options->priority);
+		break;
+	case SCHEDULING_NICE:
+		fprintf(stream, "game thread: SCHED_FIFO denied, nice %d\n", THREADS_FALLBACK_NICE);
+		break;
+	default:
+		fprintf(stream, "game thread: SCHED_FIFO and nice denied, normal scheduling\n");
+		break;
+	}
+}
 
 void *t_initialize_input(void *args)
 {
@@ -34,6 +219,7 @@ void *t_initialize_input(void *args)
 		return NULL;
 	}
 	struct monitor *monitor = (struct monitor *)args;
+	pthread_setname_np(pthread_self(), "input");
 	i_handle_input(monitor);
 	return NULL;
 }
@@ -44,8 +230,10 @@ void *t_initialize_snake(void *args)
 		return NULL;
 	}
 	struct snake_args *snake_args = (struct snake_args *)args;
+	pthread_setname_np(pthread_self(), "game");
+	t_apply_scheduling(snake_args->options);
 	s_move(snake_args->snake, snake_args->monitor);
-	free(snake_args);
+	a_free(ALLOCATOR_TAG_THREADS, snake_args, sizeof(struct snake_args));
 	return NULL;
 }
 
@@ -55,55 +243,73 @@ void *t_initialize_windows(void *args)
 		return NULL;
 	}
 	windows_args *windows_args = (struct windows_args *)args;
+	pthread_setname_np(pthread_self(), "windows");
 	w_snake_display_head(windows_args->windows, windows_args->snake, COLOR_PAIR_GREEN);
 	w_snake_display_food(windows_args->windows, windows_args->snake);
 	w_display(windows_args->windows, windows_args->monitor, windows_args->snake);
-	free(windows_args);
+	a_free(ALLOCATOR_TAG_THREADS, windows_args, sizeof(struct windows_args));
 	return NULL;
 }
 
 void t_initialize_threads(pthread_t *const threads, monitor *const monitor, snake *const snake,
-			  windows *const windows)
+			  windows *const windows, t_options *const options)
 {
 	if (!threads || !monitor) {
 		return;
 	}
 
-	struct snake_args *snake_args = (struct snake_args *)malloc(sizeof(struct snake_args));
+	pthread_attr_t attributes[THREAD_TYPE_COUNT];
+	pthread_attr_t *attribute[THREAD_TYPE_COUNT];
+	for (int i = 0; i < THREAD_TYPE_COUNT; i++) {
+		attribute[i] = t_attributes(&attributes[i], options, (w_thread)i);
+	}
+
+	struct snake_args *snake_args = a_malloc(ALLOCATOR_TAG_THREADS, sizeof(struct snake_args));
 	if (!snake_args) {
-		return;
+		goto t_destroy_attributes;
 	}
 	struct windows_args *windows_args
-		= (struct windows_args *)malloc(sizeof(struct windows_args));
+		= a_malloc(ALLOCATOR_TAG_THREADS, sizeof(struct windows_args));
 	if (!windows_args) {
 		goto t_free_snake_args;
 	}
 
 	snake_args->monitor = monitor;
 	snake_args->snake = snake;
+	snake_args->options = options;
 	windows_args->monitor = monitor;
 	windows_args->snake = snake;
 	windows_args->windows = windows;
 
-	if (pthread_create(&(threads[THREAD_GAME]), NULL, t_initialize_snake, snake_args) != 0) {
+	if (t_create(&(threads[THREAD_GAME]), attribute[THREAD_GAME], options, THREAD_GAME,
+		     t_initialize_snake, snake_args)
+	    != 0) {
 		perror("Game thread create failed:\n");
 		goto t_free_windows_args;
 	}
-	if (pthread_create(&(threads[THREAD_INPUT]), NULL, t_initialize_input, monitor) != 0) {
+	if (t_create(&(threads[THREAD_INPUT]), attribute[THREAD_INPUT], options, THREAD_INPUT,
+		     t_initialize_input, monitor)
+	    != 0) {
 		perror("Input thread create failed:\n");
 		goto t_join_game_thread;
 	}
-	if (pthread_create(&(threads[THREAD_WINDOWS]), NULL, t_initialize_windows, windows_args)
+	if (t_create(&(threads[THREAD_WINDOWS]), attribute[THREAD_WINDOWS], options,
+		     THREAD_WINDOWS, t_initialize_windows, windows_args)
 	    != 0) {
 		perror("Windows thread create failed:\n");
 		pthread_join(threads[THREAD_INPUT], NULL);
 t_join_game_thread:
 		pthread_join(threads[THREAD_GAME], NULL);
 t_free_windows_args:
-		free(windows_args);
+		a_free(ALLOCATOR_TAG_THREADS, windows_args, sizeof(struct windows_args));
 t_free_snake_args:
-		free(snake_args);
-		return;
+		a_free(ALLOCATOR_TAG_THREADS, snake_args, sizeof(struct snake_args));
+	}
+t_destroy_attributes:
+	for (int i = 0; i < THREAD_TYPE_COUNT; i++) {
+		if (attribute[i]) {
+			pthread_attr_destroy(attribute[i]);
+		}
 	}
 }
 
@@ -27,18 +27,49 @@
 #include "monitor.h"
 #include "windows.h"
 #include <pthread.h>
+#include <stdio.h>
 
 /*
  * Thread types
  */
 typedef enum w_thread { THREAD_INPUT, THREAD_GAME, THREAD_WINDOWS, THREAD_TYPE_COUNT } w_thread;
 
+/*
+ * Scheduling the game thread ended up with
+ */
+typedef enum t_scheduling {
+	SCHEDULING_NORMAL,
+	SCHEDULING_FIFO,
+	SCHEDULING_NICE,
+	SCHEDULING_DENIED
+} t_scheduling;
+
+/*
+ * Whether a thread ended up on the CPU it was given
+ */
+typedef enum t_pinning { PINNING_NONE, PINNING_PINNED, PINNING_FAILED } t_pinning;
+
+/*
+ * Thread placement options.
+ * Cpus holds the CPU every thread is pinned to, -1 leaves it unpinned,
+ * pinning is set to what every thread got.
+ * Priority above 0 runs the game thread under SCHED_FIFO with that priority,
+ * scheduling is set by the game thread to what it got
+ */
+typedef struct t_options {
+	int cpus[THREAD_TYPE_COUNT];
+	t_pinning pinning[THREAD_TYPE_COUNT];
+	int priority;
+	t_scheduling scheduling;
+} t_options;
+
 /*
  * Arguments for snake thread
  */
 typedef struct snake_args {
 	monitor *monitor;
 	snake *snake;
+	t_options *options;
 } snake_args;
 
 /*
@@ -66,10 +97,34 @@ void *t_initialize_snake(void *args);
 void *t_initialize_windows(void *args);
 
 /*
- * Initializes threads by giving jobs to them
+ * Sets options to leave every thread unpinned under normal scheduling
+ */
+void t_options_initialize(t_options *const options);
+
+/*
+ * Parses comma separated CPUs of the game, input and windows threads, - leaves one unpinned.
+ * Every CPU has to be in the affinity mask of the process
+ * \RETURNS: 1 if the list is valid, 0 otherwise
+ */
+short t_options_parse_cpus(t_options *const options, const char *const list);
+
+/*
+ * Pins the calling thread to the CPU of thread and applies the game thread scheduling
+ * if thread is THREAD_GAME, used when the game runs on the main thread.
+ * Threads started by t_initialize_threads are pinned through their attributes instead
+ */
+void t_apply_options(t_options *const options, const w_thread thread);
+
+/*
+ * Prints the CPUs the threads were pinned to and the scheduling the game thread got
+ */
+void t_options_report(const t_options *const options, FILE *const stream);
+
+/*
+ * Initializes threads by giving jobs to them, options may be NULL
  */
 void t_initialize_threads(pthread_t *const threads, monitor *const monitor, snake *const snake,
-			  windows *const windows);
+			  windows *const windows, t_options *const options);
 
 /*
  * Finalizes threads by joining them
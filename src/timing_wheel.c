@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "timing_wheel.h"
+#include <string.h>
+#include <time.h>
+
+void tw_initialize(timing_wheel *const wheel, const uint64_t origin)
+{
+	if (!wheel) {
+		return;
+	}
+	memset(wheel, 0, sizeof(struct timing_wheel));
+	wheel->origin = origin;
+}
+
+void tw_timer_initialize(tw_timer *const timer,
+			 void (*callback)(tw_timer *const timer, void *const data), void *const data)
+{
+	if (!timer) {
+		return;
+	}
+	timer->expires = 0;
+	timer->next = NULL;
+	timer->previous = NULL;
+	timer->callback = callback;
+	timer->data = data;
+}
+
+/*
+ * Links timer into the slot matching its expiration tick
+ */
+static void tw_link(timing_wheel *const wheel, tw_timer *const timer)
+{
+	if (timer->expires < wheel->now) {
+		timer->expires = wheel->now;
+	}
+	uint64_t delta = timer->expires - wheel->now;
+	unsigned int level = 0;
+	while (level < TIMING_WHEEL_LEVELS - 1
+	       && delta >= (uint64_t)1 << (TIMING_WHEEL_BITS * (level + 1))) {
+		level++;
+	}
+	if (delta >= (uint64_t)1 << (TIMING_WHEEL_BITS * TIMING_WHEEL_LEVELS)) {
+		timer->expires = wheel->now
+				 + ((uint64_t)1 << (TIMING_WHEEL_BITS * TIMING_WHEEL_LEVELS)) - 1;
+	}
+	unsigned int slot = (timer->expires >> (TIMING_WHEEL_BITS * level)) & TIMING_WHEEL_MASK;
+
+	timer->level = level;
+	timer->slot = slot;
+	tw_timer **head = &wheel->slots[level][slot];
+	timer->next = *head;
+	timer->previous = head;
+	if (*head) {
+		(*head)->previous = &timer->next;
+	}
+	*head = timer;
+	wheel->occupied[level] |= (uint64_t)1 << slot;
+}
+
+/*
+ * Detaches all timers of the slot.
+ * Caller has to point previous of the first timer to its own list head
+ * \RETURNS: first timer of the detached list
+ */
+static tw_timer *tw_take_slot(timing_wheel *const wheel, const unsigned int level,
+			      const unsigned int slot)
+{
+	tw_timer *list = wheel->slots[level][slot];
+	wheel->slots[level][slot] = NULL;
+	wheel->occupied[level] &= ~((uint64_t)1 << slot);
+	return list;
+}
+
+void tw_add(timing_wheel *const wheel, tw_timer *const timer, const uint64_t deadline)
+{
+	if (!wheel || !timer) {
+		return;
+	}
+	if (tw_is_pending(timer)) {
+		tw_cancel(wheel, timer);
+	}
+	uint64_t elapsed = deadline > wheel->origin ? deadline - wheel->origin : 0;
+	/* Rounded up so a timer never fires before its deadline */
+	timer->expires = (elapsed + TIMING_WHEEL_RESOLUTION - 1) / TIMING_WHEEL_RESOLUTION;
+	tw_link(wheel, timer);
+	wheel->count++;
+}
+
+void tw_cancel(timing_wheel *const wheel, tw_timer *const timer)
+{
+	if (!wheel || !tw_is_pending(timer)) {
+		return;
+	}
+	*timer->previous = timer->next;
+	if (timer->next) {
+		timer->next->previous = timer->previous;
+	}
+	timer->next = NULL;
+	timer->previous = NULL;
+	wheel->count--;
+	if (!wheel->slots[timer->level][timer->slot]) {
+		wheel->occupied[timer->level] &= ~((uint64_t)1 << timer->slot);
+	}
+}
+
+short tw_is_pending(const tw_timer *const timer)
+{
+	return timer && timer->previous;
+}
+
+/*
+ * Moves timers of the current slot of given level one level down,
+ * cascading higher levels first when their index wraps as well
+ */
+static void tw_cascade(timing_wheel *const wheel, const unsigned int level)
+{
+	unsigned int slot = (wheel->now >> (TIMING_WHEEL_BITS * level)) & TIMING_WHEEL_MASK;
+	if (slot == 0 && level + 1 < TIMING_WHEEL_LEVELS) {
+		tw_cascade(wheel, level + 1);
+	}
+	tw_timer *timer = tw_take_slot(wheel, level, slot);
+	while (timer) {
+		tw_timer *next = timer->next;
+		tw_link(wheel, timer);
+		timer = next;
+	}
+}
+
+void tw_advance(timing_wheel *const wheel, const uint64_t time)
+{
+	if (!wheel || time < wheel->origin) {
+		return;
+	}
+	uint64_t target = (time - wheel->origin) / TIMING_WHEEL_RESOLUTION;
+	while (wheel->now <= target && wheel->count > 0) {
+		unsigned int slot = wheel->now & TIMING_WHEEL_MASK;
+		if (slot == 0) {
+			tw_cascade(wheel, 1);
+		}
+		/* Callbacks may cancel timers that are still waiting in the detached list */
+		tw_timer *list = tw_take_slot(wheel, 0, slot);
+		if (list) {
+			list->previous = &list;
+		}
+		/* Timers rescheduled by callbacks land at least one tick later */
+		wheel->now++;
+		while (list) {
+			tw_timer *timer = list;
+			list = timer->next;
+			if (list) {
+				list->previous = &list;
+			}
+			timer->next = NULL;
+			timer->previous = NULL;
+			wheel->count--;
+			timer->callback(timer, timer->data);
+		}
+	}
+	if (wheel->count == 0 && wheel->now <= target) {
+		wheel->now = target + 1;
+	}
+}
+
+int64_t tw_next_timeout(const timing_wheel *const wheel, const uint64_t time)
+{
+	if (!wheel || wheel->count == 0) {
+		return -1;
+	}
+	uint64_t next = UINT64_MAX;
+	for (unsigned int level = 0; level < TIMING_WHEEL_LEVELS; level++) {
+		unsigned int shift = TIMING_WHEEL_BITS * level;
+		uint64_t index = (wheel->now >> shift) & TIMING_WHEEL_MASK;
+		/* Current slot of a higher level is cascaded once lower bits of now wrap to zero */
+		uint64_t below = wheel->now & (((uint64_t)1 << shift) - 1);
+		uint64_t first = level == 0 || below == 0 ? index : index + 1;
+		uint64_t base = (wheel->now >> (shift + TIMING_WHEEL_BITS))
+				<< (shift + TIMING_WHEEL_BITS);
+		uint64_t ahead = first < TIMING_WHEEL_SLOTS ? wheel->occupied[level] >> first : 0;
+		uint64_t candidate;
+		if (ahead) {
+			candidate = base + ((first + (uint64_t)__builtin_ctzll(ahead)) << shift);
+		} else if (wheel->occupied[level]) {
+			candidate = base + ((uint64_t)TIMING_WHEEL_SLOTS << shift);
+		} else {
+			continue;
+		}
+		if (candidate < next) {
+			next = candidate;
+		}
+	}
+	uint64_t deadline = wheel->origin + next * TIMING_WHEEL_RESOLUTION;
+	return deadline > time ? (int64_t)(deadline - time) : 0;
+}
+
+uint64_t tw_now(void)
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (uint64_t)time.tv_sec * 1000000000 + (uint64_t)time.tv_nsec;
+}
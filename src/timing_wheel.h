@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __TIMING_WHEEL_H__
+#define __TIMING_WHEEL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Wheel resolution in nanoseconds
+ */
+#define TIMING_WHEEL_RESOLUTION 1000000
+
+/*
+ * Every level has 1 << TIMING_WHEEL_BITS slots, each level
+ * covers TIMING_WHEEL_SLOTS times longer range than the previous one
+ */
+#define TIMING_WHEEL_BITS 6
+#define TIMING_WHEEL_SLOTS (1 << TIMING_WHEEL_BITS)
+#define TIMING_WHEEL_MASK (TIMING_WHEEL_SLOTS - 1)
+#define TIMING_WHEEL_LEVELS 4
+
+/*
+ * Timer linked into one of the wheel slots.
+ * Expires is the absolute wheel tick the timer is due at,
+ * level and slot tell where it was linked
+ */
+typedef struct tw_timer {
+	uint64_t expires;
+	unsigned int level;
+	unsigned int slot;
+	struct tw_timer *next;
+	struct tw_timer **previous;
+	void (*callback)(struct tw_timer *const timer, void *const data);
+	void *data;
+} tw_timer;
+
+/*
+ * Hierarchical timing wheel.
+ * Now is the next tick to be processed, occupied has a bit set for every non empty slot
+ */
+typedef struct timing_wheel {
+	uint64_t now;
+	uint64_t origin;
+	size_t count;
+	uint64_t occupied[TIMING_WHEEL_LEVELS];
+	struct tw_timer *slots[TIMING_WHEEL_LEVELS][TIMING_WHEEL_SLOTS];
+} timing_wheel;
+
+/*
+ * Initializes empty wheel starting at given monotonic time in nanoseconds
+ */
+void tw_initialize(timing_wheel *const wheel, const uint64_t origin);
+
+/*
+ * Initializes timer with the callback called when it expires
+ */
+void tw_timer_initialize(tw_timer *const timer,
+			 void (*callback)(tw_timer *const timer, void *const data), void *const data);
+
+/*
+ * Schedules timer at given monotonic time in nanoseconds in O(1)
+ */
+void tw_add(timing_wheel *const wheel, tw_timer *const timer, const uint64_t deadline);
+
+/*
+ * Removes pending timer from the wheel in O(1)
+ */
+void tw_cancel(timing_wheel *const wheel, tw_timer *const timer);
+
+/*
+ * Checks whether timer is scheduled
+ * \RETURNS: 1 if it is, 0 if not
+ */
+short tw_is_pending(const tw_timer *const timer);
+
+/*
+ * Runs callbacks of all timers due up to given monotonic time in nanoseconds
+ */
+void tw_advance(timing_wheel *const wheel, const uint64_t time);
+
+/*
+ * Calculates time until the wheel has to be advanced again,
+ * either because a timer is due or a higher level slot has to be cascaded
+ * \RETURNS: timeout in nanoseconds, -1 if wheel is empty
+ */
+int64_t tw_next_timeout(const timing_wheel *const wheel, const uint64_t time);
+
+/*
+ * RETURNS: current monotonic time in nanoseconds
+ */
+uint64_t tw_now(void);
+
+#endif
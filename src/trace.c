@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#define _GNU_SOURCE
+#include "trace.h"
+#include "timing_wheel.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * All buffers ever registered, pushed lock free and freed in tr_finalize
+ */
+static tr_buffer *tr_buffers = NULL;
+
+/*
+ * Buffer of the calling thread, allocated on its first event
+ */
+static __thread tr_buffer *tr_local = NULL;
+
+static const char *tr_path = NULL;
+static pthread_t tr_thread;
+static volatile short tr_running = 0;
+
+/*
+ * Allocates and registers the buffer of the calling thread
+ * \RETURNS: the buffer, NULL if allocation failed
+ */
+static tr_buffer *tr_buffer_malloc(void)
+{
+	tr_buffer *buffer = calloc(1, sizeof(tr_buffer));
+	if (!buffer) {
+		return NULL;
+	}
+	buffer->thread_id = syscall(SYS_gettid);
+	pthread_getname_np(pthread_self(), buffer->thread_name, sizeof(buffer->thread_name));
+	buffer->next = __atomic_load_n(&tr_buffers, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&tr_buffers, &buffer->next, buffer, 1,
+					    __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+	}
+	return buffer;
+}
+
+/*
+ * Waits for SIGUSR1 and dumps the buffers until tracing is finalized
+ */
+static void *tr_dump_thread(void *args)
+{
+	sigset_t *signals = (sigset_t *)args;
+	int signal;
+	while (!sigwait(signals, &signal) && tr_running) {
+		tr_dump(tr_path);
+	}
+	free(signals);
+	return NULL;
+}
+
+short tr_initialize(const char *const path)
+{
+	if (!path) {
+		return 0;
+	}
+	sigset_t *signals = malloc(sizeof(sigset_t));
+	if (!signals) {
+		return 0;
+	}
+	sigemptyset(signals);
+	sigaddset(signals, SIGUSR1);
+	pthread_sigmask(SIG_BLOCK, signals, NULL);
+	tr_path = path;
+	tr_running = 1;
+	if (pthread_create(&tr_thread, NULL, tr_dump_thread, signals)) {
+		perror("ERROR: creating trace dump thread failed\n");
+		tr_running = 0;
+		free(signals);
+		return 0;
+	}
+	return 1;
+}
+
+void tr_finalize(void)
+{
+	if (tr_running) {
+		tr_running = 0;
+		pthread_kill(tr_thread, SIGUSR1);
+		pthread_join(tr_thread, NULL);
+		tr_dump(tr_path);
+	}
+	tr_buffer *buffer = __atomic_exchange_n(&tr_buffers, NULL, __ATOMIC_ACQUIRE);
+	while (buffer) {
+		tr_buffer *next = buffer->next;
+		free(buffer);
+		buffer = next;
+	}
+	tr_local = NULL;
+}
+
+void tr_record(const char *const name, const uint64_t start)
+{
+	if (!tr_local && !(tr_local = tr_buffer_malloc())) {
+		return;
+	}
+	uint64_t head = tr_local->head;
+	tr_event *event = &tr_local->events[head % TRACE_BUFFER_SIZE];
+	event->name = name;
+	event->start = start;
+	event->duration = tr_now() - start;
+	__atomic_store_n(&tr_local->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Writes events of one buffer, events overwritten while they were read are skipped
+ */
+static void tr_dump_buffer(FILE *const file, const tr_buffer *const buffer, const pid_t pid,
+			   const short first)
+{
+	uint64_t head = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+	uint64_t begin = head > TRACE_BUFFER_SIZE ? head - TRACE_BUFFER_SIZE : 0;
+	fprintf(file,
+		"%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%ld,"
+		"\"args\":{\"name\":\"%s\"}}",
+		first ? "" : ",", pid, buffer->thread_id, buffer->thread_name);
+	for (uint64_t i = begin; i < head; i++) {
+		tr_event event = buffer->events[i % TRACE_BUFFER_SIZE];
+		/* Writer reaching index i + TRACE_BUFFER_SIZE may have torn the copy */
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&buffer->head, __ATOMIC_RELAXED) >= i + TRACE_BUFFER_SIZE) {
+			continue;
+		}
+		fprintf(file,
+			",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%ld,"
+			"\"ts\":%.3f,\"dur\":%.3f}",
+			event.name, pid, buffer->thread_id, (double)event.start / 1e3,
+			(double)event.duration / 1e3);
+	}
+}
+
+short tr_dump(const char *const path)
+{
+	if (!path) {
+		return 0;
+	}
+	FILE *file = fopen(path, "w");
+	if (!file) {
+		perror("ERROR: opening trace file failed\n");
+		return 0;
+	}
+	pid_t pid = getpid();
+	short first = 1;
+	fprintf(file, "{\"traceEvents\":[");
+	for (tr_buffer *buffer = __atomic_load_n(&tr_buffers, __ATOMIC_ACQUIRE); buffer;
+	     buffer = buffer->next) {
+		tr_dump_buffer(file, buffer, pid, first);
+		first = 0;
+	}
+	fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	fclose(file);
+	return 1;
+}
+
+uint64_t tr_now(void)
+{
+	return tw_now();
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+/*
+ * Trace points are compiled in only when SNAKE_TRACE is defined (make TRACE=1),
+ * otherwise every macro below expands to nothing
+ */
+#ifdef SNAKE_TRACE
+
+#include <stdint.h>
+
+/*
+ * Number of events kept per thread, oldest events are overwritten
+ */
+#define TRACE_BUFFER_SIZE 16384
+
+/*
+ * Completed span, start and duration are monotonic time in nanoseconds
+ */
+typedef struct tr_event {
+	const char *name;
+	uint64_t start;
+	uint64_t duration;
+} tr_event;
+
+/*
+ * Ring buffer owned and written by a single thread.
+ * Head counts all events ever written, it is published with release ordering
+ * so the dumping thread can read the ring without locking
+ */
+typedef struct tr_buffer {
+	tr_event events[TRACE_BUFFER_SIZE];
+	uint64_t head;
+	long thread_id;
+	char thread_name[16];
+	struct tr_buffer *next;
+} tr_buffer;
+
+/*
+ * Span opened by TRACE_SCOPE and recorded when the scope is left
+ */
+typedef struct tr_scope {
+	const char *name;
+	uint64_t start;
+} tr_scope;
+
+/*
+ * Starts the dump thread and blocks SIGUSR1 in the calling thread,
+ * has to be called before any other thread is created.
+ * Every SIGUSR1 dumps all buffers to path
+ * \RETURNS: 1 if tracing was started, 0 otherwise
+ */
+short tr_initialize(const char *const path);
+
+/*
+ * Stops the dump thread, dumps all buffers one last time and frees them
+ */
+void tr_finalize(void);
+
+/*
+ * Records a span of name from start until now into the calling thread buffer
+ */
+void tr_record(const char *const name, const uint64_t start);
+
+/*
+ * Writes all buffers to path in Chrome trace event format
+ * \RETURNS: 1 if the file was written, 0 otherwise
+ */
+short tr_dump(const char *const path);
+
+/*
+ * RETURNS: current monotonic time in nanoseconds
+ */
+uint64_t tr_now(void);
+
+static inline tr_scope tr_scope_begin(const char *const name)
+{
+	return (tr_scope){ name, tr_now() };
+}
+
+static inline void tr_scope_end(const tr_scope *const scope)
+{
+	tr_record(scope->name, scope->start);
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+/*
+ * Records a span from this point until the end of the enclosing block
+ */
+#define TRACE_SCOPE(name)                                                             \
+	tr_scope TRACE_CONCAT(tr_scope_, __LINE__) __attribute__((cleanup(tr_scope_end))) \
+		= tr_scope_begin(name)
+
+/*
+ * Records a span from TRACE_BEGIN to TRACE_END with the same id in the same block
+ */
+#define TRACE_BEGIN(id) const uint64_t tr_begin_##id = tr_now()
+#define TRACE_END(id, name) tr_record(name, tr_begin_##id)
+
+#define TRACE_INITIALIZE(path) tr_initialize(path)
+#define TRACE_FINALIZE() tr_finalize()
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_BEGIN(id) ((void)0)
+#define TRACE_END(id, name) ((void)0)
+#define TRACE_INITIALIZE(path) ((void)(path))
+#define TRACE_FINALIZE() ((void)0)
+
+#endif
+
+#endif
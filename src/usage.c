@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "usage.h"
+#include "timing_wheel.h"
+#include <unistd.h>
+
+void u_sample(usage *const usage)
+{
+	if (!usage) {
+		return;
+	}
+	getrusage(RUSAGE_SELF, &usage->rusage);
+	usage->resident = u_resident();
+	usage->time = tw_now();
+}
+
+size_t u_resident(void)
+{
+	FILE *statm = fopen("/proc/self/statm", "r");
+	if (!statm) {
+		return 0;
+	}
+	unsigned long size, resident;
+	size_t bytes = 0;
+	if (fscanf(statm, "%lu %lu", &size, &resident) == 2) {
+		bytes = resident * (size_t)sysconf(_SC_PAGESIZE);
+	}
+	fclose(statm);
+	return bytes;
+}
+
+uint64_t u_cpu_time(const usage *const before, const usage *const after)
+{
+	if (!before || !after) {
+		return 0;
+	}
+	const struct rusage *a = &before->rusage;
+	const struct rusage *b = &after->rusage;
+	int64_t seconds = (b->ru_utime.tv_sec - a->ru_utime.tv_sec)
+			  + (b->ru_stime.tv_sec - a->ru_stime.tv_sec);
+	int64_t microseconds = (b->ru_utime.tv_usec - a->ru_utime.tv_usec)
+			       + (b->ru_stime.tv_usec - a->ru_stime.tv_usec);
+	return (uint64_t)(seconds * 1000000 + microseconds) * 1000;
+}
+
+void u_report(FILE *const stream, const char *const label, const usage *const before,
+	      const usage *const after, const unsigned long ticks)
+{
+	if (!stream || !label || !before || !after) {
+		return;
+	}
+	long voluntary = after->rusage.ru_nvcsw - before->rusage.ru_nvcsw;
+	long involuntary = after->rusage.ru_nivcsw - before->rusage.ru_nivcsw;
+	double divisor = ticks ? (double)ticks : 1;
+	double elapsed = (double)(after->time - before->time) / 1e9;
+	fprintf(stream, "%s: %lu ticks in %.1f s\n", label, ticks, elapsed);
+	fprintf(stream, "context switches: %ld voluntary, %ld involuntary, %.3f per tick\n",
+		voluntary, involuntary, (double)(voluntary + involuntary) / divisor);
+	fprintf(stream, "cpu per tick: %.2f us\n",
+		(double)u_cpu_time(before, after) / 1e3 / divisor);
+}
+
+void u_jitter_add(u_jitter *const jitter, const uint64_t late)
+{
+	if (!jitter) {
+		return;
+	}
+	jitter->ticks++;
+	jitter->total += late;
+	if (late > jitter->max) {
+		jitter->max = late;
+	}
+	uint64_t microseconds = late / 1000;
+	unsigned int bucket = 0;
+	while (microseconds > 0 && bucket < USAGE_JITTER_BUCKETS - 1) {
+		microseconds >>= 1;
+		bucket++;
+	}
+	jitter->buckets[bucket]++;
+}
+
+void u_jitter_report(FILE *const stream, const char *const label, const u_jitter *const jitter)
+{
+	if (!stream || !label || !jitter || jitter->ticks == 0) {
+		return;
+	}
+	/* Upper bound of the bucket holding the 99th percentile */
+	uint64_t rank = jitter->ticks - jitter->ticks / 100;
+	uint64_t seen = 0;
+	unsigned int bucket = 0;
+	while (bucket < USAGE_JITTER_BUCKETS - 1 && seen + jitter->buckets[bucket] < rank) {
+		seen += jitter->buckets[bucket];
+		bucket++;
+	}
+	fprintf(stream, "%s: %llu ticks, jitter mean %llu us, p99 < %llu us, max %llu us\n", label,
+		(unsigned long long)jitter->ticks,
+		(unsigned long long)(jitter->total / jitter->ticks / 1000),
+		(unsigned long long)1 << bucket, (unsigned long long)(jitter->max / 1000));
+}
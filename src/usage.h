@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __USAGE_H__
+#define __USAGE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/resource.h>
+
+/*
+ * Number of power of two microsecond buckets in the jitter histogram
+ */
+#define USAGE_JITTER_BUCKETS 32
+
+/*
+ * How late ticks ran compared to their deadlines, in nanoseconds
+ */
+typedef struct u_jitter {
+	uint64_t ticks;
+	uint64_t total;
+	uint64_t max;
+	uint64_t buckets[USAGE_JITTER_BUCKETS];
+} u_jitter;
+
+/*
+ * Process resource usage sample.
+ * Resident is the resident set size in bytes, time is monotonic time in nanoseconds
+ */
+typedef struct usage {
+	struct rusage rusage;
+	size_t resident;
+	uint64_t time;
+} usage;
+
+/*
+ * Samples resource usage of the whole process
+ */
+void u_sample(usage *const usage);
+
+/*
+ * RETURNS: resident set size of the process in bytes, 0 if it is not known
+ */
+size_t u_resident(void);
+
+/*
+ * RETURNS: user and system CPU time between the samples in nanoseconds
+ */
+uint64_t u_cpu_time(const usage *const before, const usage *const after);
+
+/*
+ * Prints context switches and CPU time per tick between the samples
+ */
+void u_report(FILE *const stream, const char *const label, const usage *const before,
+	      const usage *const after, const unsigned long ticks);
+
+/*
+ * Records a tick that ran late nanoseconds after its deadline
+ */
+void u_jitter_add(u_jitter *const jitter, const uint64_t late);
+
+/*
+ * Prints mean, 99th percentile and maximum jitter, nothing if no tick was recorded
+ */
+void u_jitter_report(FILE *const stream, const char *const label, const u_jitter *const jitter);
+
+#endif
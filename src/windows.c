@@ -21,16 +21,24 @@
  */
 
 #include "windows.h"
+#include "allocator.h"
+#include "food_set.h"
+#include "map.h"
+#include "timing_wheel.h"
+#include "trace.h"
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 struct windows *w_malloc(void)
 {
-	windows *windows = (struct windows *)malloc(sizeof(struct windows));
+	windows *windows = a_malloc(ALLOCATOR_TAG_WINDOWS, sizeof(struct windows));
 	if (!windows) {
 		perror("ERROR: windows allocation failed:\n");
+		return NULL;
 	}
+	windows->spectator = NULL;
+	windows->hud = NULL;
 	return windows;
 }
 
@@ -51,7 +59,8 @@ void w_free(struct windows **windows)
 	if (!windows || !*windows) {
 		return;
 	}
-	free(*windows);
+	h_free(&(*windows)->hud);
+	a_free(ALLOCATOR_TAG_WINDOWS, *windows, sizeof(struct windows));
 	*windows = NULL;
 }
 
@@ -86,15 +95,21 @@ void w_display(windows *const windows, monitor *const monitor, snake *const snak
 	}
 	short exit_received = 0;
 	while (!exit_received) {
-		pthread_mutex_lock(&(monitor->mutex));
-		while (monitor->signal_windows == SIGNAL_WINDOWS_EMPTY) {
-			pthread_cond_wait(&(monitor->conditional), &(monitor->mutex));
-		}
+		TRACE_BEGIN(wait);
+		m_lock(monitor, __func__);
+		m_wait(monitor, &monitor->windows_event, __func__, m_windows_ready);
+		TRACE_END(wait, "w_display wait");
+		/* The game thread changes the body outside of the lock, so it encodes the keyframe */
+		sp_frame *keyframe = monitor->keyframe;
+		monitor->keyframe = NULL;
+		sp_publish(windows->spectator, monitor->signal_windows, snake, keyframe);
+		sp_frame_release(keyframe);
+		monitor->keyframe_wanted = sp_keyframe_wanted(windows->spectator);
 		if (w_handle_signal(windows, monitor, snake)) {
-			pthread_mutex_unlock(&(monitor->mutex));
+			m_unlock(monitor);
 			return;
 		}
-		pthread_mutex_unlock(&(monitor->mutex));
+		m_unlock(monitor);
 	}
 }
 
@@ -103,20 +118,30 @@ short w_handle_signal(windows *const windows, monitor *const monitor, snake *con
 	if (!windows || !monitor || !snake) {
 		return 0;
 	}
+	TRACE_SCOPE("w_handle_signal");
+	uint64_t start = tw_now();
+	uint64_t flush = 0;
 	switch (monitor->signal_windows) {
 	case SIGNAL_WINDOWS_GAME_EXIT:
 		monitor->signal_windows = SIGNAL_WINDOWS_EMPTY;
 		return 1;
 	case SIGNAL_WINDOWS_SNAKE_AND_FOOD_REFRESH:
 		w_snake_display_food(windows, snake);
-		char score[16];
-		snprintf(score, 15, "Score: %d", snake->score);
-		w_status_display(windows, score);
+		if (!monitor->hud_visible) {
+			char score[16];
+			snprintf(score, 15, "Score: %d", snake->score);
+			w_status_display(windows, score);
+		}
 		__attribute__((fallthrough));
 	case SIGNAL_WINDOWS_SNAKE_REFRESH:
 		w_snake_display_head(windows, snake, COLOR_PAIR_GREEN);
 		w_snake_clear_tail(windows, snake);
+		TRACE_BEGIN(refresh);
+		flush = tw_now();
 		wrefresh(windows->game);
+		h_record_render(windows->hud, flush - start, tw_now() - flush);
+		TRACE_END(refresh, "wrefresh");
+		w_hud_display(windows, monitor, snake);
 		break;
 	case SIGNAL_WINDOWS_SNAKE_DIED:
 		w_status_display(windows, "Snake has died");
@@ -131,6 +156,21 @@ short w_handle_signal(windows *const windows, monitor *const monitor, snake *con
 	return 0;
 }
 
+void w_map_display(windows *const windows, const struct map *const map)
+{
+	if (!windows || !map) {
+		return;
+	}
+	for (int y = 0; y < map->height; y++) {
+		for (int x = 0; x < map->width; x++) {
+			if (mp_is_wall(map, x, y)) {
+				mvwaddch(windows->game, y, x, ACS_CKBOARD);
+			}
+		}
+	}
+	wrefresh(windows->game);
+}
+
 void w_snake_display_head(windows *const windows, const snake *const snake, const short color_pair)
 {
 	if (!windows || !snake) {
@@ -146,6 +186,17 @@ void w_snake_display_food(windows *const windows, const snake *const snake)
 	if (!windows || !snake) {
 		return;
 	}
+	if (snake->foods) {
+		/* Only items placed since the last call are drawn, all under one attribute switch */
+		uint32_t cell;
+		wattron(windows->game, COLOR_PAIR(COLOR_PAIR_RED));
+		while (fs_next_spawn(snake->foods, &cell)) {
+			mvwaddch(windows->game, (int)(cell / snake->foods->width),
+				 (int)(cell % snake->foods->width), '*');
+		}
+		wattroff(windows->game, COLOR_PAIR(COLOR_PAIR_RED));
+		return;
+	}
 	if (snake->food.x == -1 && snake->food.y == -1) {
 		return;
 	}
@@ -175,3 +226,29 @@ void w_status_display(windows *const windows, const char *message)
 	mvwprintw(windows->status, 0, 0, message);
 	wrefresh(windows->status);
 }
+
+void w_hud_display(windows *const windows, const monitor *const monitor,
+		   const snake *const snake)
+{
+	if (!windows || !windows->hud || !monitor || !snake) {
+		return;
+	}
+	hud *hud = windows->hud;
+	if (!monitor->hud_visible) {
+		if (hud->shown) {
+			hud->shown = 0;
+			char score[16];
+			snprintf(score, 15, "Score: %d", snake->score);
+			w_status_display(windows, score);
+		}
+		return;
+	}
+	unsigned int input_depth = (unsigned int)(monitor->move_next[0] != SNAKE_MOVE_EMPTY)
+				   + (unsigned int)(monitor->move_next[1] != SNAKE_MOVE_EMPTY);
+	/* The last column is left empty, writing it would scroll the bottom line */
+	char line[128];
+	size_t width = (size_t)getmaxx(windows->status);
+	if (h_format(hud, line, width < sizeof(line) ? width : sizeof(line), input_depth)) {
+		w_status_display(windows, line);
+	}
+}
@@ -24,18 +24,23 @@
 #define __WINDOWS_H__
 
 #include "snake.h"
+#include "hud.h"
 #include "monitor.h"
+#include "spectator.h"
 #include <ncurses.h>
 
 #define COLOR_PAIR_GREEN 1
 #define COLOR_PAIR_RED 2
 
 /*
- * Stores all windows
+ * Stores all windows, optional spectator feed mirroring the game window
+ * and optional performance HUD shown in the status window
  */
 typedef struct windows {
 	WINDOW *game;
 	WINDOW *status;
+	spectator *spectator;
+	hud *hud;
 } windows;
 
 /*
@@ -74,13 +79,18 @@ void w_display(windows *const windows, monitor *const monitor, snake *const snak
  */
 short w_handle_signal(windows *const windows, monitor *const monitor, snake *const snake);
 
+/*
+ * Draws the walls of map on the game window
+ */
+void w_map_display(windows *const windows, const struct map *const map);
+
 /*
  * Displays snake on the game window
  */
 void w_snake_display_head(windows *const windows, const snake *const snake, const short color_pair);
 
 /*
- * Displays snakes food on the game window
+ * Displays snakes food on the game window, of a food set only the items placed since the last call
  */
 void w_snake_display_food(windows *const windows, const snake *const snake);
 
@@ -94,4 +104,11 @@ void w_snake_clear_tail(windows *const windows, snake *const snake);
  */
 void w_status_display(windows *const windows, const char *message);
 
+/*
+ * Shows the performance HUD in the status bar while it is toggled on, at most every
+ * HUD_INTERVAL, and puts the score back once it is toggled off
+ */
+void w_hud_display(windows *const windows, const monitor *const monitor,
+		   const snake *const snake);
+
 #endif
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "zobrist.h"
+#include "allocator.h"
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Entries are read and written with relaxed atomics, a torn pair fails the check
+ */
+static uint64_t z_pack(const uint32_t visits, const float reward)
+{
+	uint32_t bits;
+	memcpy(&bits, &reward, sizeof(bits));
+	return (uint64_t)visits << 32 | bits;
+}
+
+static void z_unpack(const uint64_t data, uint32_t *const visits, float *const reward)
+{
+	uint32_t bits = (uint32_t)data;
+	*visits = (uint32_t)(data >> 32);
+	memcpy(reward, &bits, sizeof(bits));
+}
+
+z_table *z_malloc(const unsigned int bits)
+{
+	if (bits < 1 || bits > 30) {
+		fprintf(stderr, "ERROR: transposition table size out of range\n");
+		return NULL;
+	}
+	z_table *table = a_malloc(ALLOCATOR_TAG_TABLE, sizeof(struct z_table));
+	if (!table) {
+		perror("ERROR: transposition table malloc failed\n");
+		return NULL;
+	}
+	size_t count = (size_t)1 << bits;
+	table->mask = count - 1;
+	table->entries = a_aligned(ALLOCATOR_TAG_TABLE, 64, count * sizeof(z_entry));
+	if (!table->entries) {
+		perror("ERROR: transposition table malloc failed\n");
+		a_free(ALLOCATOR_TAG_TABLE, table, sizeof(struct z_table));
+		return NULL;
+	}
+	memset(table->entries, 0, count * sizeof(z_entry));
+	return table;
+}
+
+void z_free(z_table **table)
+{
+	if (!table || !*table) {
+		return;
+	}
+	a_free(ALLOCATOR_TAG_TABLE, (*table)->entries, ((*table)->mask + 1) * sizeof(z_entry));
+	a_free(ALLOCATOR_TAG_TABLE, *table, sizeof(struct z_table));
+	*table = NULL;
+}
+
+short z_probe(const z_table *const table, const uint64_t key, uint32_t *const visits,
+	      float *const reward)
+{
+	const z_entry *entry = &table->entries[key & table->mask];
+	uint64_t check = __atomic_load_n(&entry->check, __ATOMIC_RELAXED);
+	uint64_t data = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+	if ((check ^ data) != key) {
+		return 0;
+	}
+	z_unpack(data, visits, reward);
+	return 1;
+}
+
+void z_update(z_table *const table, const uint64_t key, const float reward)
+{
+	z_entry *entry = &table->entries[key & table->mask];
+	uint32_t visits = 0;
+	float sum = 0.0f;
+	z_probe(table, key, &visits, &sum);
+	uint64_t data = z_pack(visits + 1, sum + reward);
+	__atomic_store_n(&entry->data, data, __ATOMIC_RELAXED);
+	__atomic_store_n(&entry->check, key ^ data, __ATOMIC_RELAXED);
+}
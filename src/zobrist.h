@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2024 Simas Bradaitis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef __ZOBRIST_H__
+#define __ZOBRIST_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Keys are derived from this seed, hashes are only comparable within one build
+ */
+#define ZOBRIST_SEED 0x5eed5eed5eedULL
+
+/*
+ * What a key stands for, cells are numbered y * width + x
+ */
+typedef enum z_kind {
+	ZOBRIST_BODY,
+	ZOBRIST_HEAD,
+	ZOBRIST_FOOD,
+	ZOBRIST_SEARCH
+} z_kind;
+
+/*
+ * Transposition table entry, key is stored xored with data,
+ * so an entry torn by two threads writing it at once does not match any key
+ */
+typedef struct z_entry {
+	uint64_t check;
+	uint64_t data;
+} z_entry;
+
+/*
+ * Fixed size transposition table shared by search threads without locking,
+ * every position keeps its visits and reward sum, colliding positions replace each other
+ */
+typedef struct z_table {
+	size_t mask;
+	z_entry *entries;
+} z_table;
+
+/*
+ * Zobrist key of a cell or value of given kind.
+ * Keys are mixed from the seed with splitmix64 instead of read from a table,
+ * so any board size is covered without memory
+ * \RETURNS: the key
+ */
+static inline uint64_t z_key(const z_kind kind, const uint32_t value)
+{
+	uint64_t key = ZOBRIST_SEED + (((uint64_t)value << 2 | (uint64_t)kind) + 1)
+					     * 0x9e3779b97f4a7c15ULL;
+	key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+	return key ^ (key >> 31);
+}
+
+/*
+ * Hash change of pushing cell as the new head, previous is the old head, -1 if the body was empty
+ * \RETURNS: value to xor into the hash
+ */
+static inline uint64_t z_push(const int64_t previous, const uint32_t cell)
+{
+	uint64_t change = z_key(ZOBRIST_BODY, cell) ^ z_key(ZOBRIST_HEAD, cell);
+	return previous < 0 ? change : change ^ z_key(ZOBRIST_HEAD, (uint32_t)previous);
+}
+
+/*
+ * Hash change of removing the tail cell, last is set if it was the only cell
+ * \RETURNS: value to xor into the hash
+ */
+static inline uint64_t z_pop(const uint32_t cell, const short last)
+{
+	uint64_t change = z_key(ZOBRIST_BODY, cell);
+	return last ? change ^ z_key(ZOBRIST_HEAD, cell) : change;
+}
+
+/*
+ * Creates table of 2^bits entries
+ * \RETURNS: pointer to the table, NULL on failure
+ */
+z_table *z_malloc(const unsigned int bits);
+
+/*
+ * Frees given table
+ */
+void z_free(z_table **table);
+
+/*
+ * Looks up the position with hash key
+ * \RETURNS: 1 and its visits and reward sum if it is stored, 0 otherwise
+ */
+short z_probe(const z_table *const table, const uint64_t key, uint32_t *const visits,
+	      float *const reward);
+
+/*
+ * Adds a visit with reward to the position with hash key, replacing any other position
+ * stored in its entry. Concurrent updates of the same entry may lose one of them
+ */
+void z_update(z_table *const table, const uint64_t key, const float reward);
+
+#endif